@@ -1,4 +1,4 @@
-g++ src/*.cpp src/glad.c -Iinclude -o Final-Project-FCG -lglfw -ldl -lGL
+g++ src/*.cpp src/glad.c -Iinclude -o Final-Project-FCG -lglfw -ldl -lGL -pthread
 
 if [ $? -eq 0 ]; then
     echo "Compilation successful!"
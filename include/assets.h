@@ -0,0 +1,103 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mesharena.h"
+#include "object.h"
+#include "texturearray.h"
+#include "texturestream.h"
+
+// Gerenciador dos recursos carregados do disco: modelos (ObjModel e a sua
+// malha na arena, veja "mesharena.h") e imagens (camadas dos arrays de
+// texturas, veja "texturearray.h").
+//
+// Cada recurso é acessado por um handle tipado (índice + geração): o handle de
+// um recurso descarregado deixa de valer, mesmo que a posição seja reusada, e
+// Assets_GetModel()/Assets_GetImage() retornam vazio para ele. Cada recurso
+// tem uma contagem de referências e é descarregado quando a última é
+// liberada.
+//
+// Pedir de novo um recurso já carregado só ganha uma referência, seja pelo
+// mesmo caminho ou por outro arquivo com o mesmo conteúdo (mesmo tamanho,
+// depois FNV-1a do arquivo, confirmado byte a byte; um arquivo só é lido
+// quando já há outro recurso do mesmo tamanho). Modelos só são unificados pelo conteúdo quando
+// estão no mesmo diretório, porque o ".mtl" e as texturas são procurados a
+// partir dele.
+//
+// Não há mais samplers por textura para unificar: todos os arrays usam o
+// mesmo sampler (veja "texturearray.h").
+
+struct ModelHandle
+{
+    uint32_t index;
+    uint32_t generation; // 0 = handle vazio
+
+    ModelHandle() : index(0), generation(0) {}
+};
+
+struct ImageHandle
+{
+    uint32_t index;
+    uint32_t generation; // 0 = handle vazio
+
+    ImageHandle() : index(0), generation(0) {}
+};
+
+// Um modelo carregado. "allocation", "images" e "objects" são preenchidos por
+// quem carrega o modelo ("main.cpp").
+struct ModelAsset
+{
+    ObjModel*                model;
+    MeshAllocation           allocation; // Região da malha na arena
+    std::vector<ImageHandle> images;     // Texturas dos materiais, uma referência cada
+    std::vector<std::string> objects;    // Nomes dos objetos na cena virtual
+};
+
+// Procura um modelo já carregado pelo caminho ou pelo conteúdo. Se achar,
+// ganha uma referência; senão retorna um handle vazio.
+ModelHandle Assets_FindModel(const char* filename);
+
+// Registra um modelo recém-carregado (alocado com new), com uma referência.
+ModelHandle Assets_AddModel(const char* filename, ObjModel* model);
+
+// NULL se o handle não vale mais.
+ModelAsset* Assets_GetModel(ModelHandle handle);
+
+void Assets_AcquireModel(ModelHandle handle);
+
+// Referências ao modelo; 0 se o handle não vale mais.
+uint32_t Assets_ModelReferences(ModelHandle handle);
+
+// Libera uma referência. Com a última, a malha volta para a arena, as texturas
+// são liberadas e o ObjModel é destruído; retorna true nesse caso, para que o
+// chamador tire "objects" da cena.
+bool Assets_ReleaseModel(ModelHandle handle);
+
+// Carrega imagens de textura pelo fluxo de "texturestream.h". Imagens já
+// carregadas (pelo caminho ou pelo conteúdo), inclusive repetidas na própria
+// lista, não são carregadas de novo. "handles" recebe um handle para cada
+// imagem, na ordem de "filenames", cada um com uma referência.
+void Assets_LoadImages(const char* const* filenames, size_t count, const TextureLoadOptions& options,
+                       std::vector<ImageHandle>* handles);
+
+// Imagem carregada com o caminho "filename", sem ganhar referência; handle
+// vazio se não houver.
+ImageHandle Assets_FindImage(const std::string& filename);
+
+// Camada da imagem; vazia (array -1) se o handle não vale mais.
+TextureLayer Assets_GetImage(ImageHandle handle);
+
+void Assets_AcquireImage(ImageHandle handle);
+
+// Libera uma referência; com a última, a camada é devolvida aos arrays. Se
+// ainda houver texturas chegando aos poucos, espera elas terminarem.
+void Assets_ReleaseImage(ImageHandle handle);
+
+// Imprime os recursos carregados e quantos pedidos foram atendidos por
+// recursos já carregados.
+void Assets_PrintStats();
+
+#endif // ASSETS_H
@@ -5,7 +5,6 @@
 #include "tiny_obj_loader.h"
 #include <string>
 #include <vector>
-#include "object.h"
 
 struct BoundingBox {
     glm::vec3 min;
@@ -13,6 +12,7 @@ struct BoundingBox {
 };
 
 BoundingBox ComputeLocalBoundingBox(const tinyobj::attrib_t& attrib);
+BoundingBox ComputeShapeBoundingBox(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape);
 BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& model);
 bool IntersectAABB(const BoundingBox& a, const BoundingBox& b);
 bool PointInsideAABB(const glm::vec3& point, const BoundingBox& box);
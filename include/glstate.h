@@ -0,0 +1,61 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Cache do estado do OpenGL. As mudanças de estado do programa passam por
+// estas funções em vez de chamar o OpenGL diretamente: cada uma compara com o
+// valor atual e só chama o OpenGL quando ele muda.
+//
+// São acompanhados o programa, o VAO, os buffers ligados aos alvos mais
+// usados (inclusive os pontos de GL_UNIFORM_BUFFER), a unidade de textura
+// ativa e as texturas e samplers de cada unidade, e os estados de blend,
+// profundidade, descarte de faces e modo de polígono. Uma chamada feita
+// direto no OpenGL deixa o cache errado; nesse caso, GLState_Invalidate()
+// faz o cache esquecer tudo.
+//
+// O buffer ligado a GL_ELEMENT_ARRAY_BUFFER faz parte do VAO: trocar de VAO
+// torna ele desconhecido.
+
+// Chamadas de mudança de estado desde o último GLState_ResetStats().
+struct GLStateStats
+{
+    size_t issued;   // Repassadas ao OpenGL
+    size_t filtered; // Descartadas porque não mudavam nada
+
+    GLStateStats() : issued(0), filtered(0) {}
+};
+
+// Esquece o estado conhecido; a próxima chamada de cada função vai ao OpenGL.
+void GLState_Invalidate();
+
+void GLState_UseProgram(GLuint program);
+void GLState_BindVertexArray(GLuint vao);
+
+// Alvos fora dos acompanhados são sempre repassados.
+void GLState_BindBuffer(GLenum target, GLuint buffer);
+
+// Liga também o alvo genérico "target", como o OpenGL. "size" = 0 liga o
+// buffer inteiro (glBindBufferBase).
+void GLState_BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+// Torna "unit" a unidade ativa, se preciso, e liga a textura nela.
+void GLState_BindTexture(GLuint unit, GLenum target, GLuint texture);
+void GLState_BindSampler(GLuint unit, GLuint sampler);
+
+// GL_BLEND, GL_DEPTH_TEST ou GL_CULL_FACE; outros são sempre repassados.
+void GLState_SetEnabled(GLenum capability, bool enabled);
+void GLState_BlendFunc(GLenum source, GLenum destination);
+void GLState_DepthFunc(GLenum func);
+void GLState_PolygonMode(GLenum mode); // Para GL_FRONT_AND_BACK
+
+// Apagam os objetos, desligando-os no cache onde estiverem ligados (como o
+// OpenGL faz), para que um novo objeto com o mesmo nome seja ligado de novo.
+void GLState_DeleteBuffer(GLuint buffer);
+void GLState_DeleteTexture(GLuint texture);
+
+const GLStateStats& GLState_Stats();
+void GLState_ResetStats();
+
+#endif // GLSTATE_H
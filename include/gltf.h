@@ -0,0 +1,35 @@
+#ifndef GLTF_H
+#define GLTF_H
+
+#include <string>
+#include "object.h"
+
+// Leitor de modelos glTF 2.0, tanto ".gltf" (JSON + ".bin" externos) quanto
+// ".glb" (JSON e dados binários no mesmo arquivo). Os buffers binários são
+// mapeados em memória e o resultado é um ObjModel como o do leitor de ".obj":
+// os mesmos shapes (um por primitiva, com o nome do nó), materiais e bounding
+// boxes, com a malha já pronta em "mesh" (veja "mesh.h"), de forma que
+// BuildTrianglesAndAddToVirtualScene() funciona sem saber a origem do modelo.
+//
+// Os dados do glTF já estão no formato da GPU: os índices de uma malha com uma
+// única primitiva apontam direto para o buffer mapeado, sem cópia, e os
+// atributos são só intercalados em VERTEX_FORMAT_FLOAT, sem conversão.
+// Diferenças em relação ao ".obj":
+//   - "attrib" e "shapes" ficam vazios (não há texto para interpretar);
+//   - as transformações dos nós não são aplicadas: a geometria fica no espaço
+//     da malha;
+//   - a coordenada de textura v é invertida (no glTF a origem é o canto
+//     superior esquerdo da imagem);
+//   - só primitivas de triângulos (mode 4) e atributos float são lidos;
+//     normais ausentes não são calculadas e os níveis de detalhe, meshlets e
+//     otimizações de "mesh.cpp" não são aplicados;
+//   - a textura difusa é a baseColorTexture, se a imagem for um arquivo
+//     externo; imagens embutidas no ".glb" não têm caminho e são ignoradas.
+
+// true se "filename" termina em ".gltf" ou ".glb".
+bool IsGltfFilename(const char* filename);
+
+// Retorna false em caso de erro; neste caso "err" descreve o problema.
+bool LoadGltf(const char* filename, ObjModel* model, std::string* err);
+
+#endif // GLTF_H
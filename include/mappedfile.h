@@ -0,0 +1,33 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+// Arquivo mapeado em memória somente para leitura (mmap no Linux/macOS,
+// CreateFileMapping no Windows). O conteúdo fica acessível por Data() até o
+// objeto ser destruído ou Close() ser chamado.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open(const char* filename);
+    void Close();
+
+    const unsigned char* Data() const { return data; }
+    size_t               Size() const { return size; }
+
+private:
+    MappedFile(const MappedFile&);            // Não copiável
+    MappedFile& operator=(const MappedFile&);
+
+    const unsigned char* data;
+    size_t               size;
+#ifdef _WIN32
+    void*                file_handle;
+    void*                mapping_handle;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,144 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tiny_obj_loader.h"
+#include "mappedfile.h"
+#include "meshlets.h"
+
+// Fluxo de bytes (vértices ou índices) já no formato em que é enviado para a
+// GPU. Quando a malha é construída a partir do OBJ, os bytes ficam em
+// "storage"; quando vem do cache binário, "mapped" aponta diretamente para as
+// páginas mapeadas do arquivo e nada é copiado.
+struct MeshStream
+{
+    std::vector<unsigned char> storage;
+    const unsigned char*       mapped;
+    size_t                     mapped_size;
+
+    MeshStream() : mapped(NULL), mapped_size(0) {}
+
+    const void* Data() const { return mapped != NULL ? (const void*)mapped : (const void*)storage.data(); }
+    size_t      Size() const { return mapped != NULL ? mapped_size : storage.size(); }
+    bool        Empty() const { return Size() == 0; }
+
+    template <typename T>
+    void Assign(const std::vector<T>& values)
+    {
+        const unsigned char* bytes = (const unsigned char*)values.data();
+        storage.assign(bytes, bytes + values.size() * sizeof(T));
+        mapped = NULL;
+        mapped_size = 0;
+    }
+
+    void Map(const unsigned char* bytes, size_t size)
+    {
+        storage.clear();
+        mapped = bytes;
+        mapped_size = size;
+    }
+};
+
+// Nível de detalhe simplificado de um shape (veja "meshsimplify.h"). Usa os
+// mesmos vértices do shape original, com outro intervalo de índices.
+struct MeshLod
+{
+    uint32_t first_index;
+    uint32_t num_indices;
+    float    error;       // Maior desvio em relação ao original, no espaço do modelo
+};
+
+// Intervalo de índices de um shape dentro do fluxo de índices do modelo.
+struct MeshShape
+{
+    std::string name;
+    uint32_t    first_index;
+    uint32_t    num_indices;
+    int         material_id; // -1 se não tiver material
+
+    // LODs 1, 2, ... (do mais detalhado para o mais simples). O LOD 0 é o
+    // intervalo acima.
+    std::vector<MeshLod> lods;
+
+    // Meshlets que cobrem exatamente o intervalo do LOD 0, em ordem. Vazio
+    // para shapes pequenos, que são sempre desenhados inteiros.
+    std::vector<Meshlet> meshlets;
+};
+
+// Formatos de vértice suportados. Nos dois casos os atributos ficam
+// intercalados em um único fluxo ("vertices"):
+//
+//   VERTEX_FORMAT_FLOAT (32 bytes por vértice)
+//     posição  float x3
+//     normal   float x3
+//     textura  float x2
+//
+//   VERTEX_FORMAT_COMPACT (16 bytes por vértice)
+//     posição  uint16 x3 + 2 bytes de preenchimento, quantizada no intervalo
+//              [position_offset, position_offset + position_scale] da malha
+//     normal   GL_INT_2_10_10_10_REV (X, Y, Z com 10 bits com sinal)
+//     textura  half float x2
+//
+// O Vertex Shader reconstrói a posição como
+// position_offset + position_scale * posição (veja "shader_vertex.glsl").
+enum VertexFormat
+{
+    VERTEX_FORMAT_FLOAT   = 0,
+    VERTEX_FORMAT_COMPACT = 1,
+};
+
+// Tamanho em bytes de um vértice no formato dado.
+size_t VertexFormatStride(VertexFormat format);
+
+// Malha pronta para ser enviada à GPU: os mesmos fluxos que
+// BuildTrianglesAndAddToVirtualScene() coloca nos buffers, mais os intervalos
+// de cada shape.
+struct MeshData
+{
+    VertexFormat vertex_format;
+    bool         has_normals;     // Se false, o atributo de normal não é habilitado
+    bool         has_texcoords;   // Idem para coordenadas de textura
+    float        position_offset[3];
+    float        position_scale[3];
+    uint32_t     index_size;      // 2 (uint16) se a malha tem menos de 65536 vértices, senão 4 (uint32)
+
+    MeshStream vertices; // Atributos intercalados, veja VertexFormat
+    MeshStream indices;  // Índices de "index_size" bytes
+
+    std::vector<MeshShape> shapes;
+
+    // Mantém o arquivo de cache mapeado enquanto os fluxos apontarem para ele.
+    std::shared_ptr<MappedFile> mapping;
+
+    MeshData()
+        : vertex_format(VERTEX_FORMAT_FLOAT), has_normals(false), has_texcoords(false), index_size(4)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            position_offset[i] = 0.0f;
+            position_scale[i]  = 1.0f;
+        }
+    }
+
+    bool   Empty() const { return shapes.empty(); }
+    size_t NumVertices() const { return vertices.Size() / VertexFormatStride(vertex_format); }
+    size_t NumIndices() const { return indices.Size() / index_size; }
+};
+
+// Codifica um vértice no formato "format", em VertexFormatStride(format)
+// bytes. "normal" e "texcoord" podem ser NULL (ficam zerados). Em
+// VERTEX_FORMAT_COMPACT a posição é quantizada no intervalo
+// [position_offset, position_offset + position_scale].
+void EncodeVertex(VertexFormat format, const float* position, const float* normal, const float* texcoord,
+                  const float* position_offset, const float* position_scale, unsigned char* out);
+
+// Converte as faces (já trianguladas) de um modelo tinyobj nos fluxos de
+// vértices e índices de MeshData, unificando vértices repetidos e codificando
+// os atributos no formato pedido.
+void BuildMeshData(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                   VertexFormat format, MeshData* mesh);
+
+#endif // MESH_H
@@ -0,0 +1,55 @@
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+#include <cstddef>
+#include <glad/glad.h>
+#include "mesh.h"
+
+// Arena de geometria compartilhada por todos os modelos: um único VBO e um
+// único IBO, divididos entre as malhas por um alocador com lista de blocos
+// livres. Cada formato de vértice (veja "mesh.h") tem um único VAO, que aponta
+// para o começo do VBO; as malhas são desenhadas com glDrawElementsBaseVertex(),
+// usando "base_vertex" para chegar aos seus vértices.
+//
+// Quando falta espaço, o buffer correspondente é recriado com o dobro do
+// tamanho (o conteúdo é copiado na GPU) e os VAOs são atualizados; os
+// deslocamentos já distribuídos continuam válidos.
+
+// Região de uma malha dentro da arena.
+struct MeshAllocation
+{
+    VertexFormat vertex_format;
+    size_t       vertex_offset; // Em bytes, dentro do VBO
+    size_t       vertex_bytes;
+    size_t       index_offset;  // Em bytes, dentro do IBO
+    size_t       index_bytes;
+    GLint        base_vertex;   // vertex_offset / stride
+    size_t       first_index;   // index_offset / tamanho do índice da malha
+};
+
+// Copia os fluxos de uma malha para a arena. Deve ser chamada com um contexto
+// OpenGL ativo.
+MeshAllocation MeshArena_Upload(const MeshData& mesh);
+
+// Reserva uma região vazia, preenchida aos poucos com MeshArena_WriteVertices()
+// e MeshArena_WriteIndices() (veja "objstream.h").
+MeshAllocation MeshArena_Allocate(VertexFormat format, size_t vertex_bytes, size_t index_bytes, uint32_t index_size);
+
+// Copiam bytes para a região, a partir de "offset" bytes do seu começo.
+void MeshArena_WriteVertices(const MeshAllocation& allocation, size_t offset, const void* data, size_t size);
+void MeshArena_WriteIndices(const MeshAllocation& allocation, size_t offset, const void* data, size_t size);
+
+// Devolve à lista de blocos livres o final não usado de uma região, que
+// passa a ter "vertex_bytes" e "index_bytes" bytes.
+void MeshArena_Shrink(MeshAllocation* allocation, size_t vertex_bytes, size_t index_bytes);
+
+// Devolve a região de uma malha para a lista de blocos livres.
+void MeshArena_Free(const MeshAllocation& allocation);
+
+// VAO compartilhado pelas malhas de um formato de vértice.
+GLuint MeshArena_VertexArray(VertexFormat format);
+
+// Imprime a ocupação dos buffers da arena.
+void MeshArena_PrintStats();
+
+#endif // MESHARENA_H
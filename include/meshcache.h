@@ -0,0 +1,26 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+#include "object.h"
+
+// Cache binário das malhas carregadas de arquivos ".obj".
+//
+// O arquivo "<modelo>.obj.meshcache" guarda os fluxos de vértices e índices já
+// no formato da GPU, os intervalos de cada shape (com LODs e meshlets), os
+// materiais e as bounding boxes. Ele é identificado pelo caminho, tamanho e
+// data de modificação do ".obj" e pelo tamanho e data de modificação de cada
+// ".mtl" citado por ele; se qualquer um deles mudar (ou a versão do formato
+// abaixo), o cache é ignorado e reconstruído. Nas execuções seguintes
+// o arquivo é mapeado em memória e os fluxos são enviados para a GPU direto
+// das páginas mapeadas.
+//
+// Incremente MESH_CACHE_VERSION sempre que o layout do arquivo ou o conteúdo
+// dos fluxos mudar.
+#define MESH_CACHE_VERSION 7
+
+std::string MeshCacheFilename(const std::string& obj_filename);
+bool LoadMeshCache(ObjModel* model);
+bool SaveMeshCache(const ObjModel& model);
+
+#endif // MESHCACHE_H
@@ -0,0 +1,43 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Divisão de um shape em meshlets: grupos pequenos de triângulos vizinhos (no
+// máximo MESHLET_MAX_VERTICES vértices e MESHLET_MAX_TRIANGLES triângulos),
+// cada um com um intervalo contíguo de índices. Com uma esfera envolvente e um
+// cone de normais por meshlet, a CPU pode descartar os grupos fora do frustum
+// ou virados de costas para a câmera e desenhar só os intervalos restantes
+// (veja DrawVirtualObject() em "main.cpp").
+const size_t MESHLET_MAX_VERTICES  = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// Um meshlet, no espaço do modelo. O teste de costas segue o de
+// meshoptimizer: o meshlet inteiro está de costas para uma câmera em "c" se
+//
+//     dot(center - c, cone_axis) >= cone_cutoff * |center - c| + radius
+//
+// "cone_cutoff" é o seno do semiângulo do cone de normais; vale 1 quando as
+// normais se espalham demais e o meshlet nunca pode ser descartado assim.
+struct Meshlet
+{
+    uint32_t first_index; // Relativo ao fluxo de índices do modelo
+    uint32_t num_indices;
+    float    center[3];
+    float    radius;
+    float    cone_axis[3];
+    float    cone_cutoff;
+};
+
+// Reordena os triângulos de "indices" (lista de triângulos) no próprio vetor,
+// agrupando-os em meshlets, e acrescenta os meshlets a "meshlets" com
+// first_index relativo a "indices". "positions" aponta para o X,Y,Z (float)
+// do vértice 0, e "position_stride" é a distância em bytes entre vértices
+// consecutivos. A ordem dentro de cada meshlet é otimizada para o cache de
+// vértices.
+void BuildMeshlets(std::vector<Meshlet>* meshlets, uint32_t* indices, size_t index_count, size_t vertex_count,
+                   const float* positions, size_t position_stride);
+
+#endif // MESHLETS_H
@@ -0,0 +1,62 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Otimizações da ordem de triângulos e vértices de uma malha indexada, feitas
+// uma única vez no carregamento (veja BuildMeshData() em "mesh.cpp"):
+//
+//   1. OptimizeVertexCache(): reordena os triângulos para reaproveitar o cache
+//      de vértices transformados da GPU (algoritmo de Tom Forsyth, "Linear-Speed
+//      Vertex Cache Optimisation").
+//   2. OptimizeOverdraw(): divide o resultado em grupos de triângulos que não
+//      pioram muito o uso do cache e ordena os grupos de fora para dentro, para
+//      que o teste de profundidade descarte mais fragmentos cedo.
+//   3. OptimizeVertexFetchRemap(): renumera os vértices na ordem em que são
+//      usados pelos índices, melhorando a localidade das leituras de vértices.
+
+// Estatísticas de uma simulação de cache FIFO de vértices transformados.
+//   ACMR: vértices transformados por triângulo (mínimo teórico ~0.5)
+//   ATVR: vértices transformados por vértice distinto usado (ideal 1.0)
+struct VertexCacheStatistics
+{
+    size_t vertices_transformed;
+    float  acmr;
+    float  atvr;
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+                                         unsigned cache_size = 16);
+
+// Reordena os triângulos de "indices" (lista de triângulos) no próprio vetor.
+void OptimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count);
+
+// Reordena grupos de triângulos, idealmente depois de OptimizeVertexCache().
+// "positions" aponta para o X,Y,Z (float) do vértice 0, e "position_stride" é a
+// distância em bytes entre vértices consecutivos. "threshold" é a piora máxima
+// aceita no ACMR (1.05 = 5%).
+void OptimizeOverdraw(uint32_t* indices, size_t index_count, size_t vertex_count,
+                      const float* positions, size_t position_stride, float threshold = 1.05f);
+
+// Renumera os vértices usados por "indices" como 0..n-1, na ordem do primeiro
+// uso, para que as funções acima trabalhem só com os vértices de uma parte da
+// malha (um shape, um meshlet) em vez de alocar e percorrer vetores do
+// tamanho da malha toda. "local_vertices" recebe o vértice original de cada
+// número novo; n = local_vertices->size(). "remap" é um rascunho do chamador
+// com uma posição por vértice da malha ("vertex_count"), todas UINT32_MAX;
+// se estiver vazio, é criado assim. Ele volta a esse estado no fim, então
+// pode ser reusado entre chamadas.
+void MakeLocalIndices(uint32_t* indices, size_t index_count, size_t vertex_count,
+                      std::vector<uint32_t>* remap, std::vector<uint32_t>* local_vertices);
+
+// Desfaz MakeLocalIndices().
+void RestoreGlobalIndices(uint32_t* indices, size_t index_count, const std::vector<uint32_t>& local_vertices);
+
+// Calcula a nova numeração dos vértices: remap[antigo] = novo, ou UINT32_MAX
+// para vértices não usados. Retorna o número de vértices usados.
+size_t OptimizeVertexFetchRemap(std::vector<uint32_t>* remap, const uint32_t* indices, size_t index_count,
+                                size_t vertex_count);
+
+#endif // MESHOPTIMIZER_H
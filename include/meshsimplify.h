@@ -0,0 +1,29 @@
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Simplificação de malhas por métrica de erro quádrico (Garland & Heckbert,
+// "Surface Simplification Using Quadric Error Metrics"), usada para gerar os
+// níveis de detalhe (LODs) de cada shape em BuildMeshData().
+//
+// As arestas são colapsadas sempre para um dos seus vértices (half-edge
+// collapse), de forma que nenhum vértice novo é criado e os LODs reaproveitam
+// o fluxo de vértices do LOD 0. Vértices que não podem se mover ficam
+// travados:
+//   - vértices de costura (mesma posição com outra normal ou coordenada de
+//     textura), para não rasgar a textura nem mudar arestas duras;
+//   - vértices na borda do conjunto de triângulos recebido, o que preserva o
+//     contorno do shape e, portanto, a fronteira com os shapes de outros
+//     materiais.
+//
+// Escreve em "destination" (com espaço para index_count índices) os índices
+// simplificados, tentando chegar a target_index_count sem ultrapassar o erro
+// "target_error" (distância no espaço do modelo). Retorna o número de índices
+// escritos; "result_error", se não for NULL, recebe o erro atingido.
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t index_count,
+                    const float* positions, size_t position_stride, size_t vertex_count,
+                    size_t target_index_count, float target_error, float* result_error);
+
+#endif // MESHSIMPLIFY_H
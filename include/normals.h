@@ -0,0 +1,24 @@
+#ifndef NORMALS_H
+#define NORMALS_H
+
+#include <vector>
+#include "tiny_obj_loader.h"
+
+// Peso de cada triângulo na normal dos seus vértices.
+enum NormalWeighting
+{
+    NORMAL_WEIGHTING_UNIFORM, // Todos os triângulos têm o mesmo peso
+    NORMAL_WEIGHTING_AREA,    // Proporcional à área do triângulo
+    NORMAL_WEIGHTING_ANGLE,   // Proporcional ao ângulo do triângulo no vértice
+};
+
+// Calcula uma normal por posição de vértice (attrib.vertices) e faz os índices
+// de normal dos shapes apontarem para ela. As faces já devem estar
+// trianguladas. As posições são copiadas para vetores separados por
+// coordenada (SoA), as normais das faces são calculadas com SIMD em lotes de
+// 4 triângulos e cada thread acumula as suas faces em um buffer próprio; os
+// buffers são somados e normalizados em paralelo no final.
+void ComputeVertexNormals(const tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>* shapes,
+                          NormalWeighting weighting, std::vector<float>* normals);
+
+#endif // NORMALS_H
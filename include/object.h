@@ -2,18 +2,58 @@
 #define OBJECT_H
 
 #include "tiny_obj_loader.h"
+#include "collisions.h"
+#include "mesh.h"
+#include <string>
 #include <vector>
 #include <stdexcept>
 
+// Forma de interpretar o texto do ".obj" quando não há cache binário.
+enum ObjLoader
+{
+    OBJ_LOADER_TINYOBJ,  // tinyobj::LoadObj(), em uma única thread
+    OBJ_LOADER_PARALLEL, // LoadObjParallel() (veja "objparser.h")
+};
+
 // Estrutura que representa um modelo geométrico carregado a partir de um
 // arquivo ".obj". Veja https://en.wikipedia.org/wiki/Wavefront_.obj_file .
+// Arquivos ".gltf" e ".glb" também são aceitos (veja "gltf.h").
 struct ObjModel
 {
+    std::string                       filename;
+
+    // Dados lidos do ".obj" pela tinyobjloader. Ficam vazios quando o modelo é
+    // carregado do cache binário (veja "meshcache.h").
     tinyobj::attrib_t                 attrib;
     std::vector<tinyobj::shape_t>     shapes;
     std::vector<tinyobj::material_t>  materials;
 
-    ObjModel(const char* filename, const char* basepath = NULL, bool triangulate = true);
+    // Bounding boxes locais, calculadas uma única vez no carregamento: uma
+    // para o modelo inteiro e uma para cada shape (mesma ordem de "shapes" e
+    // de "mesh.shapes").
+    BoundingBox                       bbox;
+    std::vector<BoundingBox>          shape_bboxes;
+
+    // Fluxos prontos para a GPU, no formato "vertex_format". Preenchidos pelo
+    // cache no construtor ou por BuildTrianglesAndAddToVirtualScene() em
+    // "main.cpp".
+    VertexFormat                      vertex_format;
+    MeshData                          mesh;
+
+    // Modelo vazio, preenchido por outro leitor (veja "objstream.h").
+    ObjModel() : vertex_format(VERTEX_FORMAT_COMPACT) {}
+
+    ObjModel(const char* filename, const char* basepath = NULL, bool triangulate = true,
+             ObjLoader loader = OBJ_LOADER_PARALLEL, VertexFormat vertex_format = VERTEX_FORMAT_COMPACT);
 };
 
+// Memória em CPU de um modelo, em bytes: "heap" conta os vetores alocados
+// pelo modelo e "mapped" os bytes do cache binário mapeados em memória.
+void ObjModelMemoryUsage(const ObjModel& model, size_t* heap, size_t* mapped);
+
+// Libera os dados da leitura do ".obj" (attrib e shapes) e os fluxos de
+// "mesh", que não são mais usados depois que a malha foi para a GPU. O modelo
+// fica só com o nome do arquivo, os materiais e as bounding boxes.
+void ReleaseObjModelGeometry(ObjModel* model);
+
 #endif // OBJECT_H
\ No newline at end of file
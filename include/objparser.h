@@ -0,0 +1,24 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <string>
+#include <vector>
+#include "tiny_obj_loader.h"
+
+// Leitor alternativo de arquivos ".obj": o arquivo é mapeado em memória,
+// dividido em blocos de linhas inteiras e cada bloco é interpretado em uma
+// thread diferente. O resultado é o mesmo attrib_t/shape_t/material_t
+// produzido por tinyobj::LoadObj() (mesmos shapes, materiais, índices e
+// triangulação), de forma que o resto do programa não precisa saber qual dos
+// dois leitores foi usado.
+//
+// Diferença conhecida em relação à tinyobjloader: as linhas "l", "p", "t" e
+// "vw" são ignoradas.
+//
+// Retorna false em caso de erro; neste caso "err" descreve o problema.
+bool LoadObjParallel(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+                     std::vector<tinyobj::material_t>* materials, std::string* warn,
+                     std::string* err, const char* filename, const char* mtl_basedir = NULL,
+                     bool triangulate = true);
+
+#endif // OBJPARSER_H
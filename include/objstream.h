@@ -0,0 +1,49 @@
+#ifndef OBJSTREAM_H
+#define OBJSTREAM_H
+
+#include <cstddef>
+#include <string>
+#include "mesharena.h"
+#include "object.h"
+
+// Leitura de ".obj" grandes em fluxo, com tinyobj::LoadObjWithCallback(), sem
+// montar attrib_t/shape_t nem os fluxos completos de MeshData em memória.
+//
+// O arquivo é lido duas vezes. A primeira passada só conta vértices e cantos
+// de faces e calcula a caixa das posições, o que basta para reservar a região
+// da malha na arena (veja "mesharena.h"), no pior caso de nenhum vértice
+// repetido. Na segunda, cada canto de face é codificado no formato de vértice
+// pedido e vai para um bloco de tamanho fixo, enviado à GPU quando enche; os
+// índices fazem o mesmo. No fim, o que sobrou da região volta para a arena.
+//
+// Em memória ficam só as listas de "v", "vn" e "vt" do arquivo (as faces
+// podem referenciar qualquer uma delas) e os blocos. Vértices repetidos são
+// unificados por uma tabela de tamanho fixo com os cantos mais recentes, o que
+// pega os vértices compartilhados por faces vizinhas; diferente de
+// BuildMeshData(), não há unificação global, otimização de ordem, níveis de
+// detalhe, meshlets nem cache binário.
+//
+// Se o arquivo não tiver nenhum "vn", as normais são calculadas como em
+// ComputeNormals() (uma por posição, com peso de área): a segunda passada
+// soma as normais das faces em cada posição e só guarda a posição e a
+// textura de cada vértice, que são codificados e enviados no fim.
+
+// Vértices e índices por bloco enviado à GPU.
+#define OBJ_STREAM_BLOCK_VERTICES 65536
+#define OBJ_STREAM_BLOCK_INDICES  (3 * 65536)
+
+// ".obj" a partir deste tamanho são lidos em fluxo por LoadModel() em
+// "main.cpp".
+#define OBJ_STREAM_MIN_FILE_SIZE (64 * 1024 * 1024)
+
+// true se "filename" é um ".obj" com pelo menos OBJ_STREAM_MIN_FILE_SIZE bytes.
+bool ShouldStreamObj(const char* filename);
+
+// Lê o modelo e envia a malha para a arena; "allocation" recebe a região. O
+// modelo retornado (alocado com new) tem os materiais, as bounding boxes e
+// os shapes de "mesh", com os fluxos vazios. Retorna NULL em caso de erro;
+// neste caso "err" descreve o problema. Deve ser chamada com um contexto
+// OpenGL ativo.
+ObjModel* StreamObjToArena(const char* filename, VertexFormat format, MeshAllocation* allocation, std::string* err);
+
+#endif // OBJSTREAM_H
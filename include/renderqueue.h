@@ -0,0 +1,144 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include "scene.h"
+#include "texturearray.h"
+
+// Fila de desenho. Em vez de desenhar na hora, o código do jogo envia pacotes
+// (objeto da cena, material, transformação, passada) com RenderQueue_Submit()
+// e a fila desenha todos de uma vez em RenderQueue_Flush().
+//
+// Cada pacote ganha uma chave de 64 bits, do campo mais significativo para o
+// menos significativo:
+//
+//   passada (4) | programa (6) | array de texturas (8) | VAO (6) | material (14) | objeto (10) | profundidade (16)
+//
+// Os pacotes são ordenados pela chave com um radix sort (LSD, 8 bits por vez,
+// estável: pacotes com a mesma chave ficam na ordem de envio). Assim os
+// pacotes que usam o mesmo estado ficam juntos e, dentro de cada grupo, são
+// desenhados de frente para trás, o que ajuda o teste de profundidade. Na
+// hora de desenhar, a fila lembra o estado atual (programa, descarte de
+// faces, VAO, textura e o valor de cada uniform) e só chama o OpenGL para o
+// que muda.
+//
+// Os dados de cada pacote que mudam de um desenho para outro (matriz
+// "model", object_id e camada da textura) não são uniforms: vão para um
+// buffer de instâncias, enviado uma vez por quadro e lido pelo Vertex Shader
+// como atributos com divisor 1 (locations 3 a 7, veja "shader_vertex.glsl").
+// Pacotes seguidos do mesmo objeto, com o mesmo material, estado e nível de
+// detalhe, viram uma única chamada glDrawElementsInstancedBaseVertex().
+// Objetos desenhados por meshlets são descartados por instância e não são
+// agrupados.
+//
+// O resto dos dados chega aos shaders por blocos de uniforms (std140, veja
+// "shader_vertex.glsl"), não por glUniform*():
+//
+//   FrameData     (ponto 0): view, projection, posição da câmera e luz;
+//                            enviado uma vez por quadro.
+//   MaterialTable (ponto 1): Kd, Ka, Ks e q de até RENDER_MAX_MATERIALS
+//                            materiais, enviados quando o modelo é carregado
+//                            (RenderQueue_AddMaterials()). A posição do
+//                            material na tabela é o campo "material" da chave.
+//   DrawData      (ponto 2): posição do material na tabela, material_id,
+//                            lighting_model e decodificação das posições. Os
+//                            registros de todas as chamadas do quadro vão
+//                            para um buffer, enviado uma vez; cada chamada só
+//                            liga o seu registro com glBindBufferRange().
+
+// Materiais na tabela de materiais, contando a posição 0 (sem material). Deve
+// ser igual ao tamanho do array em "shader_vertex.glsl" e
+// "shader_fragment.glsl".
+#define RENDER_MAX_MATERIALS 256
+
+// Programa de GPU usado pela fila. Os seus blocos de uniforms devem ser
+// ligados com RenderQueue_InitProgram().
+struct RenderProgram
+{
+    GLuint id;
+
+    RenderProgram() : id(0) {}
+};
+
+// Luz direcional da cena, enviada no bloco FrameData.
+struct RenderLight
+{
+    glm::vec4 direction; // Sentido da fonte de luz, a partir do ponto iluminado (normalizado no shader)
+    glm::vec3 color;     // Espectro da fonte de luz
+    glm::vec3 ambient;   // Espectro da luz ambiente
+
+    RenderLight() : direction(0.0f, 1.0f, 0.0f, 0.0f), color(1.0f), ambient(0.0f) {}
+};
+
+// Passadas, na ordem em que são desenhadas.
+enum RenderPass
+{
+    RENDER_PASS_OPAQUE       = 0, // Com descarte das faces de trás
+    RENDER_PASS_DOUBLE_SIDED = 1, // Sem descarte de faces (planos vistos dos dois lados)
+};
+
+struct RenderPacket
+{
+    SceneObjectHandle          object;
+    const RenderProgram*       program;
+    const tinyobj::material_t* material;       // NULL = material do próprio objeto
+    TextureLayer               texture;        // Array -1 = textura do material do objeto
+    glm::mat4                  model;          // Matriz "model" da instância
+    int                        object_id;      // "object_id" da instância
+    int                        lighting_model; // Uniform "lighting_model"
+    RenderPass                 pass;
+
+    RenderPacket()
+        : program(NULL), material(NULL), model(1.0f), object_id(0), lighting_model(0), pass(RENDER_PASS_OPAQUE)
+    {
+    }
+};
+
+// Contadores de um RenderQueue_Flush().
+struct RenderQueueStats
+{
+    size_t packets;
+    size_t draws;         // Chamadas glDraw*; uma chamada instanciada conta uma vez
+    size_t state_changes; // Trocas de programa, descarte de faces, VAO, textura e buffer de instâncias
+    size_t uniforms;      // Envios e ligações (glBindBufferRange) dos blocos de uniforms
+
+    RenderQueueStats() : packets(0), draws(0), state_changes(0), uniforms(0) {}
+};
+
+// Começa um quadro. "view" e "projection" são usadas para a profundidade da
+// chave, a escolha do nível de detalhe e o descarte de meshlets;
+// "screen_height" é a altura da janela em pixels. As matrizes e a luz vão
+// para o bloco FrameData.
+void RenderQueue_Begin(const glm::mat4& view, const glm::mat4& projection, float screen_height,
+                       const RenderLight& light);
+
+// Acrescenta um pacote. Pacotes com um objeto que não está mais na cena são
+// ignorados.
+void RenderQueue_Submit(const RenderPacket& packet);
+
+// Ordena e desenha os pacotes enviados desde RenderQueue_Begin(). O estado
+// do OpenGL antes da chamada é desconhecido para a fila, que liga tudo o que
+// o primeiro pacote usa.
+void RenderQueue_Flush();
+
+// Liga os blocos de uniforms do programa aos pontos usados pela fila. Deve ser
+// chamada a cada programa criado, antes de usá-lo nos pacotes.
+void RenderQueue_InitProgram(GLuint program);
+
+// Põe os materiais na tabela de materiais e a envia. Materiais que chegam em
+// pacotes sem terem sido acrescentados entram na tabela em
+// RenderQueue_Submit() e são enviados em RenderQueue_Flush(). Se a tabela
+// encher, os que sobram são desenhados sem material (com um aviso).
+void RenderQueue_AddMaterials(const tinyobj::material_t* materials, size_t count);
+
+// Tira os materiais da tabela, liberando as posições. Deve ser chamada
+// enquanto os materiais ainda existem.
+void RenderQueue_RemoveMaterials(const tinyobj::material_t* materials, size_t count);
+
+// Contadores do último RenderQueue_Flush().
+const RenderQueueStats& RenderQueue_Stats();
+
+#endif // RENDERQUEUE_H
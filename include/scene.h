@@ -0,0 +1,75 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+#include "assets.h"
+#include "meshlets.h"
+#include "texturearray.h"
+
+// Cena virtual: os objetos (shapes dos modelos) prontos para desenhar,
+// guardados em um vetor contíguo e acessados por handles (índice + geração),
+// como os recursos de "assets.h". O nome de um objeto só é usado para achar o
+// seu handle, uma única vez na preparação da cena; o laço de renderização só
+// indexa o vetor.
+//
+// Os dados ficam divididos em duas partes: SceneObject tem só o que o desenho
+// lê, lado a lado no vetor; o nome e a geração de cada posição ficam em
+// vetores separados, fora do caminho do desenho.
+
+// Nível de detalhe simplificado de um objeto (veja "meshsimplify.h"). O nível
+// 0 é o próprio intervalo first_index/num_indices do SceneObject.
+struct SceneObjectLod
+{
+    size_t       first_index; // Índice do primeiro índice do nível dentro do IBO da arena de malhas
+    size_t       num_indices; // Número de índices do nível
+    float        error;       // Erro geométrico em relação ao nível 0, no espaço do modelo
+};
+
+// Dados necessários para renderizar cada objeto da cena virtual.
+struct SceneObject
+{
+    size_t       first_index; // Índice do primeiro índice do objeto dentro do IBO da arena de malhas (veja "mesharena.h")
+    size_t       num_indices; // Número de índices do objeto
+    GLenum       rendering_mode; // Modo de rasterização (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
+    GLuint       vertex_array_object_id; // ID do VAO compartilhado pelo formato de vértice do modelo
+    GLint        base_vertex; // Posição do primeiro vértice do modelo dentro do VBO da arena
+    int          material_id; // ID do material associado ao objeto (-1 se não tiver material)
+    ModelHandle  model;       // Modelo de origem, com os materiais (veja "assets.h")
+    TextureLayer texture;     // Textura difusa do material (veja "texturearray.h"), se houver
+    GLenum       index_type;  // GL_UNSIGNED_SHORT ou GL_UNSIGNED_INT, conforme o número de vértices do modelo
+    glm::vec3    position_offset; // Intervalo de quantização das posições (veja "mesh.h")
+    glm::vec3    position_scale;
+    std::vector<SceneObjectLod> lods; // Níveis de detalhe, do mais fino ao mais grosseiro
+    std::vector<Meshlet> meshlets; // Meshlets do nível 0 (veja "meshlets.h"), com first_index dentro do IBO da arena
+    glm::vec3    bounding_center; // Esfera envolvente local, usada na escolha do nível de detalhe
+    float        bounding_radius;
+};
+
+struct SceneObjectHandle
+{
+    uint32_t index;
+    uint32_t generation; // 0 = handle vazio
+
+    SceneObjectHandle() : index(0), generation(0) {}
+};
+
+// Acrescenta um objeto à cena. Se já houver um objeto com o mesmo nome, ele é
+// substituído e os handles antigos deixam de valer.
+SceneObjectHandle Scene_Add(const std::string& name, const SceneObject& object);
+
+// Handle do objeto com este nome; vazio se não houver. Para ser usada na
+// preparação da cena, não a cada quadro.
+SceneObjectHandle Scene_Find(const std::string& name);
+
+// NULL se o handle não vale mais.
+const SceneObject* Scene_Get(SceneObjectHandle handle);
+
+// Tira o objeto da cena; a posição é reusada pelo próximo Scene_Add().
+void Scene_Remove(SceneObjectHandle handle);
+
+#endif // SCENE_H
@@ -0,0 +1,66 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "mappedfile.h"
+
+// Formatos de pixel das texturas prontas para a GPU. As cores estão sempre em
+// sRGB; o canal alfa, quando existe, é linear. Os formatos BCn são comprimidos
+// em blocos de 4x4 pixels (veja "texturecompress.h").
+enum TextureFormat
+{
+    TEXTURE_FORMAT_SRGB8        = 0, // R, G, B (3 bytes por pixel)
+    TEXTURE_FORMAT_SRGB8_ALPHA8 = 1, // R, G, B, A (4 bytes por pixel)
+    TEXTURE_FORMAT_BC1_SRGB     = 2, // BC1/DXT1, sem alfa (8 bytes por bloco)
+    TEXTURE_FORMAT_BC3_SRGB     = 3, // BC3/DXT5, com alfa (16 bytes por bloco)
+};
+
+// Um nível de mipmap. "data" aponta para "size" bytes, com as linhas
+// consecutivas e sem preenchimento (GL_UNPACK_ALIGNMENT = 1).
+struct TextureLevel
+{
+    uint32_t             width;
+    uint32_t             height;
+    const unsigned char* data;
+    size_t               size;
+};
+
+// Textura com a cadeia completa de mipmaps (até 1x1), já no formato em que é
+// enviada para a GPU com glTexImage2D(), nível por nível. Como em MeshStream
+// ("mesh.h"), os bytes ficam em "storage" quando a cadeia é construída agora, ou
+// nas páginas de "mapping" quando vêm do cache (veja "texturecache.h").
+struct TextureData
+{
+    TextureFormat             format;
+    std::vector<TextureLevel> levels;
+
+    std::vector<unsigned char>  storage;
+    std::shared_ptr<MappedFile> mapping;
+
+    TextureData() : format(TEXTURE_FORMAT_SRGB8) {}
+
+    bool   Empty() const { return levels.empty(); }
+    size_t Size() const;
+};
+
+bool TextureFormatIsCompressed(TextureFormat format);
+
+// Tamanho em bytes de um nível width x height no formato dado. Nos formatos
+// comprimidos as dimensões são arredondadas para múltiplos de 4.
+size_t TextureLevelSize(TextureFormat format, uint32_t width, uint32_t height);
+
+// Número de níveis da cadeia completa de uma imagem width x height.
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+// Constrói a cadeia de mipmaps de uma imagem sRGB de 3 ou 4 canais. Cada nível
+// é reduzido a partir do anterior com um filtro separável (tenda com raio
+// igual ao fator de redução, [1 3 3 1]/8 quando a dimensão cai pela metade),
+// calculado em luz linear: as cores são convertidas de sRGB para linear antes
+// da média e de volta depois dela, o que evita que os níveis menores escureçam.
+void BuildTextureData(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t channels,
+                      TextureData* texture);
+
+#endif // TEXTURE_H
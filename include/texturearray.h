@@ -0,0 +1,64 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <cstdint>
+#include <glad/glad.h>
+#include "texture.h"
+
+// Todas as texturas da cena ficam em arrays de texturas (GL_TEXTURE_2D_ARRAY),
+// agrupadas por formato e tamanho: texturas com o mesmo formato e as mesmas
+// dimensões são camadas de um mesmo array. O fragment shader lê qualquer uma
+// delas com uma única consulta ao sampler2DArray "TextureArray", usando a
+// camada do material; desenhos com materiais diferentes só precisam trocar a
+// textura ligada quando o array muda.
+//
+// As camadas são reservadas antes do envio (TextureArrays_Reserve()), quando só
+// as dimensões são conhecidas, e a memória dos arrays é alocada de uma vez por
+// TextureArrays_Allocate(). Um array alocado não cresce mais: reservas
+// posteriores do mesmo formato e tamanho abrem um novo array. Camadas
+// liberadas (TextureArrays_Release()) não são reusadas; a memória do array só
+// volta quando todas as suas camadas forem liberadas.
+//
+// Os níveis de cada camada podem chegar aos poucos, do menor para o maior
+// (veja "texturestream.h"). Logo após a alocação cada camada tem só o menor
+// nível, branco; o GL_TEXTURE_BASE_LEVEL do array acompanha o nível mais fino
+// já presente em todas as suas camadas, de forma que níveis ainda não enviados
+// nunca são amostrados.
+
+// Unidade de textura usada pelos arrays.
+#define TEXTURE_ARRAY_UNIT 0
+
+// Posição de uma textura nos arrays. "array" é -1 quando não há textura.
+struct TextureLayer
+{
+    int array;
+    int layer;
+
+    TextureLayer() : array(-1), layer(-1) {}
+};
+
+// Reserva uma camada para uma textura com a cadeia completa de mipmaps.
+TextureLayer TextureArrays_Reserve(TextureFormat format, uint32_t width, uint32_t height);
+
+// Aloca na GPU os arrays que receberam reservas desde a última chamada.
+void TextureArrays_Allocate();
+
+// Envia um nível de uma camada. "pixels" é um ponteiro para a memória ou, se
+// houver um GL_PIXEL_UNPACK_BUFFER ligado, o deslocamento dentro dele. Os
+// níveis de uma camada devem ser enviados do menor para o maior.
+void TextureArrays_UploadLevel(const TextureLayer& layer, uint32_t level, uint32_t width, uint32_t height,
+                               size_t size, const void* pixels);
+
+// Libera uma camada. O array é apagado quando a última camada sai.
+void TextureArrays_Release(const TextureLayer& layer);
+
+// Memória ocupada pelos arrays já alocados, em bytes.
+size_t TextureArrays_MemoryUsage();
+
+// Liga o array na unidade TEXTURE_ARRAY_UNIT, se ele ainda não estiver ligado.
+void TextureArrays_Bind(int array);
+
+// Imprime o número de arrays, de camadas e a memória ocupada.
+void TextureArrays_PrintStats();
+
+#endif // TEXTUREARRAY_H
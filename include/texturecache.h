@@ -0,0 +1,26 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <string>
+#include "texture.h"
+
+// Cache binário das texturas carregadas de imagens JPEG/PNG.
+//
+// O arquivo "<imagem>.texcache" guarda a cadeia completa de mipmaps de
+// BuildTextureData() ("texture.h"), nível por nível, exatamente como é enviada
+// para a GPU: sem compressão ou já codificada em BCn por
+// CompressTextureData() ("texturecompress.h"). Assim como o cache de malhas
+// ("meshcache.h"), ele é identificado pelo caminho, tamanho e data de
+// modificação da imagem original e pela versão abaixo; se algo mudar, é ignorado e reconstruído. Nas execuções seguintes o
+// arquivo é mapeado em memória e os níveis são enviados direto das páginas
+// mapeadas, sem decodificar a imagem nem chamar glGenerateMipmap().
+//
+// Incremente TEXTURE_CACHE_VERSION sempre que o layout do arquivo ou o
+// conteúdo dos níveis mudar.
+#define TEXTURE_CACHE_VERSION 1
+
+std::string TextureCacheFilename(const std::string& image_filename);
+bool LoadTextureCache(const std::string& image_filename, bool compressed, TextureData* texture);
+bool SaveTextureCache(const std::string& image_filename, const TextureData& texture);
+
+#endif // TEXTURECACHE_H
@@ -0,0 +1,28 @@
+#ifndef TEXTURECOMPRESS_H
+#define TEXTURECOMPRESS_H
+
+#include "texture.h"
+
+// Compressão de texturas na CPU para os formatos de blocos BCn, que a GPU lê
+// diretamente (glCompressedTexImage2D) ocupando de 4x a 8x menos memória que
+// os formatos sem compressão:
+//
+//   TEXTURE_FORMAT_SRGB8        -> TEXTURE_FORMAT_BC1_SRGB (4 bits por pixel)
+//   TEXTURE_FORMAT_SRGB8_ALPHA8 -> TEXTURE_FORMAT_BC3_SRGB (8 bits por pixel)
+//
+// As cores de cada bloco de 4x4 pixels são aproximadas por dois extremos no
+// eixo principal das cores do bloco (análise de componentes principais), que
+// depois são refinados por mínimos quadrados. As cores são codificadas no
+// próprio espaço sRGB, como a GPU as decodifica.
+//
+// Cada nível de "source" é comprimido separadamente; as linhas de blocos são
+// divididas entre as threads do pool (veja "threadpool.h").
+void CompressTextureData(const TextureData& source, TextureData* destination);
+
+// Texturas pequenas (menos de TEXTURE_COMPRESS_MIN_SIZE pixels no maior lado)
+// ficam sem compressão: economizam muito pouco e, como as do skybox, costumam
+// aparecer bem ampliadas na tela, onde os blocos de 4x4 ficariam visíveis.
+#define TEXTURE_COMPRESS_MIN_SIZE 256
+bool ShouldCompressTexture(uint32_t width, uint32_t height);
+
+#endif // TEXTURECOMPRESS_H
@@ -0,0 +1,66 @@
+#ifndef TEXTURESTREAM_H
+#define TEXTURESTREAM_H
+
+#include <cstddef>
+#include <vector>
+#include "texturearray.h"
+
+// Carregamento progressivo das texturas. TextureStream_Begin() só lê o
+// cabeçalho das imagens e reserva as suas camadas nos arrays de texturas
+// (veja "texturearray.h"), que começam brancas; o resto do trabalho (cache,
+// decodificação, mipmaps e compressão) roda nas threads do pool. A cada quadro
+// TextureStream_Update() envia para a GPU os níveis já prontos, dos menores
+// para os maiores, até gastar o orçamento de bytes do quadro. Assim a cena
+// aparece logo nos primeiros quadros, com as texturas borradas, e os níveis
+// grandes chegam aos poucos, sem travar nenhum quadro.
+//
+// Os níveis de cada quadro são copiados para um pixel buffer object
+// (GL_PIXEL_UNPACK_BUFFER), descartado e realocado a cada quadro, e enviados
+// a partir dele; a cópia para a memória da textura fica com o driver.
+
+// Orçamento padrão de envio por quadro, em bytes. Um nível maior que o
+// orçamento é enviado sozinho em um quadro.
+#define TEXTURE_STREAM_FRAME_BUDGET (4 * 1024 * 1024)
+
+// Níveis de qualidade das texturas. O valor é o número de níveis de mipmap
+// descartados no topo da cadeia: em TEXTURE_QUALITY_HALF uma imagem de
+// 4096x4096 vai para a GPU com 2048x2048, reduzida pelo mesmo filtro em luz
+// linear que gera os mipmaps (veja "texture.h").
+enum TextureQuality
+{
+    TEXTURE_QUALITY_FULL    = 0,
+    TEXTURE_QUALITY_HALF    = 1,
+    TEXTURE_QUALITY_QUARTER = 2,
+};
+
+// Nenhuma textura é reduzida para menos que isto no maior lado, seja pelo
+// nível de qualidade ou pelo orçamento de memória.
+#define TEXTURE_MIN_REDUCED_SIZE 64
+
+struct TextureLoadOptions
+{
+    bool           compress;       // Comprime as texturas em BCn (veja "texturecompress.h")
+    TextureQuality quality;
+    size_t         memory_budget;  // Bytes na GPU para todas as texturas; 0 = sem limite
+};
+
+// Começa a carregar as imagens. "layers" recebe a camada de cada imagem, na
+// ordem de "filenames".
+//
+// Se as texturas (somadas às já carregadas) não couberem em
+// "options.memory_budget", a maior delas perde mais um nível, até caberem.
+// A resolução escolhida e a memória de cada textura aparecem no relatório.
+void TextureStream_Begin(const char* const* filenames, size_t count, const TextureLoadOptions& options,
+                         std::vector<TextureLayer>* layers);
+
+// Envia até "budget" bytes de níveis prontos (pelo menos um nível, se houver
+// algum pronto). Deve ser chamada uma vez por quadro.
+void TextureStream_Update(size_t budget);
+
+// Espera todas as texturas ficarem prontas e as envia por inteiro.
+void TextureStream_Finish();
+
+// true enquanto alguma textura ainda não foi enviada por inteiro.
+bool TextureStream_Pending();
+
+#endif // TEXTURESTREAM_H
@@ -0,0 +1,49 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Conjunto fixo de threads que executam tarefas de uma fila. Usado nas etapas
+// de carregamento que podem ser paralelizadas (leitura de modelos, texturas,
+// etc.).
+class ThreadPool
+{
+public:
+    // num_threads == 0 usa o número de núcleos da máquina.
+    explicit ThreadPool(unsigned num_threads = 0);
+    ~ThreadPool();
+
+    // Coloca uma tarefa na fila. O future fica pronto quando ela terminar.
+    std::future<void> Submit(const std::function<void()>& task);
+
+    unsigned NumThreads() const { return (unsigned)workers.size(); }
+
+private:
+    ThreadPool(const ThreadPool&);            // Não copiável
+    ThreadPool& operator=(const ThreadPool&);
+
+    void WorkerLoop();
+
+    std::vector<std::thread>                       workers;
+    std::deque<std::packaged_task<void()> >        tasks;
+    std::mutex                                     mutex;
+    std::condition_variable                        condition;
+    bool                                           stopping;
+};
+
+// Pool compartilhado pelo programa inteiro, criado no primeiro uso.
+ThreadPool& GetThreadPool();
+
+// Executa body(i) para todo i em [0, count), dividindo os índices entre as
+// threads do pool e a thread que chamou a função. Retorna quando todos os
+// índices foram processados.
+void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+#endif // THREADPOOL_H
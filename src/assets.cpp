@@ -0,0 +1,338 @@
+#include "assets.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sys/stat.h>
+#include "mappedfile.h"
+
+namespace {
+
+struct AssetSlot
+{
+    std::vector<std::string> paths;        // Caminhos pelos quais o recurso foi pedido
+    uint64_t                 content_hash; // Calculado só quando aparece outro arquivo de mesmo tamanho
+    bool                     content_hashed;
+    size_t                   content_size;
+    uint32_t                 generation;
+    uint32_t                 references;   // 0 = posição livre
+};
+
+// Parte comum aos dois tipos de recurso: posições, gerações e buscas pelo
+// caminho e pelo conteúdo. A busca pelo conteúdo começa pelo tamanho do
+// arquivo, que não exige lê-lo; o conteúdo só é lido quando há outro recurso
+// com o mesmo tamanho.
+struct AssetTable
+{
+    std::vector<AssetSlot>             slots;
+    std::vector<uint32_t>              free_slots;
+    std::map<std::string, uint32_t>    by_path;
+    std::multimap<size_t, uint32_t>    by_size;
+
+    size_t                             path_hits;
+    size_t                             content_hits;
+
+    AssetTable() : path_hits(0), content_hits(0) {}
+};
+
+AssetTable               g_Models;
+std::vector<ModelAsset>  g_ModelAssets;  // Mesma posição de g_Models.slots
+AssetTable               g_Images;
+std::vector<TextureLayer> g_ImageLayers; // Mesma posição de g_Images.slots
+
+// FNV-1a do conteúdo do arquivo, 8 bytes por vez (e byte a byte no final).
+// Retorna false se o arquivo não puder ser aberto.
+bool HashContent(const std::string& path, uint64_t* hash)
+{
+    MappedFile file;
+    if (!file.Open(path.c_str()))
+        return false;
+
+    const unsigned char* data = file.Data();
+    size_t i = 0;
+    uint64_t h = 14695981039346656037ULL;
+    for (; i + 8 <= file.Size(); i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h ^= word;
+        h *= 1099511628211ULL;
+    }
+    for (; i < file.Size(); ++i)
+    {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    *hash = h;
+    return true;
+}
+
+bool FileSize(const std::string& path, size_t* size)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    *size = (size_t)st.st_size;
+    return true;
+}
+
+bool SameContent(const std::string& a, const std::string& b)
+{
+    MappedFile file_a, file_b;
+    return file_a.Open(a.c_str()) && file_b.Open(b.c_str()) && file_a.Size() == file_b.Size()
+        && memcmp(file_a.Data(), file_b.Data(), file_a.Size()) == 0;
+}
+
+std::string Dirname(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash != std::string::npos ? path.substr(0, slash + 1) : std::string();
+}
+
+// Procura um recurso pelo caminho e depois pelo conteúdo; um recurso achado
+// pelo conteúdo passa a ser achado também pelo novo caminho. Retorna a
+// posição, ou -1. Não mexe nas referências.
+int Find(AssetTable& table, const std::string& path, bool same_directory)
+{
+    std::map<std::string, uint32_t>::const_iterator it = table.by_path.find(path);
+    if (it != table.by_path.end())
+    {
+        table.path_hits++;
+        return (int)it->second;
+    }
+
+    size_t size;
+    if (!FileSize(path, &size))
+        return -1;
+
+    // Só um arquivo de mesmo tamanho pode ter o mesmo conteúdo; sem nenhum,
+    // o arquivo nem é lido.
+    typedef std::multimap<size_t, uint32_t>::const_iterator SizeIterator;
+    std::pair<SizeIterator, SizeIterator> range = table.by_size.equal_range(size);
+    bool     hashed = false;
+    uint64_t hash = 0;
+    for (SizeIterator c = range.first; c != range.second; ++c)
+    {
+        AssetSlot& slot = table.slots[c->second];
+        if (same_directory && Dirname(slot.paths[0]) != Dirname(path))
+            continue;
+
+        if (!hashed && !HashContent(path, &hash))
+            return -1;
+        hashed = true;
+        if (!slot.content_hashed)
+            slot.content_hashed = HashContent(slot.paths[0], &slot.content_hash);
+
+        if (!slot.content_hashed || slot.content_hash != hash || !SameContent(slot.paths[0], path))
+            continue;
+        slot.paths.push_back(path);
+        table.by_path[path] = c->second;
+        table.content_hits++;
+        return (int)c->second;
+    }
+    return -1;
+}
+
+// Registra um recurso novo, com uma referência.
+uint32_t Insert(AssetTable& table, const std::string& path)
+{
+    uint32_t index;
+    if (!table.free_slots.empty())
+    {
+        index = table.free_slots.back();
+        table.free_slots.pop_back();
+    }
+    else
+    {
+        index = (uint32_t)table.slots.size();
+        table.slots.push_back(AssetSlot());
+        table.slots.back().generation = 1;
+    }
+
+    AssetSlot& slot = table.slots[index];
+    slot.paths.assign(1, path);
+    slot.references = 1;
+    slot.content_hash = 0;
+    slot.content_hashed = false;
+    slot.content_size = 0;
+    FileSize(path, &slot.content_size);
+    table.by_path[path] = index;
+    table.by_size.insert(std::make_pair(slot.content_size, index));
+    return index;
+}
+
+// Tira o recurso das buscas e invalida os handles que apontam para ele.
+void Remove(AssetTable& table, uint32_t index)
+{
+    AssetSlot& slot = table.slots[index];
+    for (size_t p = 0; p < slot.paths.size(); ++p)
+        table.by_path.erase(slot.paths[p]);
+
+    typedef std::multimap<size_t, uint32_t>::iterator SizeIterator;
+    std::pair<SizeIterator, SizeIterator> range = table.by_size.equal_range(slot.content_size);
+    for (SizeIterator c = range.first; c != range.second; ++c)
+    {
+        if (c->second == index)
+        {
+            table.by_size.erase(c);
+            break;
+        }
+    }
+
+    slot.paths.clear();
+    slot.references = 0;
+    if (++slot.generation == 0)
+        slot.generation = 1;
+    table.free_slots.push_back(index);
+}
+
+bool IsValid(const AssetTable& table, uint32_t index, uint32_t generation)
+{
+    return generation != 0 && index < table.slots.size() && table.slots[index].generation == generation
+        && table.slots[index].references > 0;
+}
+
+size_t CountLoaded(const AssetTable& table)
+{
+    return table.slots.size() - table.free_slots.size();
+}
+
+} // namespace
+
+ModelHandle Assets_FindModel(const char* filename)
+{
+    ModelHandle handle;
+    int index = Find(g_Models, filename, true);
+    if (index >= 0)
+    {
+        g_Models.slots[index].references++;
+        handle.index      = (uint32_t)index;
+        handle.generation = g_Models.slots[index].generation;
+    }
+    return handle;
+}
+
+ModelHandle Assets_AddModel(const char* filename, ObjModel* model)
+{
+    ModelHandle handle;
+    handle.index      = Insert(g_Models, filename);
+    handle.generation = g_Models.slots[handle.index].generation;
+
+    g_ModelAssets.resize(g_Models.slots.size());
+    g_ModelAssets[handle.index] = ModelAsset();
+    g_ModelAssets[handle.index].model = model;
+    return handle;
+}
+
+ModelAsset* Assets_GetModel(ModelHandle handle)
+{
+    return IsValid(g_Models, handle.index, handle.generation) ? &g_ModelAssets[handle.index] : NULL;
+}
+
+void Assets_AcquireModel(ModelHandle handle)
+{
+    if (IsValid(g_Models, handle.index, handle.generation))
+        g_Models.slots[handle.index].references++;
+}
+
+uint32_t Assets_ModelReferences(ModelHandle handle)
+{
+    if (!IsValid(g_Models, handle.index, handle.generation))
+        return 0;
+    return g_Models.slots[handle.index].references;
+}
+
+bool Assets_ReleaseModel(ModelHandle handle)
+{
+    if (!IsValid(g_Models, handle.index, handle.generation) || --g_Models.slots[handle.index].references > 0)
+        return false;
+
+    ModelAsset& asset = g_ModelAssets[handle.index];
+    if (asset.allocation.vertex_bytes > 0 || asset.allocation.index_bytes > 0)
+        MeshArena_Free(asset.allocation);
+    for (size_t i = 0; i < asset.images.size(); ++i)
+        Assets_ReleaseImage(asset.images[i]);
+    delete asset.model;
+    asset = ModelAsset();
+
+    Remove(g_Models, handle.index);
+    return true;
+}
+
+void Assets_LoadImages(const char* const* filenames, size_t count, const TextureLoadOptions& options,
+                       std::vector<ImageHandle>* handles)
+{
+    // As imagens novas são registradas antes de irem para a GPU, de forma que
+    // repetições na própria lista já as encontram.
+    std::vector<const char*> new_filenames;
+    std::vector<uint32_t>    new_slots;
+    handles->resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        int index = Find(g_Images, filenames[i], false);
+        if (index >= 0)
+            g_Images.slots[index].references++;
+        else
+        {
+            index = (int)Insert(g_Images, filenames[i]);
+            new_filenames.push_back(filenames[i]);
+            new_slots.push_back((uint32_t)index);
+        }
+        (*handles)[i].index      = (uint32_t)index;
+        (*handles)[i].generation = g_Images.slots[index].generation;
+    }
+
+    if (new_filenames.empty())
+        return;
+
+    std::vector<TextureLayer> layers;
+    TextureStream_Begin(new_filenames.data(), new_filenames.size(), options, &layers);
+    g_ImageLayers.resize(g_Images.slots.size());
+    for (size_t i = 0; i < new_slots.size(); ++i)
+        g_ImageLayers[new_slots[i]] = layers[i];
+}
+
+ImageHandle Assets_FindImage(const std::string& filename)
+{
+    ImageHandle handle;
+    std::map<std::string, uint32_t>::const_iterator it = g_Images.by_path.find(filename);
+    if (it != g_Images.by_path.end())
+    {
+        handle.index      = it->second;
+        handle.generation = g_Images.slots[it->second].generation;
+    }
+    return handle;
+}
+
+TextureLayer Assets_GetImage(ImageHandle handle)
+{
+    return IsValid(g_Images, handle.index, handle.generation) ? g_ImageLayers[handle.index] : TextureLayer();
+}
+
+void Assets_AcquireImage(ImageHandle handle)
+{
+    if (IsValid(g_Images, handle.index, handle.generation))
+        g_Images.slots[handle.index].references++;
+}
+
+void Assets_ReleaseImage(ImageHandle handle)
+{
+    if (!IsValid(g_Images, handle.index, handle.generation) || --g_Images.slots[handle.index].references > 0)
+        return;
+
+    // Os envios pendentes escrevem direto nas camadas reservadas.
+    if (TextureStream_Pending())
+        TextureStream_Finish();
+    TextureArrays_Release(g_ImageLayers[handle.index]);
+    g_ImageLayers[handle.index] = TextureLayer();
+
+    Remove(g_Images, handle.index);
+}
+
+void Assets_PrintStats()
+{
+    printf("Recursos: %zu modelo(s) (%zu pedido(s) reaproveitados pelo caminho, %zu pelo conteúdo), "
+           "%zu imagem(ns) (%zu pelo caminho, %zu pelo conteúdo)\n",
+           CountLoaded(g_Models), g_Models.path_hits, g_Models.content_hits,
+           CountLoaded(g_Images), g_Images.path_hits, g_Images.content_hits);
+}
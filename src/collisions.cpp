@@ -22,6 +22,21 @@ BoundingBox ComputeLocalBoundingBox(const tinyobj::attrib_t& attrib) {
     return box;
 }
 
+// Calcula a bounding box local de um único shape, considerando apenas os
+// vértices referenciados pelas faces dele
+BoundingBox ComputeShapeBoundingBox(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape) {
+    BoundingBox box;
+    box.min = glm::vec3(std::numeric_limits<float>::max());
+    box.max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < shape.mesh.indices.size(); ++i) {
+        int vi = shape.mesh.indices[i].vertex_index;
+        glm::vec3 v(attrib.vertices[3*vi], attrib.vertices[3*vi+1], attrib.vertices[3*vi+2]);
+        box.min = glm::min(box.min, v);
+        box.max = glm::max(box.max, v);
+    }
+    return box;
+}
+
 // Transforma a bounding box local para o mundo usando a model matrix
 BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& model) {
     glm::vec3 corners[8] = {
@@ -0,0 +1,300 @@
+#include "glstate.h"
+
+namespace {
+
+// Valor de um estado desconhecido. Nenhum nome ou enum do OpenGL chega a ele
+// na prática.
+const GLuint UNKNOWN = ~0u;
+
+// Alvos de buffer acompanhados.
+const GLenum BUFFER_TARGETS[] = {
+    GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_COPY_READ_BUFFER,
+    GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_UNIFORM_BUFFER,
+};
+const int NUM_BUFFER_TARGETS = sizeof(BUFFER_TARGETS) / sizeof(BUFFER_TARGETS[0]);
+
+// Pontos de GL_UNIFORM_BUFFER, unidades de textura e alvos de textura
+// acompanhados; os outros são sempre repassados.
+const GLuint NUM_UNIFORM_BINDINGS = 8;
+const GLuint NUM_TEXTURE_UNITS    = 32;
+const GLenum TEXTURE_TARGETS[]    = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY };
+const int    NUM_TEXTURE_TARGETS  = sizeof(TEXTURE_TARGETS) / sizeof(TEXTURE_TARGETS[0]);
+
+struct BufferRange
+{
+    GLuint     buffer;
+    GLintptr   offset;
+    GLsizeiptr size;
+};
+
+struct State
+{
+    GLuint      program;
+    GLuint      vao;
+    GLuint      buffers[NUM_BUFFER_TARGETS];
+    BufferRange uniform_ranges[NUM_UNIFORM_BINDINGS];
+    GLuint      active_unit;
+    GLuint      textures[NUM_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+    GLuint      samplers[NUM_TEXTURE_UNITS];
+    GLuint      blend;      // GL_TRUE, GL_FALSE ou UNKNOWN
+    GLuint      depth_test;
+    GLuint      cull_face;
+    GLenum      blend_source;
+    GLenum      blend_destination;
+    GLenum      depth_func;
+    GLenum      polygon_mode;
+};
+
+State        g_State;
+GLStateStats g_Stats;
+bool         g_Initialized = false;
+
+int BufferTargetIndex(GLenum target)
+{
+    for (int i = 0; i < NUM_BUFFER_TARGETS; ++i)
+        if (BUFFER_TARGETS[i] == target)
+            return i;
+    return -1;
+}
+
+int TextureTargetIndex(GLenum target)
+{
+    for (int i = 0; i < NUM_TEXTURE_TARGETS; ++i)
+        if (TEXTURE_TARGETS[i] == target)
+            return i;
+    return -1;
+}
+
+void Init()
+{
+    if (!g_Initialized)
+        GLState_Invalidate();
+}
+
+// true se "*current" já vale "value"; senão passa a valer. Conta a chamada.
+bool Unchanged(GLuint* current, GLuint value)
+{
+    if (*current == value)
+    {
+        g_Stats.filtered++;
+        return true;
+    }
+    *current = value;
+    g_Stats.issued++;
+    return false;
+}
+
+GLuint* CapabilityState(GLenum capability)
+{
+    switch (capability)
+    {
+    case GL_BLEND:      return &g_State.blend;
+    case GL_DEPTH_TEST: return &g_State.depth_test;
+    case GL_CULL_FACE:  return &g_State.cull_face;
+    default:            return NULL;
+    }
+}
+
+void SetActiveUnit(GLuint unit)
+{
+    if (!Unchanged(&g_State.active_unit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+} // namespace
+
+void GLState_Invalidate()
+{
+    g_State.program = UNKNOWN;
+    g_State.vao     = UNKNOWN;
+    for (int i = 0; i < NUM_BUFFER_TARGETS; ++i)
+        g_State.buffers[i] = UNKNOWN;
+    for (GLuint i = 0; i < NUM_UNIFORM_BINDINGS; ++i)
+        g_State.uniform_ranges[i].buffer = UNKNOWN;
+    g_State.active_unit = UNKNOWN;
+    for (GLuint u = 0; u < NUM_TEXTURE_UNITS; ++u)
+    {
+        for (int t = 0; t < NUM_TEXTURE_TARGETS; ++t)
+            g_State.textures[u][t] = UNKNOWN;
+        g_State.samplers[u] = UNKNOWN;
+    }
+    g_State.blend             = UNKNOWN;
+    g_State.depth_test        = UNKNOWN;
+    g_State.cull_face         = UNKNOWN;
+    g_State.blend_source      = UNKNOWN;
+    g_State.blend_destination = UNKNOWN;
+    g_State.depth_func        = UNKNOWN;
+    g_State.polygon_mode      = UNKNOWN;
+    g_Initialized = true;
+}
+
+void GLState_UseProgram(GLuint program)
+{
+    Init();
+    if (!Unchanged(&g_State.program, program))
+        glUseProgram(program);
+}
+
+void GLState_BindVertexArray(GLuint vao)
+{
+    Init();
+    if (Unchanged(&g_State.vao, vao))
+        return;
+    glBindVertexArray(vao);
+    g_State.buffers[BufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+}
+
+void GLState_BindBuffer(GLenum target, GLuint buffer)
+{
+    Init();
+    int index = BufferTargetIndex(target);
+    if (index < 0)
+    {
+        glBindBuffer(target, buffer);
+        g_Stats.issued++;
+        return;
+    }
+    if (!Unchanged(&g_State.buffers[index], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState_BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    Init();
+    if (target == GL_UNIFORM_BUFFER && index < NUM_UNIFORM_BINDINGS)
+    {
+        BufferRange& range = g_State.uniform_ranges[index];
+        if (range.buffer == buffer && range.offset == offset && range.size == size)
+        {
+            g_Stats.filtered++;
+            return;
+        }
+        range.buffer = buffer;
+        range.offset = offset;
+        range.size   = size;
+    }
+
+    if (size == 0)
+        glBindBufferBase(target, index, buffer);
+    else
+        glBindBufferRange(target, index, buffer, offset, size);
+    g_Stats.issued++;
+
+    int generic = BufferTargetIndex(target);
+    if (generic >= 0)
+        g_State.buffers[generic] = buffer;
+}
+
+void GLState_BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    Init();
+    int index = TextureTargetIndex(target);
+    if (unit >= NUM_TEXTURE_UNITS || index < 0)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        g_Stats.issued += 2;
+        if (unit < NUM_TEXTURE_UNITS)
+            g_State.active_unit = unit;
+        else
+            g_State.active_unit = UNKNOWN;
+        return;
+    }
+    if (g_State.textures[unit][index] == texture)
+    {
+        g_Stats.filtered++;
+        return;
+    }
+    SetActiveUnit(unit);
+    glBindTexture(target, texture);
+    g_State.textures[unit][index] = texture;
+    g_Stats.issued++;
+}
+
+void GLState_BindSampler(GLuint unit, GLuint sampler)
+{
+    Init();
+    if (unit >= NUM_TEXTURE_UNITS)
+    {
+        glBindSampler(unit, sampler);
+        g_Stats.issued++;
+        return;
+    }
+    if (!Unchanged(&g_State.samplers[unit], sampler))
+        glBindSampler(unit, sampler);
+}
+
+void GLState_SetEnabled(GLenum capability, bool enabled)
+{
+    Init();
+    GLuint* current = CapabilityState(capability);
+    if (current != NULL && Unchanged(current, enabled ? GL_TRUE : GL_FALSE))
+        return;
+    if (current == NULL)
+        g_Stats.issued++;
+
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLState_BlendFunc(GLenum source, GLenum destination)
+{
+    Init();
+    if (g_State.blend_source == source && g_State.blend_destination == destination)
+    {
+        g_Stats.filtered++;
+        return;
+    }
+    glBlendFunc(source, destination);
+    g_State.blend_source      = source;
+    g_State.blend_destination = destination;
+    g_Stats.issued++;
+}
+
+void GLState_DepthFunc(GLenum func)
+{
+    Init();
+    if (!Unchanged(&g_State.depth_func, func))
+        glDepthFunc(func);
+}
+
+void GLState_PolygonMode(GLenum mode)
+{
+    Init();
+    if (!Unchanged(&g_State.polygon_mode, mode))
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLState_DeleteBuffer(GLuint buffer)
+{
+    Init();
+    glDeleteBuffers(1, &buffer);
+    for (int i = 0; i < NUM_BUFFER_TARGETS; ++i)
+        if (g_State.buffers[i] == buffer)
+            g_State.buffers[i] = 0;
+    for (GLuint i = 0; i < NUM_UNIFORM_BINDINGS; ++i)
+        if (g_State.uniform_ranges[i].buffer == buffer)
+            g_State.uniform_ranges[i].buffer = 0;
+}
+
+void GLState_DeleteTexture(GLuint texture)
+{
+    Init();
+    glDeleteTextures(1, &texture);
+    for (GLuint u = 0; u < NUM_TEXTURE_UNITS; ++u)
+        for (int t = 0; t < NUM_TEXTURE_TARGETS; ++t)
+            if (g_State.textures[u][t] == texture)
+                g_State.textures[u][t] = 0;
+}
+
+const GLStateStats& GLState_Stats()
+{
+    return g_Stats;
+}
+
+void GLState_ResetStats()
+{
+    g_Stats = GLStateStats();
+}
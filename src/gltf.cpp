@@ -0,0 +1,828 @@
+#include "gltf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// JSON
+
+enum JsonType
+{
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+};
+
+// Os valores ficam todos em um vetor; filhos de arrays e objetos são ligados
+// por índices ("first_child", "next_sibling"). Índice 0 é a raiz.
+struct JsonNode
+{
+    JsonType    type;
+    double      number;      // Também o valor de JSON_BOOL (0 ou 1)
+    std::string string;      // Valor de JSON_STRING
+    std::string key;         // Chave deste valor, se for membro de um objeto
+    int         first_child; // -1 se não houver
+    int         next_sibling;
+};
+
+struct Json
+{
+    std::vector<JsonNode> nodes;
+
+    const JsonNode& Node(int index) const { return nodes[index]; }
+
+    // Membro "key" do objeto "object", ou -1.
+    int Find(int object, const char* key) const
+    {
+        if (object < 0 || nodes[object].type != JSON_OBJECT)
+            return -1;
+        for (int c = nodes[object].first_child; c >= 0; c = nodes[c].next_sibling)
+            if (nodes[c].key == key)
+                return c;
+        return -1;
+    }
+
+    // Elemento "i" do array "array", ou -1.
+    int At(int array, size_t i) const
+    {
+        if (array < 0 || nodes[array].type != JSON_ARRAY)
+            return -1;
+        int c = nodes[array].first_child;
+        for (; c >= 0 && i > 0; --i)
+            c = nodes[c].next_sibling;
+        return c;
+    }
+
+    size_t Size(int array) const
+    {
+        size_t count = 0;
+        if (array >= 0)
+            for (int c = nodes[array].first_child; c >= 0; c = nodes[c].next_sibling)
+                ++count;
+        return count;
+    }
+
+    double Number(int object, const char* key, double fallback) const
+    {
+        int c = Find(object, key);
+        return c >= 0 && (nodes[c].type == JSON_NUMBER || nodes[c].type == JSON_BOOL) ? nodes[c].number : fallback;
+    }
+
+    int Int(int object, const char* key, int fallback) const
+    {
+        return (int)Number(object, key, fallback);
+    }
+
+    std::string String(int object, const char* key) const
+    {
+        int c = Find(object, key);
+        return c >= 0 && nodes[c].type == JSON_STRING ? nodes[c].string : std::string();
+    }
+};
+
+// Analisador recursivo. Aceita só JSON válido (RFC 8259), sem extensões.
+struct JsonParser
+{
+    const char* p;
+    const char* end;
+    Json*       json;
+    std::string error;
+
+    void SkipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            ++p;
+    }
+
+    bool Fail(const char* message)
+    {
+        if (error.empty())
+            error = message;
+        return false;
+    }
+
+    static void AppendUtf8(std::string* out, uint32_t code)
+    {
+        if (code < 0x80)
+            out->push_back((char)code);
+        else if (code < 0x800)
+        {
+            out->push_back((char)(0xC0 | (code >> 6)));
+            out->push_back((char)(0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+            out->push_back((char)(0xE0 | (code >> 12)));
+            out->push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            out->push_back((char)(0x80 | (code & 0x3F)));
+        }
+        else
+        {
+            out->push_back((char)(0xF0 | (code >> 18)));
+            out->push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+            out->push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            out->push_back((char)(0x80 | (code & 0x3F)));
+        }
+    }
+
+    bool ParseHex4(uint32_t* code)
+    {
+        if (end - p < 4)
+            return Fail("escape \\u incompleto");
+        *code = 0;
+        for (int i = 0; i < 4; ++i, ++p)
+        {
+            char c = *p;
+            uint32_t digit = c >= '0' && c <= '9' ? c - '0'
+                           : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                           : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+            if (digit == 16)
+                return Fail("escape \\u inválido");
+            *code = *code * 16 + digit;
+        }
+        return true;
+    }
+
+    bool ParseString(std::string* out)
+    {
+        ++p; // '"'
+        while (p < end && *p != '"')
+        {
+            if (*p != '\\')
+            {
+                out->push_back(*p++);
+                continue;
+            }
+            if (++p >= end)
+                break;
+            char c = *p++;
+            switch (c)
+            {
+            case '"':  out->push_back('"');  break;
+            case '\\': out->push_back('\\'); break;
+            case '/':  out->push_back('/');  break;
+            case 'b':  out->push_back('\b'); break;
+            case 'f':  out->push_back('\f'); break;
+            case 'n':  out->push_back('\n'); break;
+            case 'r':  out->push_back('\r'); break;
+            case 't':  out->push_back('\t'); break;
+            case 'u':
+            {
+                uint32_t code;
+                if (!ParseHex4(&code))
+                    return false;
+                // Par substituto UTF-16.
+                if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                {
+                    p += 2;
+                    uint32_t low;
+                    if (!ParseHex4(&low))
+                        return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, code);
+                break;
+            }
+            default:
+                return Fail("escape inválido em string");
+            }
+        }
+        if (p >= end)
+            return Fail("string sem fim");
+        ++p; // '"'
+        return true;
+    }
+
+    // Analisa um valor e retorna o seu índice em json->nodes, ou -1.
+    int ParseValue(int depth)
+    {
+        SkipSpace();
+        if (p >= end)
+            return Fail("fim inesperado"), -1;
+        if (depth > 64)
+            return Fail("aninhamento profundo demais"), -1;
+
+        int index = (int)json->nodes.size();
+        JsonNode node;
+        node.type = JSON_NULL;
+        node.number = 0.0;
+        node.first_child = -1;
+        node.next_sibling = -1;
+        json->nodes.push_back(node);
+
+        char c = *p;
+        if (c == '{' || c == '[')
+        {
+            bool object = c == '{';
+            json->nodes[index].type = object ? JSON_OBJECT : JSON_ARRAY;
+            ++p;
+            SkipSpace();
+            int last = -1;
+            if (p < end && *p == (object ? '}' : ']'))
+            {
+                ++p;
+                return index;
+            }
+            while (true)
+            {
+                std::string key;
+                if (object)
+                {
+                    SkipSpace();
+                    if (p >= end || *p != '"' || !ParseString(&key))
+                        return Fail("chave esperada"), -1;
+                    SkipSpace();
+                    if (p >= end || *p++ != ':')
+                        return Fail("':' esperado"), -1;
+                }
+                int child = ParseValue(depth + 1);
+                if (child < 0)
+                    return -1;
+                json->nodes[child].key.swap(key);
+                if (last < 0)
+                    json->nodes[index].first_child = child;
+                else
+                    json->nodes[last].next_sibling = child;
+                last = child;
+
+                SkipSpace();
+                if (p < end && *p == ',')
+                {
+                    ++p;
+                    continue;
+                }
+                if (p < end && *p == (object ? '}' : ']'))
+                {
+                    ++p;
+                    return index;
+                }
+                return Fail(object ? "',' ou '}' esperado" : "',' ou ']' esperado"), -1;
+            }
+        }
+        if (c == '"')
+        {
+            std::string value;
+            if (!ParseString(&value))
+                return -1;
+            json->nodes[index].type = JSON_STRING;
+            json->nodes[index].string.swap(value);
+            return index;
+        }
+        if (end - p >= 4 && strncmp(p, "true", 4) == 0)
+        {
+            p += 4;
+            json->nodes[index].type = JSON_BOOL;
+            json->nodes[index].number = 1.0;
+            return index;
+        }
+        if (end - p >= 5 && strncmp(p, "false", 5) == 0)
+        {
+            p += 5;
+            json->nodes[index].type = JSON_BOOL;
+            return index;
+        }
+        if (end - p >= 4 && strncmp(p, "null", 4) == 0)
+        {
+            p += 4;
+            return index;
+        }
+        if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            // strtod precisa de uma string terminada; números são curtos.
+            char buffer[64];
+            size_t length = 0;
+            while (p + length < end && length < sizeof(buffer) - 1
+                   && strchr("+-.eE0123456789", p[length]) != NULL)
+                ++length;
+            memcpy(buffer, p, length);
+            buffer[length] = '\0';
+            char* number_end;
+            json->nodes[index].number = strtod(buffer, &number_end);
+            if (number_end == buffer)
+                return Fail("número inválido"), -1;
+            p += number_end - buffer;
+            json->nodes[index].type = JSON_NUMBER;
+            return index;
+        }
+        return Fail("valor inválido"), -1;
+    }
+};
+
+bool ParseJson(const char* text, size_t size, Json* json, std::string* err)
+{
+    JsonParser parser;
+    parser.p = text;
+    parser.end = text + size;
+    parser.json = json;
+    json->nodes.clear();
+    if (parser.ParseValue(0) != 0)
+    {
+        *err = "JSON inválido: " + parser.error;
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// glTF
+
+const uint32_t GLB_MAGIC      = 0x46546C67; // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+const uint32_t GLB_CHUNK_BIN  = 0x004E4942;
+
+const int COMPONENT_UNSIGNED_BYTE  = 5121;
+const int COMPONENT_UNSIGNED_SHORT = 5123;
+const int COMPONENT_UNSIGNED_INT   = 5125;
+const int COMPONENT_FLOAT          = 5126;
+
+const int MODE_TRIANGLES = 4;
+
+struct GltfBuffer
+{
+    std::shared_ptr<MappedFile> file;
+    const unsigned char*        data;
+    size_t                      size;
+};
+
+// Intervalo de um accessor dentro de um buffer.
+struct Accessor
+{
+    const unsigned char* data;
+    size_t               buffer;
+    size_t               count;
+    size_t               stride;        // Bytes entre elementos consecutivos
+    size_t               element_size;  // Bytes de um elemento
+    int                  component_type;
+    int                  num_components;
+    bool                 has_bounds;
+    float                min[3];
+    float                max[3];
+};
+
+uint32_t ReadU32(const unsigned char* bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, 4);
+    return value;
+}
+
+size_t ComponentSize(int component_type)
+{
+    switch (component_type)
+    {
+    case 5120: case COMPONENT_UNSIGNED_BYTE:  return 1;
+    case 5122: case COMPONENT_UNSIGNED_SHORT: return 2;
+    case COMPONENT_UNSIGNED_INT: case COMPONENT_FLOAT: return 4;
+    }
+    return 0;
+}
+
+int NumComponents(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2")   return 2;
+    if (type == "VEC3")   return 3;
+    if (type == "VEC4")   return 4;
+    if (type == "MAT2")   return 4;
+    if (type == "MAT3")   return 9;
+    if (type == "MAT4")   return 16;
+    return 0;
+}
+
+bool ReadAccessor(const Json& json, const std::vector<GltfBuffer>& buffers, int index, Accessor* accessor,
+                  std::string* err)
+{
+    int node = json.At(json.Find(0, "accessors"), index);
+    if (node < 0)
+        return *err = "accessor inexistente", false;
+    if (json.Find(node, "sparse") >= 0)
+        return *err = "accessors esparsos não são suportados", false;
+
+    accessor->component_type = json.Int(node, "componentType", 0);
+    accessor->num_components = NumComponents(json.String(node, "type"));
+    accessor->count          = (size_t)json.Number(node, "count", 0);
+    accessor->element_size   = ComponentSize(accessor->component_type) * accessor->num_components;
+    if (accessor->element_size == 0)
+        return *err = "accessor com tipo inválido", false;
+
+    int view = json.At(json.Find(0, "bufferViews"), json.Int(node, "bufferView", -1));
+    if (view < 0)
+        return *err = "accessor sem bufferView", false;
+    accessor->buffer = (size_t)json.Int(view, "buffer", -1);
+    if (accessor->buffer >= buffers.size())
+        return *err = "bufferView com buffer inexistente", false;
+
+    size_t view_offset = (size_t)json.Number(view, "byteOffset", 0);
+    size_t view_length = (size_t)json.Number(view, "byteLength", 0);
+    size_t offset      = (size_t)json.Number(node, "byteOffset", 0);
+    accessor->stride   = (size_t)json.Number(view, "byteStride", 0);
+    if (accessor->stride == 0)
+        accessor->stride = accessor->element_size;
+
+    const GltfBuffer& buffer = buffers[accessor->buffer];
+    size_t needed = accessor->count == 0 ? 0 : offset + (accessor->count - 1) * accessor->stride + accessor->element_size;
+    if (view_offset + view_length > buffer.size || needed > view_length)
+        return *err = "accessor fora do buffer", false;
+    accessor->data = buffer.data + view_offset + offset;
+
+    int min = json.Find(node, "min");
+    int max = json.Find(node, "max");
+    accessor->has_bounds = min >= 0 && max >= 0 && accessor->num_components == 3;
+    for (int c = 0; c < 3 && accessor->has_bounds; ++c)
+    {
+        accessor->min[c] = (float)json.Node(json.At(min, c)).number;
+        accessor->max[c] = (float)json.Node(json.At(max, c)).number;
+    }
+    return true;
+}
+
+// Nós com malhas, na ordem da hierarquia da cena.
+void CollectMeshNodes(const Json& json, int node_index, int depth, std::vector<int>* mesh_nodes)
+{
+    int node = json.At(json.Find(0, "nodes"), node_index);
+    if (node < 0 || depth > 64)
+        return;
+    if (json.Find(node, "mesh") >= 0)
+        mesh_nodes->push_back(node);
+    int children = json.Find(node, "children");
+    for (size_t c = 0; c < json.Size(children); ++c)
+        CollectMeshNodes(json, (int)json.Node(json.At(children, c)).number, depth + 1, mesh_nodes);
+}
+
+void ReadMaterials(const Json& json, ObjModel* model)
+{
+    int materials = json.Find(0, "materials");
+    for (size_t m = 0; m < json.Size(materials); ++m)
+    {
+        int node = json.At(materials, m);
+        tinyobj::material_t material = tinyobj::material_t();
+        material.name = json.String(node, "name");
+        material.dissolve = 1.0f;
+        material.illum = 2;
+
+        // Sem luz especular própria no modelo de iluminação do glTF: a cor
+        // base vira Kd e Ka (como no ".mtl" exportado da flecha) e a
+        // rugosidade vira o expoente de Phong.
+        int pbr = json.Find(node, "pbrMetallicRoughness");
+        int factor = json.Find(pbr, "baseColorFactor");
+        for (int c = 0; c < 3; ++c)
+        {
+            float value = factor >= 0 ? (float)json.Node(json.At(factor, c)).number : 1.0f;
+            material.diffuse[c] = value;
+            material.ambient[c] = value;
+        }
+        float roughness = std::max((float)json.Number(pbr, "roughnessFactor", 1.0), 0.01f);
+        material.shininess = std::max(2.0f / std::pow(roughness, 4.0f) - 2.0f, 0.0f);
+
+        // Caminho da imagem da baseColorTexture, relativo ao ".gltf", como o
+        // map_Kd de um ".mtl".
+        int texture = json.At(json.Find(0, "textures"), json.Int(json.Find(pbr, "baseColorTexture"), "index", -1));
+        int image = json.At(json.Find(0, "images"), json.Int(texture, "source", -1));
+        std::string uri = json.String(image, "uri");
+        if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+            material.diffuse_texname = uri;
+        else if (image >= 0)
+            fprintf(stderr, "WARNING: Embedded base color image of glTF material \"%s\" is not supported.\n",
+                    material.name.c_str());
+
+        model->materials.push_back(material);
+    }
+}
+
+// Primitivas sem NORMAL usam normais planas (exigido pelo glTF 2.0): cada
+// triângulo ganha os seus próprios 3 vértices, com a normal da face. Os
+// vértices da primitiva, a partir de "base_vertex", são substituídos, e os
+// índices [first_index, first_index + *num_indices) passam a apontar para os
+// novos.
+void ComputeFlatNormals(std::vector<unsigned char>* vertices, size_t base_vertex,
+                        std::vector<uint32_t>* indices, uint32_t first_index, uint32_t* num_indices)
+{
+    const size_t stride = VertexFormatStride(VERTEX_FORMAT_FLOAT);
+    std::vector<unsigned char> shared(vertices->begin() + base_vertex * stride, vertices->end());
+    vertices->resize(base_vertex * stride);
+
+    size_t num_triangles = *num_indices / 3;
+    vertices->resize((base_vertex + 3 * num_triangles) * stride);
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        float p[3][3];
+        unsigned char* out = vertices->data() + (base_vertex + 3 * t) * stride;
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t& index = (*indices)[first_index + 3 * t + k];
+            memcpy(out + k * stride, &shared[(index - base_vertex) * stride], stride);
+            memcpy(p[k], out + k * stride, 12);
+            index = (uint32_t)(base_vertex + 3 * t + k);
+        }
+
+        glm::vec3 a(p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]);
+        glm::vec3 b(p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]);
+        glm::vec3 n = glm::cross(a, b);
+        float length = glm::length(n);
+        if (length > 0.0f)
+            n /= length;
+        for (int k = 0; k < 3; ++k)
+            memcpy(out + k * stride + 12, &n[0], 12);
+    }
+
+    // Índices que sobram de um triângulo incompleto são descartados.
+    indices->resize(first_index + 3 * num_triangles);
+    *num_indices = (uint32_t)(3 * num_triangles);
+}
+
+} // namespace
+
+bool IsGltfFilename(const char* filename)
+{
+    size_t length = strlen(filename);
+    return (length >= 5 && strcmp(filename + length - 5, ".gltf") == 0)
+        || (length >= 4 && strcmp(filename + length - 4, ".glb") == 0);
+}
+
+bool LoadGltf(const char* filename, ObjModel* model, std::string* err)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    if (!file->Open(filename))
+        return *err = "não foi possível abrir o arquivo", false;
+
+    // Em um ".glb", o JSON e o buffer 0 são os dois primeiros chunks.
+    const unsigned char* json_text = file->Data();
+    size_t               json_size = file->Size();
+    GltfBuffer           glb_buffer = { file, NULL, 0 };
+    if (file->Size() >= 12 && ReadU32(file->Data()) == GLB_MAGIC)
+    {
+        if (ReadU32(file->Data() + 4) != 2)
+            return *err = "versão de GLB não suportada", false;
+        size_t length = std::min((size_t)ReadU32(file->Data() + 8), file->Size());
+        json_text = NULL;
+        for (size_t offset = 12; offset + 8 <= length; )
+        {
+            size_t   chunk_size = ReadU32(file->Data() + offset);
+            uint32_t chunk_type = ReadU32(file->Data() + offset + 4);
+            if (offset + 8 + chunk_size > length)
+                return *err = "chunk de GLB fora do arquivo", false;
+            if (chunk_type == GLB_CHUNK_JSON && json_text == NULL)
+            {
+                json_text = file->Data() + offset + 8;
+                json_size = chunk_size;
+            }
+            else if (chunk_type == GLB_CHUNK_BIN && glb_buffer.data == NULL)
+            {
+                glb_buffer.data = file->Data() + offset + 8;
+                glb_buffer.size = chunk_size;
+            }
+            offset += 8 + chunk_size;
+        }
+        if (json_text == NULL)
+            return *err = "GLB sem chunk JSON", false;
+    }
+
+    Json json;
+    if (!ParseJson((const char*)json_text, json_size, &json, err))
+        return false;
+
+    std::string dirname;
+    const char* slash = strrchr(filename, '/');
+    if (slash != NULL)
+        dirname.assign(filename, slash + 1);
+
+    // Buffers: o chunk binário do ".glb" ou arquivos externos, mapeados.
+    std::vector<GltfBuffer> buffers;
+    int buffers_node = json.Find(0, "buffers");
+    for (size_t b = 0; b < json.Size(buffers_node); ++b)
+    {
+        int node = json.At(buffers_node, b);
+        std::string uri = json.String(node, "uri");
+        GltfBuffer buffer = glb_buffer;
+        if (!uri.empty())
+        {
+            if (uri.compare(0, 5, "data:") == 0)
+                return *err = "buffers em data URI não são suportados", false;
+            buffer.file.reset(new MappedFile());
+            if (!buffer.file->Open((dirname + uri).c_str()))
+                return *err = "não foi possível abrir o buffer \"" + uri + "\"", false;
+            buffer.data = buffer.file->Data();
+            buffer.size = buffer.file->Size();
+        }
+        else if (b != 0 || glb_buffer.data == NULL)
+            return *err = "buffer sem uri", false;
+        if ((size_t)json.Number(node, "byteLength", 0) > buffer.size)
+            return *err = "buffer menor que o declarado", false;
+        buffers.push_back(buffer);
+    }
+
+    // Nós com malha da cena padrão; sem cenas, todas as malhas, com o nome
+    // da própria malha.
+    std::vector<int> mesh_nodes;
+    int scene = json.At(json.Find(0, "scenes"), json.Int(0, "scene", 0));
+    int roots = json.Find(scene, "nodes");
+    for (size_t r = 0; r < json.Size(roots); ++r)
+        CollectMeshNodes(json, (int)json.Node(json.At(roots, r)).number, 0, &mesh_nodes);
+
+    std::vector<int>         mesh_indices;
+    std::vector<std::string> names;
+    int meshes = json.Find(0, "meshes");
+    if (scene < 0)
+    {
+        for (size_t m = 0; m < json.Size(meshes); ++m)
+        {
+            mesh_indices.push_back((int)m);
+            names.push_back(json.String(json.At(meshes, m), "name"));
+        }
+    }
+    for (size_t n = 0; n < mesh_nodes.size(); ++n)
+    {
+        mesh_indices.push_back(json.Int(mesh_nodes[n], "mesh", -1));
+        names.push_back(json.String(mesh_nodes[n], "name"));
+        if (names.back().empty())
+            names.back() = json.String(json.At(meshes, mesh_indices.back()), "name");
+    }
+
+    ReadMaterials(json, model);
+
+    MeshData& mesh = model->mesh;
+    mesh = MeshData();
+    mesh.vertex_format = VERTEX_FORMAT_FLOAT;
+    model->vertex_format = VERTEX_FORMAT_FLOAT;
+    const size_t stride = VertexFormatStride(VERTEX_FORMAT_FLOAT);
+
+    // Índices já deslocados para o fluxo de vértices único do modelo, usados
+    // quando não dá para apontar direto para o buffer.
+    std::vector<uint32_t> indices;
+    std::vector<unsigned char>& vertices = mesh.vertices.storage;
+    bool first_box = true;
+
+    size_t num_primitives = 0;
+    for (size_t m = 0; m < mesh_indices.size(); ++m)
+    {
+        int primitives = json.Find(json.At(meshes, mesh_indices[m]), "primitives");
+        for (size_t p = 0; p < json.Size(primitives); ++p)
+            num_primitives += json.Int(json.At(primitives, p), "mode", MODE_TRIANGLES) == MODE_TRIANGLES;
+    }
+
+    for (size_t m = 0; m < mesh_indices.size(); ++m)
+    {
+        int primitives = json.Find(json.At(meshes, mesh_indices[m]), "primitives");
+        if (primitives < 0)
+            return *err = "nó com malha inexistente", false;
+        for (size_t p = 0; p < json.Size(primitives); ++p)
+        {
+            int primitive = json.At(primitives, p);
+            if (json.Int(primitive, "mode", MODE_TRIANGLES) != MODE_TRIANGLES)
+            {
+                fprintf(stderr, "WARNING: Skipping non-triangle glTF primitive in \"%s\".\n", filename);
+                continue;
+            }
+
+            int attributes = json.Find(primitive, "attributes");
+            Accessor position, normal, texcoord;
+            if (!ReadAccessor(json, buffers, json.Int(attributes, "POSITION", -1), &position, err))
+                return false;
+            if (position.component_type != COMPONENT_FLOAT || position.num_components != 3)
+                return *err = "POSITION deve ser VEC3 float", false;
+            bool has_normals = json.Find(attributes, "NORMAL") >= 0
+                && ReadAccessor(json, buffers, json.Int(attributes, "NORMAL", -1), &normal, err)
+                && normal.component_type == COMPONENT_FLOAT && normal.num_components == 3
+                && normal.count == position.count;
+            bool has_texcoords = json.Find(attributes, "TEXCOORD_0") >= 0
+                && ReadAccessor(json, buffers, json.Int(attributes, "TEXCOORD_0", -1), &texcoord, err)
+                && texcoord.component_type == COMPONENT_FLOAT && texcoord.num_components == 2
+                && texcoord.count == position.count;
+            err->clear();
+            mesh.has_normals   = true; // Geradas abaixo quando faltam
+            mesh.has_texcoords = mesh.has_texcoords || has_texcoords;
+
+            // Intercala os atributos no formato VERTEX_FORMAT_FLOAT: só cópias
+            // de floats, sem conversão.
+            size_t base_vertex = vertices.size() / stride;
+            vertices.resize(vertices.size() + position.count * stride, 0);
+            unsigned char* out = vertices.data() + base_vertex * stride;
+            for (size_t v = 0; v < position.count; ++v, out += stride)
+            {
+                memcpy(out, position.data + v * position.stride, 12);
+                if (has_normals)
+                    memcpy(out + 12, normal.data + v * normal.stride, 12);
+                if (has_texcoords)
+                {
+                    float uv[2];
+                    memcpy(uv, texcoord.data + v * texcoord.stride, 8);
+                    uv[1] = 1.0f - uv[1];
+                    memcpy(out + 24, uv, 8);
+                }
+            }
+
+            // Objetos sem nome recebem um, como o leitor de ".obj" exige, para
+            // que possam ser achados na cena virtual.
+            MeshShape shape;
+            shape.name = names[m].empty() ? "mesh_" + std::to_string(m) : names[m];
+            if (json.Size(primitives) > 1)
+                shape.name += "_" + std::to_string(p);
+            shape.first_index = (uint32_t)indices.size();
+            shape.material_id = json.Int(primitive, "material", -1);
+
+            if (json.Find(primitive, "indices") >= 0)
+            {
+                Accessor accessor;
+                if (!ReadAccessor(json, buffers, json.Int(primitive, "indices", -1), &accessor, err))
+                    return false;
+                if (accessor.num_components != 1
+                    || (accessor.component_type != COMPONENT_UNSIGNED_BYTE
+                        && accessor.component_type != COMPONENT_UNSIGNED_SHORT
+                        && accessor.component_type != COMPONENT_UNSIGNED_INT))
+                    return *err = "índices devem ser inteiros sem sinal", false;
+
+                // Com uma única primitiva, índices de 16 ou 32 bits contíguos
+                // já são os índices da malha: o fluxo aponta para o buffer
+                // mapeado, e os índices só são conferidos.
+                size_t component_size = ComponentSize(accessor.component_type);
+                bool map = num_primitives == 1 && has_normals && component_size >= 2 && accessor.stride == component_size
+                        && (uintptr_t)accessor.data % component_size == 0;
+                for (size_t i = 0; i < accessor.count; ++i)
+                {
+                    const unsigned char* element = accessor.data + i * accessor.stride;
+                    uint32_t index = component_size == 1 ? element[0]
+                                   : component_size == 2 ? (uint32_t)(element[0] | (element[1] << 8)) : ReadU32(element);
+                    if (index >= position.count)
+                        return *err = "índice fora do intervalo de vértices", false;
+                    if (!map)
+                        indices.push_back((uint32_t)base_vertex + index);
+                }
+                if (map)
+                {
+                    mesh.index_size = (uint32_t)component_size;
+                    mesh.indices.Map(accessor.data, accessor.count * component_size);
+                    mesh.mapping = buffers[accessor.buffer].file;
+                    shape.num_indices = (uint32_t)accessor.count;
+                }
+            }
+            else
+            {
+                for (size_t v = 0; v < position.count; ++v)
+                    indices.push_back((uint32_t)(base_vertex + v));
+            }
+            if (mesh.indices.mapped == NULL)
+                shape.num_indices = (uint32_t)indices.size() - shape.first_index;
+            if (!has_normals)
+                ComputeFlatNormals(&vertices, base_vertex, &indices, shape.first_index, &shape.num_indices);
+            mesh.shapes.push_back(shape);
+
+            BoundingBox box;
+            box.min = glm::vec3(position.min[0], position.min[1], position.min[2]);
+            box.max = glm::vec3(position.max[0], position.max[1], position.max[2]);
+            if (!position.has_bounds)
+            {
+                box.min = glm::vec3(std::numeric_limits<float>::max());
+                box.max = glm::vec3(-std::numeric_limits<float>::max());
+                for (size_t v = 0; v < position.count; ++v)
+                {
+                    float xyz[3];
+                    memcpy(xyz, position.data + v * position.stride, 12);
+                    box.min = glm::min(box.min, glm::vec3(xyz[0], xyz[1], xyz[2]));
+                    box.max = glm::max(box.max, glm::vec3(xyz[0], xyz[1], xyz[2]));
+                }
+            }
+            model->shape_bboxes.push_back(box);
+            model->bbox.min = first_box ? box.min : glm::min(model->bbox.min, box.min);
+            model->bbox.max = first_box ? box.max : glm::max(model->bbox.max, box.max);
+            first_box = false;
+        }
+    }
+    if (mesh.shapes.empty())
+        return *err = "nenhuma primitiva de triângulos", false;
+
+    if (mesh.indices.mapped == NULL && vertices.size() / stride < 65536)
+    {
+        mesh.index_size = 2;
+        std::vector<uint16_t> narrow(indices.begin(), indices.end());
+        mesh.indices.Assign(narrow);
+    }
+    else if (mesh.indices.mapped == NULL)
+    {
+        mesh.index_size = 4;
+        mesh.indices.Assign(indices);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (size_t s = 0; s < mesh.shapes.size(); ++s)
+        printf("- Objeto '%s'\n", mesh.shapes[s].name.c_str());
+    printf("Modelo \"%s\" lido do glTF em %.2f ms (%zu primitiva(s), %s)\n", filename, ms, num_primitives,
+           mesh.indices.mapped != NULL ? "índices mapeados sem cópia" : "índices copiados");
+    return true;
+}
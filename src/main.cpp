@@ -15,6 +15,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include <map>
@@ -26,6 +27,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <chrono>
 
 // Headers das bibliotecas OpenGL
 #include <glad/glad.h>   // Criação de contexto OpenGL 3.3
@@ -45,17 +47,32 @@
 #include "matrices.h"
 #include "object.h"
 #include "collisions.h"
+#include "meshcache.h"
+#include "mesharena.h"
+#include "normals.h"
+#include "texturearray.h"
+#include "texturestream.h"
+#include "assets.h"
+#include "objstream.h"
+#include "scene.h"
+#include "renderqueue.h"
+#include "glstate.h"
 
 #define M_PI 3.14159265358979323846
 
 // Declaração de várias funções utilizadas em main().  Essas estão definidas
 // logo após a definição de main() neste arquivo.
-void BuildTrianglesAndAddToVirtualScene(ObjModel*); // Constrói representação de um ObjModel como malha de triângulos para renderização
-void ComputeNormals(ObjModel* model); // Computa normais de um ObjModel, caso não existam.
+ModelHandle LoadModel(const char* filename); // Carrega um modelo pelo gerenciador de recursos e o adiciona à cena
+void UnloadModel(ModelHandle handle); // Libera uma referência a um modelo e o tira da cena com a última
+void BuildTrianglesAndAddToVirtualScene(ModelHandle); // Constrói representação de um ObjModel como malha de triângulos para renderização
+void ComputeNormals(ObjModel* model, NormalWeighting weighting = NORMAL_WEIGHTING_AREA); // Computa normais de um ObjModel, caso não existam.
 void LoadShadersFromFiles(); // Carrega os shaders de vértice e fragmento, criando um programa de GPU
 void LoadTextureImage(const char* filename); // Função que carrega imagens de textura
-void DrawVirtualObject(const char* object_name); // Desenha um objeto armazenado em g_VirtualScene
-void DrawVirtualObjectWithMaterial(const char* object_name, const tinyobj::material_t* material); // Desenha um objeto com material específico
+void LoadTextureImages(const char* const* filenames, size_t count); // Carrega várias imagens de textura, decodificando em paralelo
+bool HasGLExtension(const char* name); // Verifica se o contexto OpenGL suporta uma extensão
+TextureLayer FindTextureLayer(const std::string& filename); // Camada de uma textura já carregada
+void SubmitObjects(RenderPacket packet, const SceneObjectHandle* objects, size_t count, const std::vector<tinyobj::material_t>& materials); // Envia objetos de um modelo para a fila de desenho
+void FindSceneObjects(const char* const* names, size_t count, SceneObjectHandle* objects); // Handles de objetos da cena pelo nome
 GLuint LoadShader_Vertex(const char* filename);   // Carrega um vertex shader
 GLuint LoadShader_Fragment(const char* filename); // Carrega um fragment shader
 void LoadShader(const char* filename, GLuint shader_id); // Função utilizada pelas duas acima
@@ -77,6 +94,7 @@ void TextRendering_PrintMatrixVectorProductDivW(GLFWwindow* window, glm::mat4 M,
 // Funções abaixo renderizam como texto na janela OpenGL algumas matrizes e
 // outras informações do programa. Definidas após main().
 void TextRendering_ShowFramesPerSecond(GLFWwindow* window);
+void TextRendering_ShowRenderStats(GLFWwindow* window);
 void TextRendering_ScoreandGameOVer(GLFWwindow* window);
 void TextRendering_RecoverArrow(GLFWwindow* window);
 
@@ -89,34 +107,16 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void CursorPosCallback(GLFWwindow* window, double xpos, double ypos);
 void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
-void ApplyMaterial(const tinyobj::material_t& material);
 glm::vec3 CalculateBezierPoint(float t, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3);
 glm::vec3 ScreenToWorldCoordinates(double xpos, double ypos, GLFWwindow* window, glm::mat4 view, glm::mat4 projection);
 void FireArrow(GLFWwindow* window, glm::mat4 view, glm::mat4 projection);
 void UpdateArrow(float deltaTime);
 
-// Definimos uma estrutura que armazenará dados necessários para renderizar
-// cada objeto da cena virtual.
-struct SceneObject
-{
-    std::string  name;        // Nome do objeto
-    size_t       first_index; // Índice do primeiro vértice dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
-    size_t       num_indices; // Número de índices do objeto dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
-    GLenum       rendering_mode; // Modo de rasterização (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
-    GLuint       vertex_array_object_id; // ID do VAO onde estão armazenados os atributos do modelo
-    int          material_id; // ID do material associado ao objeto (-1 se não tiver material)
-};
-
 // Abaixo definimos variáveis globais utilizadas em várias funções do código.
 
-// A cena virtual é uma lista de objetos nomeados, guardados em um dicionário
-// (map).  Veja dentro da função BuildTrianglesAndAddToVirtualScene() como que são incluídos
-// objetos dentro da variável g_VirtualScene, e veja na função main() como
-// estes são acessados.
-std::map<std::string, SceneObject> g_VirtualScene;
-
-// Mapa para armazenar os modelos carregados e acessar seus materiais
-std::map<std::string, ObjModel*> g_LoadedModels;
+// Referências às imagens carregadas por LoadTextureImages(), liberadas no fim
+// de main() (veja "assets.h").
+std::vector<ImageHandle> g_TextureImages;
 
 // Pilha que guardará as matrizes de modelagem.
 std::stack<glm::mat4>  g_MatrixStack;
@@ -124,6 +124,10 @@ std::stack<glm::mat4>  g_MatrixStack;
 // Razão de proporção da janela (largura/altura). Veja função FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
 
+// Altura da janela em pixels, usada para converter o erro dos níveis de
+// detalhe em pixels. Veja função FramebufferSizeCallback().
+float g_ScreenHeight = 1.0f;
+
 float pos_x = 0.0f;
 float pos_y = -10.0f;
 float pos_z = 0.0f;
@@ -178,18 +182,39 @@ bool game_over = false;
 
 // Variáveis que definem um programa de GPU (shaders).
 GLuint g_GpuProgramID = 0;
-GLint g_model_uniform;
-GLint g_view_uniform;
-GLint g_projection_uniform;
-GLint g_object_id_uniform;
-GLint g_material_id_uniform;
-GLint g_lighting_model_uniform;
-GLint g_Kd_uniform;
-GLint g_Ka_uniform;
-GLint g_Ks_uniform;
-GLint g_q_uniform;
-
-GLuint g_NumLoadedTextures = 0;
+
+// Programa usado pela fila de desenho (veja "renderqueue.h").
+RenderProgram g_RenderProgram;
+
+// Luz direcional da cena, definida em main().
+RenderLight g_Light;
+
+// Chamadas de estado do OpenGL repassadas e filtradas no último quadro (veja
+// "glstate.h").
+GLStateStats g_FrameGLStateStats;
+
+// Se true, as texturas são comprimidas em BC1/BC3 (veja "texturecompress.h").
+// A compressão tem perdas e muda a aparência das texturas, então fica
+// desligada por padrão. Desligado em main() se a GPU não suportar os formatos
+// S3TC em sRGB.
+bool g_CompressTextures = false;
+
+// Se true, as texturas chegam à GPU aos poucos, durante os primeiros quadros,
+// dos níveis de mipmap menores para os maiores (veja "texturestream.h"). Se
+// false, LoadTextureImages() espera todas as texturas serem enviadas.
+bool g_StreamTextures = true;
+
+// Se false, os dados da leitura do ".obj" e os fluxos da malha são liberados
+// assim que a malha vai para a GPU (veja ReleaseObjModelGeometry() em
+// "object.h"); o modelo fica só com os materiais e as bounding boxes, que é o
+// que a renderização e as colisões usam. PrintObjModelInfo() precisa de true.
+bool g_KeepMeshData = false;
+
+// Qualidade das texturas e memória máxima que elas podem ocupar na GPU; as
+// imagens maiores são reduzidas no carregamento até caberem (veja
+// "texturestream.h"). 0 = sem limite.
+TextureQuality g_TextureQuality = TEXTURE_QUALITY_FULL;
+size_t         g_TextureMemoryBudget = 256 * 1024 * 1024;
 
 int main(int argc, char* argv[])
 {
@@ -245,66 +270,106 @@ int main(int argc, char* argv[])
 
     LoadShadersFromFiles();
 
-    // Carregamento das texturas
-
-    // Imagens da SkyBox
-    LoadTextureImage("data/textures/left.png");       // TextureImage0
-    LoadTextureImage("data/textures/right.png");      // TextureImage1
-    LoadTextureImage("data/textures/bottom.png");     // TextureImage2
-    LoadTextureImage("data/textures/top.png");        // TextureImage3
-    LoadTextureImage("data/textures/front.png");      // TextureImage4
-    LoadTextureImage("data/textures/back.png");       // TextureImage5
-
-    // Texturas do modelo target
-    LoadTextureImage("data/target/RGB_ca679fbef29d47908e43abddd6b40c6c_Styrofoam_diffuse.jpeg");        // TextureImage6
-    LoadTextureImage("data/target/RGB_47bd90a446e546bca69fa88b48a09312_target-paper_diffuse.jpeg");     // TextureImage7
-    LoadTextureImage("data/target/RGB_7011de0aa4ab44cb927a6767fa8aa3ef_wood_hinge_diffuse.jpeg");       // TextureImage8
-    LoadTextureImage("data/target/RGB_da371e9e3c3d460c986fe6316c40bc6c_Wood_stand_Diffuse_final.jpeg"); // TextureImage9
-
-    // Texturas do Character
-    LoadTextureImage("data/character/RGB_1b6e32c5408a4a13ad1d8f411749c0e4_Eye_diff_001.png");                                // TextureImage10
-    LoadTextureImage("data/character/RGB_6f1df117890d4d80893d2170dc81c4b3_ARCHER_FOR_SUBS_TSHIRT_2_BaseColor.1001.jpeg");    // TextureImage11
-    LoadTextureImage("data/character/RGB_6f3d0106dc4540efb1e0628732bba968_ARCHER_FOR_SUBS_BELT_4_BaseColor.1001.jpeg");      // TextureImage12
-    LoadTextureImage("data/character/RGB_694fa89b46224c7ab2192f701793093c_ARCHER_FOR_SUBS_ARCHER_012_BaseColor.1001.jpeg");  // TextureImage13
-    LoadTextureImage("data/character/RGB_4886c183ab0b499793b6a5b448ef285d_WARRIOR_Body_new_low_001_defaultMat_BaseCo.jpeg"); // TextureImage14
-    LoadTextureImage("data/character/RGB_b4890e0bef3e4568a4bd860662769c4e_ARCHER_FOR_SUBS_Material.001_BaseColor.100.jpeg"); // TextureImage15
-    LoadTextureImage("data/character/RGB_e40db1c3e31f4d2a92b06d9a0bae4a48_Hair_DIff_01.jpeg");                               // TextureImage16
-
-    // Textura do Arrow
-    LoadTextureImage("data/arrow/WoodenArrowAlbedo.png"); //TextureImage17
-
-    // Carregamento dos objetos dos modelos 3D
-    ObjModel charactermodel("data/male_mesh.obj");
-    ComputeNormals(&charactermodel);
-    BuildTrianglesAndAddToVirtualScene(&charactermodel);
-
-    ObjModel targetmodel("data/target/model.obj");
-    ComputeNormals(&targetmodel);
-    BuildTrianglesAndAddToVirtualScene(&targetmodel);
-
-    ObjModel planemodel("data/plane.obj");
-    ComputeNormals(&planemodel);
-    BuildTrianglesAndAddToVirtualScene(&planemodel);
-
-    ObjModel archermodel("data/character/model.obj");
-    ComputeNormals(&archermodel);
-    BuildTrianglesAndAddToVirtualScene(&archermodel);
-
-    ObjModel arrowmodel("data/arrow/model.obj");
-    ComputeNormals(&arrowmodel);
-    BuildTrianglesAndAddToVirtualScene(&arrowmodel);
+    // Luz mais frontal e alta para reduzir sombras
+    g_Light.direction = glm::vec4(0.2f, 1.0f, 1.0f, 0.0f);
+    g_Light.color     = glm::vec3(1.0f, 1.0f, 1.0f);
+    g_Light.ambient   = glm::vec3(0.4f, 0.4f, 0.4f);
 
-    if ( argc > 1 )
+    if (g_CompressTextures && !(HasGLExtension("GL_EXT_texture_compression_s3tc")
+                                && (HasGLExtension("GL_EXT_texture_sRGB") || HasGLExtension("GL_EXT_texture_compression_s3tc_srgb"))))
     {
-        ObjModel model(argv[1]);
-        BuildTrianglesAndAddToVirtualScene(&model);
+        fprintf(stderr, "WARNING: S3TC sRGB textures not supported, textures will not be compressed.\n");
+        g_CompressTextures = false;
     }
 
+    // Carregamento das texturas. As imagens são decodificadas em paralelo e
+    // viram camadas dos arrays de texturas (veja "texturearray.h"); os
+    // materiais dos modelos encontram as suas pelo nome da imagem (map_Kd).
+    const char* texture_filenames[] = {
+        // Imagens da SkyBox
+        "data/textures/left.png",
+        "data/textures/right.png",
+        "data/textures/bottom.png",
+        "data/textures/top.png",
+        "data/textures/front.png",
+        "data/textures/back.png",
+
+        // Texturas do modelo target
+        "data/target/RGB_ca679fbef29d47908e43abddd6b40c6c_Styrofoam_diffuse.jpeg",
+        "data/target/RGB_47bd90a446e546bca69fa88b48a09312_target-paper_diffuse.jpeg",
+        "data/target/RGB_7011de0aa4ab44cb927a6767fa8aa3ef_wood_hinge_diffuse.jpeg",
+        "data/target/RGB_da371e9e3c3d460c986fe6316c40bc6c_Wood_stand_Diffuse_final.jpeg",
+
+        // Texturas do Character
+        "data/character/RGB_1b6e32c5408a4a13ad1d8f411749c0e4_Eye_diff_001.png",
+        "data/character/RGB_6f1df117890d4d80893d2170dc81c4b3_ARCHER_FOR_SUBS_TSHIRT_2_BaseColor.1001.jpeg",
+        "data/character/RGB_6f3d0106dc4540efb1e0628732bba968_ARCHER_FOR_SUBS_BELT_4_BaseColor.1001.jpeg",
+        "data/character/RGB_694fa89b46224c7ab2192f701793093c_ARCHER_FOR_SUBS_ARCHER_012_BaseColor.1001.jpeg",
+        "data/character/RGB_4886c183ab0b499793b6a5b448ef285d_WARRIOR_Body_new_low_001_defaultMat_BaseCo.jpeg",
+        "data/character/RGB_b4890e0bef3e4568a4bd860662769c4e_ARCHER_FOR_SUBS_Material.001_BaseColor.100.jpeg",
+        "data/character/RGB_e40db1c3e31f4d2a92b06d9a0bae4a48_Hair_DIff_01.jpeg",
+
+        // Textura do Arrow
+        "data/arrow/WoodenArrowAlbedo.png",
+    };
+    LoadTextureImages(texture_filenames, sizeof(texture_filenames) / sizeof(texture_filenames[0]));
+    TextureArrays_PrintStats();
+
+    // Faces da SkyBox: PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP,
+    // PLANE_FRONT e PLANE_BACK, nesta ordem.
+    TextureLayer skybox_textures[6];
+    for (int face = 0; face < 6; ++face)
+        skybox_textures[face] = FindTextureLayer(texture_filenames[face]);
+
+    // Carregamento dos objetos dos modelos 3D. Os modelos ficam com o
+    // gerenciador de recursos até o fim de main().
+    ModelHandle models[] = {
+        LoadModel("data/male_mesh.obj"),
+        LoadModel("data/target/model.obj"),
+        LoadModel("data/plane.obj"),
+        LoadModel("data/character/model.obj"),
+        LoadModel("data/arrow/model.obj"),
+        ModelHandle(),
+    };
+    if ( argc > 1 )
+        models[5] = LoadModel(argv[1]);
+
+    ObjModel& targetmodel = *Assets_GetModel(models[1])->model;
+    ObjModel& planemodel  = *Assets_GetModel(models[2])->model;
+    ObjModel& archermodel = *Assets_GetModel(models[3])->model;
+    ObjModel& arrowmodel  = *Assets_GetModel(models[4])->model;
+
+    // Os objetos desenhados a cada quadro são procurados pelo nome uma única
+    // vez; o laço de renderização só usa os handles (veja "scene.h").
+    const char* archer_names[] = {
+        "object_0", "object_1", "object_2", "object_3", "object_4",
+        "object_5", "object_6", "object_7", "object_8",
+    };
+    const char* target_names[] = {
+        "object_0_target", "object_1_target", "object_2_target",
+        "object_3_target", "object_4_target", "object_5_target",
+    };
+    const char* arrow_name = "WoodenArrow";
+    const char* plane_name = "the_plane";
+    const size_t NUM_ARCHER_OBJECTS = sizeof(archer_names) / sizeof(archer_names[0]);
+    const size_t NUM_TARGET_OBJECTS = sizeof(target_names) / sizeof(target_names[0]);
+    SceneObjectHandle archer_objects[NUM_ARCHER_OBJECTS];
+    SceneObjectHandle target_objects[NUM_TARGET_OBJECTS];
+    SceneObjectHandle arrow_object;
+    SceneObjectHandle plane_object;
+    FindSceneObjects(archer_names, NUM_ARCHER_OBJECTS, archer_objects);
+    FindSceneObjects(target_names, NUM_TARGET_OBJECTS, target_objects);
+    FindSceneObjects(&arrow_name, 1, &arrow_object);
+    FindSceneObjects(&plane_name, 1, &plane_object);
+
+    MeshArena_PrintStats();
+    Assets_PrintStats();
+
     TextRendering_Init();
 
-    glEnable(GL_DEPTH_TEST);
+    GLState_SetEnabled(GL_DEPTH_TEST, true);
 
-    glEnable(GL_CULL_FACE);
+    GLState_SetEnabled(GL_CULL_FACE, true);
     glCullFace(GL_BACK);
     glFrontFace(GL_CCW);
     
@@ -336,11 +401,17 @@ int main(int argc, char* argv[])
 
     while (!glfwWindowShouldClose(window))
     {
+        g_FrameGLStateStats = GLState_Stats();
+        GLState_ResetStats();
+
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(g_GpuProgramID);
+        GLState_UseProgram(g_GpuProgramID);
+
+        // Envia mais alguns níveis das texturas que ainda estão chegando.
+        TextureStream_Update(TEXTURE_STREAM_FRAME_BUDGET);
 
         float current_time = (float)glfwGetTime();
         g_DeltaTime = current_time - prev_time;
@@ -391,15 +462,18 @@ int main(int argc, char* argv[])
             targets[i] = Matrix_Identity();
         }
 
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-        glUniformMatrix4fv(g_projection_uniform , 1 , GL_FALSE , glm::value_ptr(projection));
-
         // Armazena matrizes para acesso global
         g_CurrentView = view;
         g_CurrentProjection = projection;
 
         UpdateArrow(g_DeltaTime);
 
+        // Os objetos são enviados para a fila de desenho e desenhados todos
+        // juntos depois dos testes de colisão (veja "renderqueue.h").
+        RenderQueue_Begin(view, projection, g_ScreenHeight, g_Light);
+        RenderPacket packet;
+        packet.program = &g_RenderProgram;
+
         #define CHARACTER 0
         #define PLANE_LEFT 11
         #define PLANE_RIGHT 12
@@ -442,20 +516,12 @@ int main(int argc, char* argv[])
         * Matrix_Scale(0.08f, 0.08f, 0.08f);
         model = archer_model;
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, ARCHER);
-        glUniform1i(g_lighting_model_uniform, 1); // Gouraud para ARCHER
+        packet.model          = model;
+        packet.object_id      = ARCHER;
+        packet.lighting_model = 1; // Gouraud para ARCHER
 
         if(look_at){
-            DrawVirtualObjectWithMaterial("object_0", &archermodel.materials[0]);
-            DrawVirtualObjectWithMaterial("object_1", &archermodel.materials[1]);
-            DrawVirtualObjectWithMaterial("object_2", &archermodel.materials[2]);
-            DrawVirtualObjectWithMaterial("object_3", &archermodel.materials[3]);
-            DrawVirtualObjectWithMaterial("object_4", &archermodel.materials[4]);
-            DrawVirtualObjectWithMaterial("object_5", &archermodel.materials[5]);
-            DrawVirtualObjectWithMaterial("object_6", &archermodel.materials[6]);
-            DrawVirtualObjectWithMaterial("object_7", &archermodel.materials[7]);
-            DrawVirtualObjectWithMaterial("object_8", &archermodel.materials[8]);
+            SubmitObjects(packet, archer_objects, NUM_ARCHER_OBJECTS, archermodel.materials);
         }
     
         // TARGET 1
@@ -464,16 +530,11 @@ int main(int argc, char* argv[])
         * Matrix_Scale(0.01f, 0.01f, 0.01f);
         targets[0] = model;
         
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, TARGET);
-        glUniform1i(g_lighting_model_uniform, 0); // Phong para TARGET
-        
-        DrawVirtualObjectWithMaterial("object_0_target", &targetmodel.materials[0]);
-        DrawVirtualObjectWithMaterial("object_1_target", &targetmodel.materials[1]);
-        DrawVirtualObjectWithMaterial("object_2_target", &targetmodel.materials[2]);
-        DrawVirtualObjectWithMaterial("object_3_target", &targetmodel.materials[3]);
-        DrawVirtualObjectWithMaterial("object_4_target", &targetmodel.materials[4]);
-        DrawVirtualObjectWithMaterial("object_5_target", &targetmodel.materials[5]);
+        packet.model          = model;
+        packet.object_id      = TARGET;
+        packet.lighting_model = 0; // Phong para TARGET
+
+        SubmitObjects(packet, target_objects, NUM_TARGET_OBJECTS, targetmodel.materials);
 
         // TARGET 2
         model = Matrix_Translate(15, -23.0f, 13)
@@ -482,16 +543,11 @@ int main(int argc, char* argv[])
         * Matrix_Scale(0.01f+T2_scale, 0.01f+T2_scale, 0.01f+T2_scale);
         targets[1] = model;
         
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, TARGET);
-        glUniform1i(g_lighting_model_uniform, 0); // Phong para TARGET
+        packet.model          = model;
+        packet.object_id      = TARGET;
+        packet.lighting_model = 0; // Phong para TARGET
 
-        DrawVirtualObjectWithMaterial("object_0_target", &targetmodel.materials[0]);
-        DrawVirtualObjectWithMaterial("object_1_target", &targetmodel.materials[1]);
-        DrawVirtualObjectWithMaterial("object_2_target", &targetmodel.materials[2]);
-        DrawVirtualObjectWithMaterial("object_3_target", &targetmodel.materials[3]);
-        DrawVirtualObjectWithMaterial("object_4_target", &targetmodel.materials[4]);
-        DrawVirtualObjectWithMaterial("object_5_target", &targetmodel.materials[5]);
+        SubmitObjects(packet, target_objects, NUM_TARGET_OBJECTS, targetmodel.materials);
 
         // TARGET 3
         model = Matrix_Translate(-15, -23.0f, 13)
@@ -500,16 +556,11 @@ int main(int argc, char* argv[])
         * Matrix_Scale(0.01f, 0.01f, 0.01f);
         targets[2] = model;
         
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, TARGET);
-        glUniform1i(g_lighting_model_uniform, 0); // Phong para TARGET
+        packet.model          = model;
+        packet.object_id      = TARGET;
+        packet.lighting_model = 0; // Phong para TARGET
 
-        DrawVirtualObjectWithMaterial("object_0_target", &targetmodel.materials[0]);
-        DrawVirtualObjectWithMaterial("object_1_target", &targetmodel.materials[1]);
-        DrawVirtualObjectWithMaterial("object_2_target", &targetmodel.materials[2]);
-        DrawVirtualObjectWithMaterial("object_3_target", &targetmodel.materials[3]);
-        DrawVirtualObjectWithMaterial("object_4_target", &targetmodel.materials[4]);
-        DrawVirtualObjectWithMaterial("object_5_target", &targetmodel.materials[5]);
+        SubmitObjects(packet, target_objects, NUM_TARGET_OBJECTS, targetmodel.materials);
 
         float arrow_offset = -7.5f;
         // ARROW
@@ -543,75 +594,82 @@ int main(int argc, char* argv[])
         }
         model = arrow_model;
         
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, ARROW);
-        glUniform1i(g_lighting_model_uniform, 0); // Phong para TARGET
+        packet.model          = model;
+        packet.object_id      = ARROW;
+        packet.lighting_model = 0; // Phong para TARGET
 
         if((look_at || g_ArrowFired || g_ArrowCollided) && !game_over) {
-            DrawVirtualObjectWithMaterial("WoodenArrow", &arrowmodel.materials[0]);
+            SubmitObjects(packet, &arrow_object, 1, arrowmodel.materials);
         }
 
-        // PLANES
-        glDisable(GL_CULL_FACE);
+        // PLANES, vistos dos dois lados e com as texturas da SkyBox no lugar
+        // do material.
+        packet.object         = plane_object;
+        packet.material       = NULL;
+        packet.pass           = RENDER_PASS_DOUBLE_SIDED;
+        packet.lighting_model = 0;
 
         // PLANE LEFT
         float size = 25.0;
         model = Matrix_Translate(-size, 0.0f, 0.0f)
         * Matrix_Rotate_Z(M_PI/2.0f)         // Inclina para o plano YZ, mas para o outro lado
         * Matrix_Scale(size, size, size);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE_LEFT);
-        glUniform1i(g_lighting_model_uniform, 0); 
-        DrawVirtualObject("the_plane");
+        packet.model     = model;
+        packet.object_id = PLANE_LEFT;
+        packet.texture   = skybox_textures[0];
+        RenderQueue_Submit(packet);
         planes[0] = model; 
 
         // PLANE RIGHT
         model = Matrix_Translate(size, 0.0f, 0.0f)
         * Matrix_Rotate_Z(-M_PI/2.0)        // Inclina para o plano YZ
         * Matrix_Scale(size, size, size);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE_RIGHT);
-        glUniform1i(g_lighting_model_uniform, 0); 
-        DrawVirtualObject("the_plane");
+        packet.model     = model;
+        packet.object_id = PLANE_RIGHT;
+        packet.texture   = skybox_textures[1];
+        RenderQueue_Submit(packet);
         planes[1] = model;
 
         // PLANE BOTTOM
         model = Matrix_Translate(0.0f, -size, 0.0f) * Matrix_Scale(size,size,size);
-        glUniformMatrix4fv(g_model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE_BOTTOM);
-        glUniform1i(g_lighting_model_uniform, 0); 
-        DrawVirtualObject("the_plane");
+        packet.model     = model;
+        packet.object_id = PLANE_BOTTOM;
+        packet.texture   = skybox_textures[2];
+        RenderQueue_Submit(packet);
 
         // PLANE TOP
         model = Matrix_Translate(0.0f, size, 0.0f) * Matrix_Scale(size,size,size);
-        glUniformMatrix4fv(g_model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE_TOP);
-        glUniform1i(g_lighting_model_uniform, 0); 
-        DrawVirtualObject("the_plane");
+        packet.model     = model;
+        packet.object_id = PLANE_TOP;
+        packet.texture   = skybox_textures[3];
+        RenderQueue_Submit(packet);
 
         // PLANE FRONT
         model = Matrix_Translate(0.0f, 0.0f, size)
         * Matrix_Rotate_X(M_PI/2.0f) // Flip plano para frente
         * Matrix_Scale(size, size, size);
-        glUniformMatrix4fv(g_model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE_FRONT);
-        DrawVirtualObject("the_plane");
+        packet.model     = model;
+        packet.object_id = PLANE_FRONT;
+        packet.texture   = skybox_textures[4];
+        RenderQueue_Submit(packet);
         planes[2] = model;
 
         // PLANE BACK
         model = Matrix_Translate(0.0f, 0.0f, -size)
         * Matrix_Rotate_X(-M_PI/2.0f) // Flip plano para frente
         * Matrix_Scale(size, size, size);
-        glUniformMatrix4fv(g_model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE_BACK);
-        DrawVirtualObject("the_plane");
+        packet.model     = model;
+        packet.object_id = PLANE_BACK;
+        packet.texture   = skybox_textures[5];
+        RenderQueue_Submit(packet);
         planes[3] = model;
 
         // Teste de Intersecções
-        BoundingBox archer_local_box = ComputeLocalBoundingBox(archermodel.attrib);
-        BoundingBox arrow_local_box  = ComputeLocalBoundingBox(arrowmodel.attrib);
-        BoundingBox target_local_box = ComputeLocalBoundingBox(targetmodel.attrib);
-        BoundingBox plane_local_box = ComputeLocalBoundingBox(planemodel.attrib);
+        // As bounding boxes locais já foram calculadas no carregamento dos modelos.
+        const BoundingBox& archer_local_box = archermodel.bbox;
+        const BoundingBox& arrow_local_box  = arrowmodel.bbox;
+        const BoundingBox& target_local_box = targetmodel.bbox;
+        const BoundingBox& plane_local_box  = planemodel.bbox;
 
         BoundingBox archer_world_box = TransformBoundingBox(archer_local_box, archer_model);
         BoundingBox arrow_world_box  = TransformBoundingBox(arrow_local_box, arrow_model);
@@ -677,7 +735,10 @@ int main(int argc, char* argv[])
             game_over = true;
         }
 
+        RenderQueue_Flush();
+
         TextRendering_ShowFramesPerSecond(window);
+        TextRendering_ShowRenderStats(window);
         TextRendering_ScoreandGameOVer(window);
         TextRendering_RecoverArrow(window);
 
@@ -686,6 +747,11 @@ int main(int argc, char* argv[])
         glfwPollEvents();
     }
 
+    for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); ++m)
+        UnloadModel(models[m]);
+    for (size_t i = 0; i < g_TextureImages.size(); ++i)
+        Assets_ReleaseImage(g_TextureImages[i]);
+
     glfwTerminate();
 
     return 0;
@@ -694,78 +760,81 @@ int main(int argc, char* argv[])
 // Função que carrega uma imagem para ser utilizada como textura
 void LoadTextureImage(const char* filename)
 {
+    LoadTextureImages(&filename, 1);
+}
 
-    // Leitura da imagem do disco
-    stbi_set_flip_vertically_on_load(true);
-    int width;
-    int height;
-    int channels;
-    unsigned char *data = stbi_load(filename, &width, &height, &channels, 3);
-
-    if ( data == NULL )
-    {
-        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
-    }
-
-    // Criação de objetos na GPU com OpenGL para armazenar a textura
-    GLuint texture_id;
-    GLuint sampler_id;
-    glGenTextures(1, &texture_id);
-    glGenSamplers(1, &sampler_id);
-
-    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Parâmetros de amostragem da textura.
-    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Envia imagem lida do disco para a GPU
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
-
-    GLuint textureunit = g_NumLoadedTextures;
-    glActiveTexture(GL_TEXTURE0 + textureunit);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindSampler(textureunit, sampler_id);
+// Carrega várias imagens de textura de uma vez. Cada imagem vem do cache de
+// texturas (veja "texturecache.h"), mapeado em memória e já com os mipmaps;
+// na primeira vez em que uma imagem é vista, ela é decodificada (stbi_load),
+// tem a cadeia de mipmaps construída e o cache gravado. Esse trabalho roda nas
+// threads do pool (veja "threadpool.h").
+//
+// Cada imagem vira uma camada dos arrays de texturas (veja "texturearray.h"),
+// reservada a partir só do cabeçalho da imagem. As imagens passam pelo
+// gerenciador de recursos (veja "assets.h"), que não carrega de novo uma
+// imagem já carregada; as referências ficam em g_TextureImages. As imagens são reduzidas conforme g_TextureQuality e
+// g_TextureMemoryBudget. Com g_StreamTextures a função retorna logo e os níveis
+// são enviados aos poucos pelo laço de renderização (veja "texturestream.h");
+// senão, ela só retorna com todas as texturas na GPU.
+void LoadTextureImages(const char* const* filenames, size_t count)
+{
+    TextureLoadOptions options;
+    options.compress      = g_CompressTextures;
+    options.quality       = g_TextureQuality;
+    options.memory_budget = g_TextureMemoryBudget;
 
-    stbi_image_free(data);
+    std::vector<ImageHandle> handles;
+    Assets_LoadImages(filenames, count, options, &handles);
+    g_TextureImages.insert(g_TextureImages.end(), handles.begin(), handles.end());
 
-    g_NumLoadedTextures += 1;
+    if (!g_StreamTextures)
+        TextureStream_Finish();
 }
 
-// Função que desenha um objeto armazenado em g_VirtualScene.
-void DrawVirtualObject(const char* object_name)
+// Verifica se o contexto OpenGL atual anuncia a extensão "name".
+bool HasGLExtension(const char* name)
 {
-    // Verifica se o objeto tem material associado e o aplica
-    const SceneObject& obj = g_VirtualScene[object_name];
-    if (obj.material_id >= 0 && g_LoadedModels.count(object_name) > 0) {
-        const ObjModel* model = g_LoadedModels[object_name];
-        if (obj.material_id < (int)model->materials.size()) {
-            ApplyMaterial(model->materials[obj.material_id]);
-            // Define o ID do material no shader
-            glUniform1i(g_material_id_uniform, obj.material_id);
-        }
-    } else {
-        // Define material_id como -1 se não houver material
-        glUniform1i(g_material_id_uniform, -1);
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension != NULL && strcmp(extension, name) == 0)
+            return true;
     }
+    return false;
+}
 
-    glBindVertexArray(g_VirtualScene[object_name].vertex_array_object_id);
+// Camada de uma imagem carregada por LoadTextureImages(). Retorna uma camada
+// vazia (array -1) se a imagem não foi carregada.
+TextureLayer FindTextureLayer(const std::string& filename)
+{
+    return Assets_GetImage(Assets_FindImage(filename));
+}
 
-    glDrawElements(
-        g_VirtualScene[object_name].rendering_mode,
-        g_VirtualScene[object_name].num_indices,
-        GL_UNSIGNED_INT,
-        (void*)(g_VirtualScene[object_name].first_index * sizeof(GLuint))
-    );
+// Procura os objetos da cena pelo nome. Os que não existirem ficam com um
+// handle vazio, que a fila de desenho ignora.
+void FindSceneObjects(const char* const* names, size_t count, SceneObjectHandle* objects)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        objects[i] = Scene_Find(names[i]);
+        if (objects[i].generation == 0)
+            fprintf(stderr, "WARNING: Object \"%s\" is not in the virtual scene.\n", names[i]);
+    }
+}
 
-    glBindVertexArray(0);
+// Envia para a fila de desenho os objetos de um modelo, o objeto i com o
+// material i do modelo. Os demais campos vêm de "packet".
+void SubmitObjects(RenderPacket packet, const SceneObjectHandle* objects, size_t count,
+                   const std::vector<tinyobj::material_t>& materials)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        packet.object   = objects[i];
+        packet.material = i < materials.size() ? &materials[i] : NULL;
+        RenderQueue_Submit(packet);
+    }
 }
 
 // Função que carrega os shaders de vértices e de fragmentos que serão utilizados para renderização.
@@ -781,227 +850,216 @@ void LoadShadersFromFiles()
 
     g_GpuProgramID = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
 
-    // Busca o endereço das variáveis definidas dentro do Vertex Shader para enviar dados para a placa de vídeo.
-    g_model_uniform      = glGetUniformLocation(g_GpuProgramID, "model"); // Variável da matriz "model"
-    g_view_uniform       = glGetUniformLocation(g_GpuProgramID, "view"); // Variável da matriz "view" em shader_vertex.glsl
-    g_projection_uniform = glGetUniformLocation(g_GpuProgramID, "projection"); // Variável da matriz "projection" em shader_vertex.glsl
-    g_object_id_uniform  = glGetUniformLocation(g_GpuProgramID, "object_id"); // Variável "object_id" em shader_fragment.glsl
-    g_material_id_uniform = glGetUniformLocation(g_GpuProgramID, "material_id"); // Variável "material_id" em shader_fragment.glsl
-    g_lighting_model_uniform = glGetUniformLocation(g_GpuProgramID, "lighting_model"); // Modelo de iluminação
-    g_Kd_uniform         = glGetUniformLocation(g_GpuProgramID, "Kd_uniform"); // Propriedades do material
-    g_Ka_uniform         = glGetUniformLocation(g_GpuProgramID, "Ka_uniform");
-    g_Ks_uniform         = glGetUniformLocation(g_GpuProgramID, "Ks_uniform");
-    g_q_uniform          = glGetUniformLocation(g_GpuProgramID, "q_uniform");
-
-    // Vincula samplers de textura às unidades de textura corretas
-    glUseProgram(g_GpuProgramID);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage0"), 0);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage1"), 1);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage2"), 2);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage3"), 3);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage4"), 4);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage5"), 5);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage6"), 6);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage7"), 7);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage8"), 8);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage9"), 9);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage9"), 9);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage10"), 10);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage11"), 11);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage12"), 12);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage13"), 13);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage14"), 14);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage15"), 15);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage16"), 16);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage17"), 17);
-    glUseProgram(0);
+    // As matrizes, os materiais e os dados de cada desenho chegam aos shaders
+    // por blocos de uniforms, preenchidos pela fila de desenho.
+    g_RenderProgram.id = g_GpuProgramID;
+    RenderQueue_InitProgram(g_GpuProgramID);
+
+    // Vincula o sampler dos arrays de texturas à sua unidade de textura
+    GLState_UseProgram(g_GpuProgramID);
+    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureArray"), TEXTURE_ARRAY_UNIT);
+    GLState_UseProgram(0);
 }
 
 // Função que computa as normais de um ObjModel, caso elas não tenham sido
 // especificadas dentro do arquivo ".obj"
-void ComputeNormals(ObjModel* model)
+void ComputeNormals(ObjModel* model, NormalWeighting weighting)
 {
     if ( !model->attrib.normals.empty() )
         return;
 
-    size_t num_vertices = model->attrib.vertices.size() / 3;
+    // Modelos carregados do cache já trazem as normais nos fluxos da malha.
+    if ( !model->mesh.Empty() )
+        return;
 
-    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
-    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
-    {
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+    ComputeVertexNormals(model->attrib, &model->shapes, weighting, &model->attrib.normals);
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
-        {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
-
-            glm::vec4  vertices[3];
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
-            }
-
-            const glm::vec4  a = vertices[0];
-            const glm::vec4  b = vertices[1];
-            const glm::vec4  c = vertices[2];
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Normais de \"%s\" calculadas em %.2f ms\n", model->filename.c_str(), ms);
+}
 
-            const glm::vec4  u = b - a;
-            const glm::vec4  v = c - a;
-            const glm::vec4  n = crossproduct(u,v);
+// Carrega um modelo pelo gerenciador de recursos (veja "assets.h"): um modelo
+// já carregado, pelo caminho ou pelo conteúdo, só ganha mais uma referência.
+// Senão, o ".obj" (ou o seu cache) é lido, as normais que faltarem são
+// calculadas e os objetos vão para a cena virtual; sem g_KeepMeshData, a
+// geometria em CPU é liberada em seguida. ".obj" muito grandes são lidos em
+// fluxo direto para a arena (veja "objstream.h"), sem passar pela CPU inteiros.
+ModelHandle LoadModel(const char* filename)
+{
+    ModelHandle handle = Assets_FindModel(filename);
+    if (handle.generation != 0)
+        return handle;
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                num_triangles_per_vertex[idx.vertex_index] += 1;
-                vertex_normals[idx.vertex_index] += n;
-                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
-            }
+    if (ShouldStreamObj(filename))
+    {
+        MeshAllocation allocation;
+        std::string err;
+        ObjModel* model = StreamObjToArena(filename, VERTEX_FORMAT_COMPACT, &allocation, &err);
+        if (model == NULL)
+        {
+            fprintf(stderr, "\nErro ao ler \"%s\": %s\n", filename, err.c_str());
+            throw std::runtime_error("Erro ao carregar modelo.");
         }
+        handle = Assets_AddModel(filename, model);
+        Assets_GetModel(handle)->allocation = allocation;
+        BuildTrianglesAndAddToVirtualScene(handle);
+        return handle;
     }
 
-    model->attrib.normals.resize( 3*num_vertices );
+    ObjModel* model = new ObjModel(filename);
+    ComputeNormals(model);
+    handle = Assets_AddModel(filename, model);
+    BuildTrianglesAndAddToVirtualScene(handle);
 
-    for (size_t i = 0; i < vertex_normals.size(); ++i)
+    if (!g_KeepMeshData)
     {
-        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
-        n /= norm(n);
-        model->attrib.normals[3*i + 0] = n.x;
-        model->attrib.normals[3*i + 1] = n.y;
-        model->attrib.normals[3*i + 2] = n.z;
+        size_t heap_before, mapped_before, heap_after, mapped_after;
+        ObjModelMemoryUsage(*model, &heap_before, &mapped_before);
+        ReleaseObjModelGeometry(model);
+        ObjModelMemoryUsage(*model, &heap_after, &mapped_after);
+        printf("Modelo \"%s\": %.1f KB em CPU (+%.1f KB mapeados) -> %.1f KB depois do envio\n",
+               filename, heap_before / 1024.0, mapped_before / 1024.0, (heap_after + mapped_after) / 1024.0);
     }
+    return handle;
 }
 
-// Constrói triângulos para futura renderização a partir de um ObjModel.
-void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
+// Libera uma referência a um modelo. Com a última, os seus objetos saem da
+// cena virtual.
+void UnloadModel(ModelHandle handle)
 {
-    GLuint vertex_array_object_id;
-    glGenVertexArrays(1, &vertex_array_object_id);
-    glBindVertexArray(vertex_array_object_id);
-
-    std::vector<GLuint> indices;
-    std::vector<float>  model_coefficients;
-    std::vector<float>  normal_coefficients;
-    std::vector<float>  texture_coefficients;
+    const ModelAsset* asset = Assets_GetModel(handle);
+    if (asset == NULL)
+        return;
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
-    {
-        size_t first_index = indices.size();
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+    // Um objeto com o mesmo nome pode ter sido substituído pelo de outro
+    // modelo; esse fica na cena.
+    std::vector<std::string> objects = asset->objects;
 
-        // Verifica se há material associado à primeira face para usar como padrão do shape
-        int shape_material_id = -1;
-        if (!model->shapes[shape].mesh.material_ids.empty()) {
-            shape_material_id = model->shapes[shape].mesh.material_ids[0];
-        }
+    // Com a última referência, os materiais saem da fila de desenho antes de
+    // Assets_ReleaseModel() destruir o ObjModel que os contém.
+    if (Assets_ModelReferences(handle) == 1)
+        RenderQueue_RemoveMaterials(asset->model->materials.data(), asset->model->materials.size());
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+    if (Assets_ReleaseModel(handle))
+    {
+        for (size_t i = 0; i < objects.size(); ++i)
         {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
-
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-
-                indices.push_back(first_index + 3*triangle + vertex);
-
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                model_coefficients.push_back( vx ); // X
-                model_coefficients.push_back( vy ); // Y
-                model_coefficients.push_back( vz ); // Z
-                model_coefficients.push_back( 1.0f ); // W
-
-                if ( idx.normal_index != -1 )
-                {
-                    const float nx = model->attrib.normals[3*idx.normal_index + 0];
-                    const float ny = model->attrib.normals[3*idx.normal_index + 1];
-                    const float nz = model->attrib.normals[3*idx.normal_index + 2];
-                    normal_coefficients.push_back( nx ); // X
-                    normal_coefficients.push_back( ny ); // Y
-                    normal_coefficients.push_back( nz ); // Z
-                    normal_coefficients.push_back( 0.0f ); // W
-                }
-
-                if ( idx.texcoord_index != -1 )
-                {
-                    const float u = model->attrib.texcoords[2*idx.texcoord_index + 0];
-                    const float v = model->attrib.texcoords[2*idx.texcoord_index + 1];
-                    texture_coefficients.push_back( u );
-                    texture_coefficients.push_back( v );
-                }
-            }
+            SceneObjectHandle object = Scene_Find(objects[i]);
+            const SceneObject* obj = Scene_Get(object);
+            if (obj != NULL && obj->model.index == handle.index && obj->model.generation == handle.generation)
+                Scene_Remove(object);
         }
+    }
+}
 
-        size_t last_index = indices.size() - 1;
-
-        SceneObject theobject;
-        theobject.name           = model->shapes[shape].name;
-        theobject.first_index    = first_index; 
-        theobject.num_indices    = last_index - first_index + 1; 
-        theobject.rendering_mode = GL_TRIANGLES;       // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
-        theobject.vertex_array_object_id = vertex_array_object_id;
-        theobject.material_id    = shape_material_id; // ID do material associado
+// Constrói triângulos para futura renderização a partir de um ObjModel já
+// registrado no gerenciador de recursos.
+void BuildTrianglesAndAddToVirtualScene(ModelHandle handle)
+{
+    ModelAsset* asset = Assets_GetModel(handle);
+    ObjModel*   model = asset->model;
 
-        g_VirtualScene[model->shapes[shape].name] = theobject;
-        
-        // Armazena o modelo para acessar materiais posteriormente
-        g_LoadedModels[model->shapes[shape].name] = model;
+    // Se o modelo não veio do cache binário, expande as faces do OBJ nos fluxos
+    // que vão para a GPU e grava o cache para as próximas execuções.
+    if (model->mesh.Empty())
+    {
+        BuildMeshData(model->attrib, model->shapes, model->vertex_format, &model->mesh);
+        SaveMeshCache(*model);
     }
 
-    GLuint VBO_model_coefficients_id;
-    glGenBuffers(1, &VBO_model_coefficients_id);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
-    GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
-    GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    if ( !normal_coefficients.empty() )
+    const MeshData& mesh = model->mesh;
+    const bool compact = mesh.vertex_format == VERTEX_FORMAT_COMPACT;
+
+    // Sem a unificação de vértices, cada índice teria o seu próprio vértice.
+    // Os índices dos níveis de detalhe ficam de fora da conta.
+    size_t num_indices  = 0;
+    for (size_t shape = 0; shape < mesh.shapes.size(); ++shape)
+        num_indices += mesh.shapes[shape].num_indices;
+    // Um modelo lido em fluxo já está na arena, sem os fluxos em CPU.
+    const bool uploaded = asset->allocation.vertex_bytes > 0;
+    size_t vertex_bytes = uploaded ? asset->allocation.vertex_bytes : mesh.vertices.Size();
+    size_t num_vertices = vertex_bytes / VertexFormatStride(mesh.vertex_format);
+    printf("Modelo \"%s\": %zu vértices (%zu sem indexação, %.1fx menos), %s, %zu KB de vértices, índices de %u bits\n",
+           model->filename.c_str(), num_vertices, num_indices,
+           num_vertices > 0 ? (double)num_indices / num_vertices : 0.0,
+           compact ? "formato compacto" : "formato float",
+           vertex_bytes / 1024, (unsigned)mesh.index_size * 8);
+
+    // Os fluxos são copiados para a arena de malhas compartilhada.
+    if (!uploaded)
+        asset->allocation = MeshArena_Upload(mesh);
+    const MeshAllocation allocation = asset->allocation;
+
+    // A textura difusa (map_Kd) de cada material, procurada entre as imagens
+    // já carregadas com o caminho relativo ao diretório do ".obj".
+    std::string dirname;
+    size_t slash = model->filename.find_last_of("/");
+    if (slash != std::string::npos)
+        dirname = model->filename.substr(0, slash + 1);
+
+    std::vector<TextureLayer> material_textures(model->materials.size());
+    for (size_t m = 0; m < model->materials.size(); ++m)
     {
-        GLuint VBO_normal_coefficients_id;
-        glGenBuffers(1, &VBO_normal_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
-        location = 1; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        const std::string& texname = model->materials[m].diffuse_texname;
+        if (texname.empty())
+            continue;
+        // Cada material segura uma referência à sua imagem enquanto o modelo
+        // estiver carregado.
+        ImageHandle image = Assets_FindImage(dirname + texname);
+        if (image.generation != 0)
+        {
+            Assets_AcquireImage(image);
+            asset->images.push_back(image);
+        }
+        material_textures[m] = Assets_GetImage(image);
+        if (material_textures[m].array < 0)
+            fprintf(stderr, "WARNING: Texture \"%s%s\" of material \"%s\" was not loaded.\n",
+                    dirname.c_str(), texname.c_str(), model->materials[m].name.c_str());
     }
 
-    if ( !texture_coefficients.empty() )
+    // As propriedades dos materiais vão para a tabela de materiais da GPU
+    // (veja "renderqueue.h").
+    RenderQueue_AddMaterials(model->materials.data(), model->materials.size());
+
+    for (size_t shape = 0; shape < mesh.shapes.size(); ++shape)
     {
-        GLuint VBO_texture_coefficients_id;
-        glGenBuffers(1, &VBO_texture_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
-        location = 2; // "(location = 2)" em "shader_vertex.glsl"
-        number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
+        SceneObject theobject;
+        theobject.first_index    = allocation.first_index + mesh.shapes[shape].first_index;
+        theobject.num_indices    = mesh.shapes[shape].num_indices;
+        theobject.rendering_mode = GL_TRIANGLES;       // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
+        theobject.vertex_array_object_id = MeshArena_VertexArray(mesh.vertex_format);
+        theobject.base_vertex    = allocation.base_vertex;
+        theobject.material_id    = mesh.shapes[shape].material_id; // ID do material associado
+        theobject.model          = handle;
+        if (theobject.material_id >= 0 && theobject.material_id < (int)material_textures.size())
+            theobject.texture    = material_textures[theobject.material_id];
+        theobject.index_type     = mesh.index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        theobject.position_offset = glm::make_vec3(mesh.position_offset);
+        theobject.position_scale  = glm::make_vec3(mesh.position_scale);
+
+        const std::vector<MeshLod>& lods = mesh.shapes[shape].lods;
+        for (size_t l = 0; l < lods.size(); ++l)
+        {
+            SceneObjectLod lod;
+            lod.first_index = allocation.first_index + lods[l].first_index;
+            lod.num_indices = lods[l].num_indices;
+            lod.error       = lods[l].error;
+            theobject.lods.push_back(lod);
+        }
 
-    GLuint indices_id;
-    glGenBuffers(1, &indices_id);
+        theobject.meshlets = mesh.shapes[shape].meshlets;
+        for (size_t m = 0; m < theobject.meshlets.size(); ++m)
+            theobject.meshlets[m].first_index += (uint32_t)allocation.first_index;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+        const BoundingBox& box = model->shape_bboxes[shape];
+        theobject.bounding_center = 0.5f * (box.min + box.max);
+        theobject.bounding_radius = 0.5f * glm::length(box.max - box.min);
 
-    glBindVertexArray(0);
+        Scene_Add(mesh.shapes[shape].name, theobject);
+        asset->objects.push_back(mesh.shapes[shape].name);
+    }
 }
 
 // Carrega um Vertex Shader de um arquivo GLSL. 
@@ -1141,6 +1199,7 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 
     g_ScreenRatio = (float)width / height;
+    g_ScreenHeight = (float)height;
 }
 
 // Variáveis globais que armazenam a última posição do cursor do mouse
@@ -1341,36 +1400,6 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
 
 }
 
-// Função para aplicar as propriedades do material
-void ApplyMaterial(const tinyobj::material_t& material)
-{
-    // Aplica as propriedades do material via uniformes, utilizados nos shaders posteriormente
-    glUniform3f(g_Kd_uniform, 
-        material.diffuse[0], 
-        material.diffuse[1], 
-        material.diffuse[2]);
-    glUniform3f(g_Ka_uniform, 
-        material.ambient[0], 
-        material.ambient[1], 
-        material.ambient[2]);
-    glUniform3f(g_Ks_uniform, 
-        material.specular[0], 
-        material.specular[1], 
-        material.specular[2]);
-    glUniform1f(g_q_uniform, material.shininess);
-}
-
-// Desenha um objeto armazenado em g_VirtualScene com material específico
-void DrawVirtualObjectWithMaterial(const char* object_name, const tinyobj::material_t* material)
-{
-    // Aplica o material se fornecido
-    if (material != nullptr) {
-        ApplyMaterial(*material);
-    }
-    
-    DrawVirtualObject(object_name);
-}
-
 // Calcula ponto na curva cúbica de Bézier
 glm::vec3 CalculateBezierPoint(float t, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3)
 {
@@ -1515,6 +1544,25 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
     TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
 }
 
+// Escreve na tela, abaixo do fps, os contadores do último quadro da fila de
+// desenho (veja "renderqueue.h") e do cache de estado do OpenGL
+void TextRendering_ShowRenderStats(GLFWwindow* window)
+{
+    const RenderQueueStats& stats = RenderQueue_Stats();
+    char buffer[80];
+    int numchars = snprintf(buffer, sizeof(buffer), "%zu objetos, %zu draws, %zu estados, %zu uniforms",
+                            stats.packets, stats.draws, stats.state_changes, stats.uniforms);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-2.0f*lineheight, 1.0f);
+
+    numchars = snprintf(buffer, sizeof(buffer), "GL: %zu chamadas, %zu filtradas",
+                        g_FrameGLStateStats.issued, g_FrameGLStateStats.filtered);
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-3.0f*lineheight, 1.0f);
+}
+
 // Função para renderizar o texto de "GAME OVER" e a pontuação na tela
 void TextRendering_ScoreandGameOVer(GLFWwindow* window)
 {
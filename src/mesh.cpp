@@ -0,0 +1,438 @@
+#include "mesh.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include "meshlets.h"
+#include "meshoptimizer.h"
+#include "meshsimplify.h"
+
+namespace {
+
+// Parâmetros da cadeia de LODs: cada nível tenta ter metade dos triângulos do
+// anterior, com erro de no máximo LOD_MAX_RELATIVE_ERROR vezes a diagonal da
+// caixa do shape. A cadeia para quando um nível não reduz pelo menos
+// LOD_MIN_REDUCTION dos índices ou o shape fica pequeno demais.
+const size_t LOD_MAX_LEVELS         = 4;
+const float  LOD_MAX_RELATIVE_ERROR = 0.1f;
+const float  LOD_MIN_REDUCTION      = 0.15f;
+const size_t LOD_MIN_INDICES        = 3 * 32;
+
+// Só vale a pena dividir em meshlets os shapes densos; nos pequenos o custo das
+// chamadas de desenho extras supera o ganho do descarte.
+const size_t MESHLET_MIN_TRIANGLES  = 2048;
+
+// Atributos de um vértice expandido. Dois vértices só são unificados se todos
+// os valores forem idênticos bit a bit (inclusive a presença de normal e de
+// coordenada de textura).
+struct VertexKey
+{
+    float position[3];
+    float normal[3];
+    float texcoord[2];
+    int   has_normal;
+    int   has_texcoord;
+
+    bool operator==(const VertexKey& other) const
+    {
+        return memcmp(this, &other, sizeof(VertexKey)) == 0;
+    }
+};
+
+struct VertexKeyHash
+{
+    size_t operator()(const VertexKey& key) const
+    {
+        // FNV-1a sobre os bytes da chave
+        const unsigned char* bytes = (const unsigned char*)&key;
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < sizeof(VertexKey); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return (size_t)hash;
+    }
+};
+
+// Conversão de float (IEEE 754, 32 bits) para half float (16 bits), com
+// arredondamento para o par mais próximo.
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000;
+    int32_t  exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) // Inf ou NaN
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    if (exponent >= 31) // Grande demais: infinito
+        return (uint16_t)(sign | 0x7c00);
+
+    if (exponent <= 0) // Subnormal ou zero
+    {
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            ++half;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        ++half; // Pode propagar para o expoente, o que também é correto
+    return (uint16_t)(sign | half);
+}
+
+// Normal unitária em GL_INT_2_10_10_10_REV: X nos bits 0-9, Y em 10-19,
+// Z em 20-29, cada um com sinal e normalizado para [-511, 511].
+uint32_t PackNormal(const float* n)
+{
+    float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    float inv = length > 0.0f ? 1.0f / length : 0.0f;
+
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        float c = n[i] * inv;
+        c = c < -1.0f ? -1.0f : (c > 1.0f ? 1.0f : c);
+        int32_t q = (int32_t)std::floor(c * 511.0f + 0.5f);
+        packed |= ((uint32_t)q & 0x3ff) << (10 * i);
+    }
+    return packed;
+}
+
+void EncodeFloat(const VertexKey& v, unsigned char* out)
+{
+    float data[8] = {
+        v.position[0], v.position[1], v.position[2],
+        v.normal[0], v.normal[1], v.normal[2],
+        v.texcoord[0], v.texcoord[1],
+    };
+    memcpy(out, data, sizeof(data));
+}
+
+void EncodeCompact(const VertexKey& v, const float* offset, const float* scale, unsigned char* out)
+{
+    uint16_t position[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 3; ++i)
+    {
+        float t = scale[i] > 0.0f ? (v.position[i] - offset[i]) / scale[i] : 0.0f;
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        position[i] = (uint16_t)std::floor(t * 65535.0f + 0.5f);
+    }
+    uint32_t normal = PackNormal(v.normal);
+    uint16_t texcoord[2] = { FloatToHalf(v.texcoord[0]), FloatToHalf(v.texcoord[1]) };
+
+    memcpy(out + 0,  position, sizeof(position));
+    memcpy(out + 8,  &normal,  sizeof(normal));
+    memcpy(out + 12, texcoord, sizeof(texcoord));
+}
+
+} // namespace
+
+size_t VertexFormatStride(VertexFormat format)
+{
+    return format == VERTEX_FORMAT_COMPACT ? 16 : 32;
+}
+
+void EncodeVertex(VertexFormat format, const float* position, const float* normal, const float* texcoord,
+                  const float* position_offset, const float* position_scale, unsigned char* out)
+{
+    VertexKey key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.position, position, sizeof(key.position));
+    if (normal != NULL)
+        memcpy(key.normal, normal, sizeof(key.normal));
+    if (texcoord != NULL)
+        memcpy(key.texcoord, texcoord, sizeof(key.texcoord));
+
+    if (format == VERTEX_FORMAT_COMPACT)
+        EncodeCompact(key, position_offset, position_scale, out);
+    else
+        EncodeFloat(key, out);
+}
+
+// Constrói os fluxos de vértices e índices a partir de um modelo tinyobj.
+// Vértices com a mesma posição, normal e coordenada de textura são emitidos
+// uma única vez e referenciados pelo fluxo de índices, para que a GPU possa
+// reaproveitar o resultado do vertex shader. Em seguida triângulos e vértices
+// são reordenados para o cache de vértices, overdraw e localidade de leitura.
+void BuildMeshData(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                   VertexFormat format, MeshData* mesh)
+{
+    std::vector<uint32_t>  indices;
+    std::vector<VertexKey> vertices;
+
+    size_t total_indices = 0;
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+        total_indices += shapes[shape].mesh.indices.size();
+
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertex_map;
+    vertex_map.reserve(total_indices);
+    indices.reserve(total_indices);
+
+    mesh->shapes.clear();
+    mesh->has_normals = false;
+    mesh->has_texcoords = false;
+
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+    {
+        size_t first_index = indices.size();
+        size_t num_triangles = shapes[shape].mesh.num_face_vertices.size();
+
+        // Verifica se há material associado à primeira face para usar como padrão do shape
+        int shape_material_id = -1;
+        if (!shapes[shape].mesh.material_ids.empty()) {
+            shape_material_id = shapes[shape].mesh.material_ids[0];
+        }
+
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        {
+            assert(shapes[shape].mesh.num_face_vertices[triangle] == 3);
+
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = shapes[shape].mesh.indices[3*triangle + vertex];
+
+                VertexKey key;
+                memset(&key, 0, sizeof(key)); // Zera também o padding, comparado por memcmp()
+                key.position[0] = attrib.vertices[3*idx.vertex_index + 0];
+                key.position[1] = attrib.vertices[3*idx.vertex_index + 1];
+                key.position[2] = attrib.vertices[3*idx.vertex_index + 2];
+                key.has_normal = idx.normal_index != -1;
+                if ( key.has_normal )
+                {
+                    key.normal[0] = attrib.normals[3*idx.normal_index + 0];
+                    key.normal[1] = attrib.normals[3*idx.normal_index + 1];
+                    key.normal[2] = attrib.normals[3*idx.normal_index + 2];
+                    mesh->has_normals = true;
+                }
+                key.has_texcoord = idx.texcoord_index != -1;
+                if ( key.has_texcoord )
+                {
+                    key.texcoord[0] = attrib.texcoords[2*idx.texcoord_index + 0];
+                    key.texcoord[1] = attrib.texcoords[2*idx.texcoord_index + 1];
+                    mesh->has_texcoords = true;
+                }
+
+                uint32_t new_index = (uint32_t)vertices.size();
+                std::pair<std::unordered_map<VertexKey, uint32_t, VertexKeyHash>::iterator, bool> inserted
+                    = vertex_map.insert(std::make_pair(key, new_index));
+                indices.push_back(inserted.first->second);
+                if (inserted.second)
+                    vertices.push_back(key);
+            }
+        }
+
+        MeshShape theshape;
+        theshape.name        = shapes[shape].name;
+        theshape.first_index = first_index;
+        theshape.num_indices = indices.size() - first_index;
+        theshape.material_id = shape_material_id;
+        mesh->shapes.push_back(theshape);
+    }
+
+    // Otimiza a ordem dos triângulos de cada shape para o cache de vértices e
+    // para overdraw (veja "meshoptimizer.h"), e depois a ordem dos vértices.
+    // Cada shape é otimizado com uma numeração local dos seus vértices, para
+    // que o custo dependa do tamanho do shape, não do modelo inteiro.
+    std::vector<uint32_t> local_remap;
+    std::vector<uint32_t> local_vertices;
+    std::vector<float>    local_positions;
+    for (size_t shape = 0; shape < mesh->shapes.size(); ++shape)
+    {
+        uint32_t* shape_indices = indices.data() + mesh->shapes[shape].first_index;
+        size_t    count = mesh->shapes[shape].num_indices;
+
+        MakeLocalIndices(shape_indices, count, vertices.size(), &local_remap, &local_vertices);
+        size_t local_count = local_vertices.size();
+        local_positions.resize(3 * local_count);
+        for (size_t v = 0; v < local_count; ++v)
+            memcpy(&local_positions[3*v], vertices[local_vertices[v]].position, 3 * sizeof(float));
+
+        VertexCacheStatistics before = AnalyzeVertexCache(shape_indices, count, local_count);
+        OptimizeVertexCache(shape_indices, count, local_count);
+        OptimizeOverdraw(shape_indices, count, local_count, local_positions.empty() ? NULL : local_positions.data(),
+                         3 * sizeof(float));
+        VertexCacheStatistics after = AnalyzeVertexCache(shape_indices, count, local_count);
+        RestoreGlobalIndices(shape_indices, count, local_vertices);
+
+        printf("  - Shape '%s': ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", mesh->shapes[shape].name.c_str(),
+               before.acmr, after.acmr, before.atvr, after.atvr);
+    }
+
+    // Divide os shapes densos em meshlets. Isso reordena os triângulos do LOD
+    // 0 de novo, agora em grupos espacialmente compactos.
+    for (size_t shape = 0; shape < mesh->shapes.size() && !vertices.empty(); ++shape)
+    {
+        MeshShape& theshape = mesh->shapes[shape];
+        theshape.meshlets.clear();
+        if (theshape.num_indices / 3 < MESHLET_MIN_TRIANGLES)
+            continue;
+
+        uint32_t* shape_indices = indices.data() + theshape.first_index;
+        BuildMeshlets(&theshape.meshlets, shape_indices, theshape.num_indices, vertices.size(),
+                      vertices[0].position, sizeof(VertexKey));
+        for (size_t m = 0; m < theshape.meshlets.size(); ++m)
+            theshape.meshlets[m].first_index += theshape.first_index;
+
+        size_t cullable = 0;
+        for (size_t m = 0; m < theshape.meshlets.size(); ++m)
+            cullable += theshape.meshlets[m].cone_cutoff < 1.0f;
+
+        MakeLocalIndices(shape_indices, theshape.num_indices, vertices.size(), &local_remap, &local_vertices);
+        VertexCacheStatistics statistics = AnalyzeVertexCache(shape_indices, theshape.num_indices, local_vertices.size());
+        RestoreGlobalIndices(shape_indices, theshape.num_indices, local_vertices);
+        printf("  - Shape '%s': %zu meshlets (%.1f triângulos em média, %zu com cone de normais), ACMR %.3f\n",
+               theshape.name.c_str(), theshape.meshlets.size(),
+               (double)theshape.num_indices / 3 / theshape.meshlets.size(), cullable, statistics.acmr);
+    }
+
+    // Cadeia de LODs de cada shape, com os índices colocados depois de todos
+    // os LODs 0. Cada nível é simplificado a partir do anterior.
+    for (size_t shape = 0; shape < mesh->shapes.size() && !vertices.empty(); ++shape)
+    {
+        MeshShape& theshape = mesh->shapes[shape];
+        theshape.lods.clear();
+
+        float minimum[3], maximum[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            minimum[i] = std::numeric_limits<float>::max();
+            maximum[i] = -std::numeric_limits<float>::max();
+        }
+        for (size_t i = theshape.first_index; i < theshape.first_index + theshape.num_indices; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                minimum[k] = std::min(minimum[k], vertices[indices[i]].position[k]);
+                maximum[k] = std::max(maximum[k], vertices[indices[i]].position[k]);
+            }
+        }
+        float diagonal = std::sqrt((maximum[0]-minimum[0])*(maximum[0]-minimum[0])
+                                 + (maximum[1]-minimum[1])*(maximum[1]-minimum[1])
+                                 + (maximum[2]-minimum[2])*(maximum[2]-minimum[2]));
+
+        // A cadeia é simplificada com os vértices do shape numerados 0..n-1;
+        // os índices voltam à numeração do modelo ao serem guardados.
+        std::vector<uint32_t> previous(indices.begin() + theshape.first_index,
+                                       indices.begin() + theshape.first_index + theshape.num_indices);
+        std::vector<uint32_t> lod(previous.size());
+        MakeLocalIndices(previous.data(), previous.size(), vertices.size(), &local_remap, &local_vertices);
+        local_positions.resize(3 * local_vertices.size());
+        for (size_t v = 0; v < local_vertices.size(); ++v)
+            memcpy(&local_positions[3*v], vertices[local_vertices[v]].position, 3 * sizeof(float));
+
+        for (size_t level = 1; level <= LOD_MAX_LEVELS && previous.size() >= LOD_MIN_INDICES; ++level)
+        {
+            float error = 0.0f;
+            size_t target = previous.size() / 6 * 3;
+            size_t count = SimplifyMesh(lod.data(), previous.data(), previous.size(),
+                                        local_positions.data(), 3 * sizeof(float), local_vertices.size(),
+                                        target, diagonal * LOD_MAX_RELATIVE_ERROR, &error);
+            if (count == 0 || count > previous.size() * (1.0f - LOD_MIN_REDUCTION))
+                break;
+
+            // O erro de cada nível é medido em relação ao anterior; somando,
+            // tem-se um limite para o erro em relação ao LOD 0.
+            if (!theshape.lods.empty())
+                error += theshape.lods.back().error;
+
+            OptimizeVertexCache(lod.data(), count, local_vertices.size());
+
+            MeshLod thelod;
+            thelod.first_index = (uint32_t)indices.size();
+            thelod.num_indices = (uint32_t)count;
+            thelod.error       = error;
+            theshape.lods.push_back(thelod);
+
+            previous.assign(lod.begin(), lod.begin() + count);
+            RestoreGlobalIndices(lod.data(), count, local_vertices);
+            indices.insert(indices.end(), lod.begin(), lod.begin() + count);
+        }
+
+        if (!theshape.lods.empty())
+        {
+            printf("  - Shape '%s': LODs %u", theshape.name.c_str(), theshape.num_indices / 3);
+            for (size_t level = 0; level < theshape.lods.size(); ++level)
+                printf(" -> %u (erro %.4g)", theshape.lods[level].num_indices / 3, theshape.lods[level].error);
+            printf(" triângulos\n");
+        }
+    }
+
+    std::vector<uint32_t> remap;
+    size_t used_vertices = OptimizeVertexFetchRemap(&remap, indices.data(), indices.size(), vertices.size());
+    std::vector<VertexKey> fetch_ordered(used_vertices);
+    for (size_t v = 0; v < vertices.size(); ++v)
+        if (remap[v] != UINT32_MAX)
+            fetch_ordered[remap[v]] = vertices[v];
+    for (size_t i = 0; i < indices.size(); ++i)
+        indices[i] = remap[indices[i]];
+    vertices.swap(fetch_ordered);
+
+    // Intervalo de quantização das posições: a caixa que envolve os vértices
+    // efetivamente usados pela malha.
+    mesh->vertex_format = format;
+    for (int i = 0; i < 3; ++i)
+    {
+        mesh->position_offset[i] = 0.0f;
+        mesh->position_scale[i]  = 1.0f;
+    }
+    if (format == VERTEX_FORMAT_COMPACT && !vertices.empty())
+    {
+        float minimum[3], maximum[3];
+        for (int i = 0; i < 3; ++i)
+            minimum[i] = maximum[i] = vertices[0].position[i];
+        for (size_t v = 1; v < vertices.size(); ++v)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                minimum[i] = std::min(minimum[i], vertices[v].position[i]);
+                maximum[i] = std::max(maximum[i], vertices[v].position[i]);
+            }
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            mesh->position_offset[i] = minimum[i];
+            mesh->position_scale[i]  = maximum[i] - minimum[i];
+        }
+    }
+
+    const size_t stride = VertexFormatStride(format);
+    std::vector<unsigned char> vertex_bytes(vertices.size() * stride);
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        if (format == VERTEX_FORMAT_COMPACT)
+            EncodeCompact(vertices[v], mesh->position_offset, mesh->position_scale, &vertex_bytes[v * stride]);
+        else
+            EncodeFloat(vertices[v], &vertex_bytes[v * stride]);
+    }
+    mesh->vertices.Assign(vertex_bytes);
+
+    if (vertices.size() < 65536)
+    {
+        std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+        mesh->indices.Assign(short_indices);
+        mesh->index_size = 2;
+    }
+    else
+    {
+        mesh->indices.Assign(indices);
+        mesh->index_size = 4;
+    }
+
+    mesh->mapping.reset();
+}
@@ -0,0 +1,254 @@
+#include "mesharena.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "glstate.h"
+
+namespace {
+
+// Capacidade inicial dos buffers. Cresce conforme a necessidade.
+const size_t INITIAL_VERTEX_CAPACITY = 4 * 1024 * 1024;
+const size_t INITIAL_INDEX_CAPACITY  = 2 * 1024 * 1024;
+
+// Os blocos de vértices são alinhados ao maior stride (32 bytes), de forma que
+// o deslocamento de qualquer malha é múltiplo do seu próprio stride. Os blocos
+// de índices são alinhados a 4 bytes, o que serve para índices de 16 e 32 bits.
+const size_t VERTEX_ALIGNMENT = 32;
+const size_t INDEX_ALIGNMENT  = 4;
+
+struct FreeBlock
+{
+    size_t offset;
+    size_t size;
+};
+
+struct ArenaBuffer
+{
+    GLenum                 target;
+    GLuint                 id;
+    size_t                 capacity;
+    size_t                 alignment;
+    size_t                 used;
+    std::vector<FreeBlock> free_blocks; // Ordenados por deslocamento, sem blocos adjacentes
+};
+
+ArenaBuffer g_VertexBuffer = { GL_ARRAY_BUFFER,         0, 0, VERTEX_ALIGNMENT, 0, std::vector<FreeBlock>() };
+ArenaBuffer g_IndexBuffer  = { GL_ELEMENT_ARRAY_BUFFER, 0, 0, INDEX_ALIGNMENT,  0, std::vector<FreeBlock>() };
+GLuint      g_VertexArrays[2] = { 0, 0 }; // Indexado por VertexFormat
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Devolve um intervalo à lista de blocos livres, unindo-o aos vizinhos.
+void ReleaseBlock(ArenaBuffer& buffer, size_t offset, size_t size)
+{
+    std::vector<FreeBlock>& blocks = buffer.free_blocks;
+
+    size_t i = 0;
+    while (i < blocks.size() && blocks[i].offset < offset)
+        ++i;
+
+    FreeBlock block = { offset, size };
+    blocks.insert(blocks.begin() + i, block);
+
+    if (i + 1 < blocks.size() && blocks[i].offset + blocks[i].size == blocks[i + 1].offset)
+    {
+        blocks[i].size += blocks[i + 1].size;
+        blocks.erase(blocks.begin() + i + 1);
+    }
+    if (i > 0 && blocks[i - 1].offset + blocks[i - 1].size == blocks[i].offset)
+    {
+        blocks[i - 1].size += blocks[i].size;
+        blocks.erase(blocks.begin() + i);
+    }
+}
+
+// Configura os atributos do VAO de um formato (veja "shader_vertex.glsl").
+void SetupVertexArray(VertexFormat format)
+{
+    GLsizei stride = (GLsizei)VertexFormatStride(format);
+
+    GLState_BindVertexArray(g_VertexArrays[format]);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, g_VertexBuffer.id);
+
+    if (format == VERTEX_FORMAT_COMPACT)
+    {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)8);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)12);
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)12);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)24);
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    GLState_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_IndexBuffer.id);
+
+    GLState_BindVertexArray(0);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Recria um buffer com capacidade maior, copiando o conteúdo antigo na GPU.
+void GrowBuffer(ArenaBuffer& buffer, size_t new_capacity)
+{
+    GLuint new_id;
+    glGenBuffers(1, &new_id);
+    GLState_BindBuffer(GL_COPY_WRITE_BUFFER, new_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, NULL, GL_STATIC_DRAW);
+
+    if (buffer.id != 0)
+    {
+        GLState_BindBuffer(GL_COPY_READ_BUFFER, buffer.id);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, buffer.capacity);
+        GLState_BindBuffer(GL_COPY_READ_BUFFER, 0);
+        GLState_DeleteBuffer(buffer.id);
+    }
+    GLState_BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    size_t old_capacity = buffer.capacity;
+    buffer.id = new_id;
+    buffer.capacity = new_capacity;
+    ReleaseBlock(buffer, old_capacity, new_capacity - old_capacity);
+
+    // Os VAOs guardam o identificador do buffer antigo.
+    for (int format = 0; format < 2; ++format)
+        if (g_VertexArrays[format] != 0)
+            SetupVertexArray((VertexFormat)format);
+}
+
+// Reserva "size" bytes (first fit), aumentando o buffer se necessário.
+size_t AllocateBlock(ArenaBuffer& buffer, size_t size, size_t initial_capacity)
+{
+    size = AlignUp(size, buffer.alignment);
+
+    for (;;)
+    {
+        for (size_t i = 0; i < buffer.free_blocks.size(); ++i)
+        {
+            FreeBlock& block = buffer.free_blocks[i];
+            if (block.size < size)
+                continue;
+
+            size_t offset = block.offset;
+            block.offset += size;
+            block.size   -= size;
+            if (block.size == 0)
+                buffer.free_blocks.erase(buffer.free_blocks.begin() + i);
+            buffer.used += size;
+            return offset;
+        }
+
+        size_t new_capacity = std::max(buffer.capacity * 2, initial_capacity);
+        while (new_capacity - buffer.capacity < size)
+            new_capacity *= 2;
+        GrowBuffer(buffer, new_capacity);
+    }
+}
+
+void InitArena()
+{
+    if (g_VertexArrays[0] != 0)
+        return;
+
+    glGenVertexArrays(2, g_VertexArrays);
+    GrowBuffer(g_VertexBuffer, INITIAL_VERTEX_CAPACITY);
+    GrowBuffer(g_IndexBuffer, INITIAL_INDEX_CAPACITY);
+}
+
+} // namespace
+
+MeshAllocation MeshArena_Allocate(VertexFormat format, size_t vertex_bytes, size_t index_bytes, uint32_t index_size)
+{
+    InitArena();
+
+    MeshAllocation allocation;
+    allocation.vertex_format = format;
+    allocation.vertex_bytes  = vertex_bytes;
+    allocation.index_bytes   = index_bytes;
+    allocation.vertex_offset = AllocateBlock(g_VertexBuffer, vertex_bytes, INITIAL_VERTEX_CAPACITY);
+    allocation.index_offset  = AllocateBlock(g_IndexBuffer, index_bytes, INITIAL_INDEX_CAPACITY);
+    allocation.base_vertex   = (GLint)(allocation.vertex_offset / VertexFormatStride(format));
+    allocation.first_index   = allocation.index_offset / index_size;
+    return allocation;
+}
+
+void MeshArena_WriteVertices(const MeshAllocation& allocation, size_t offset, const void* data, size_t size)
+{
+    GLState_BindBuffer(GL_COPY_WRITE_BUFFER, g_VertexBuffer.id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.vertex_offset + offset, size, data);
+    GLState_BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshArena_WriteIndices(const MeshAllocation& allocation, size_t offset, const void* data, size_t size)
+{
+    GLState_BindBuffer(GL_COPY_WRITE_BUFFER, g_IndexBuffer.id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.index_offset + offset, size, data);
+    GLState_BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshArena_Shrink(MeshAllocation* allocation, size_t vertex_bytes, size_t index_bytes)
+{
+    size_t old_vertex = AlignUp(allocation->vertex_bytes, g_VertexBuffer.alignment);
+    size_t new_vertex = AlignUp(vertex_bytes, g_VertexBuffer.alignment);
+    if (new_vertex < old_vertex)
+    {
+        ReleaseBlock(g_VertexBuffer, allocation->vertex_offset + new_vertex, old_vertex - new_vertex);
+        g_VertexBuffer.used -= old_vertex - new_vertex;
+    }
+
+    size_t old_index = AlignUp(allocation->index_bytes, g_IndexBuffer.alignment);
+    size_t new_index = AlignUp(index_bytes, g_IndexBuffer.alignment);
+    if (new_index < old_index)
+    {
+        ReleaseBlock(g_IndexBuffer, allocation->index_offset + new_index, old_index - new_index);
+        g_IndexBuffer.used -= old_index - new_index;
+    }
+
+    allocation->vertex_bytes = vertex_bytes;
+    allocation->index_bytes  = index_bytes;
+}
+
+MeshAllocation MeshArena_Upload(const MeshData& mesh)
+{
+    MeshAllocation allocation = MeshArena_Allocate(mesh.vertex_format, mesh.vertices.Size(), mesh.indices.Size(),
+                                                   mesh.index_size);
+
+    // Os ponteiros podem apontar direto para o arquivo de cache mapeado em
+    // memória, de onde os dados são copiados para a GPU.
+    MeshArena_WriteVertices(allocation, 0, mesh.vertices.Data(), allocation.vertex_bytes);
+    MeshArena_WriteIndices(allocation, 0, mesh.indices.Data(), allocation.index_bytes);
+    return allocation;
+}
+
+void MeshArena_Free(const MeshAllocation& allocation)
+{
+    size_t vertex_bytes = AlignUp(allocation.vertex_bytes, g_VertexBuffer.alignment);
+    size_t index_bytes  = AlignUp(allocation.index_bytes, g_IndexBuffer.alignment);
+
+    ReleaseBlock(g_VertexBuffer, allocation.vertex_offset, vertex_bytes);
+    ReleaseBlock(g_IndexBuffer, allocation.index_offset, index_bytes);
+    g_VertexBuffer.used -= vertex_bytes;
+    g_IndexBuffer.used  -= index_bytes;
+}
+
+GLuint MeshArena_VertexArray(VertexFormat format)
+{
+    InitArena();
+    return g_VertexArrays[format];
+}
+
+void MeshArena_PrintStats()
+{
+    printf("Arena de malhas: vértices %zu/%zu KB, índices %zu/%zu KB, %zu+%zu blocos livres\n",
+           g_VertexBuffer.used / 1024, g_VertexBuffer.capacity / 1024,
+           g_IndexBuffer.used / 1024, g_IndexBuffer.capacity / 1024,
+           g_VertexBuffer.free_blocks.size(), g_IndexBuffer.free_blocks.size());
+}
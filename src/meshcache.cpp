@@ -0,0 +1,533 @@
+#include "meshcache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+// Layout do arquivo (little-endian nativo, sem compressão):
+//
+//   MeshCacheHeader
+//   MeshCacheSection[num_sections]
+//   dados de cada seção, alinhados em 16 bytes
+//
+// Os fluxos (seções de vértices e índices) são gravados exatamente como são
+// enviados para a GPU, para que possam ser usados direto do mapeamento.
+
+namespace {
+
+const char     MESH_CACHE_MAGIC[4] = { 'F', 'C', 'G', 'M' };
+const uint32_t MESH_CACHE_BYTE_ORDER = 0x01020304;
+
+enum MeshCacheSectionType
+{
+    // 1, 2 e 3 eram os fluxos separados de posição, normal e textura
+    // (versões 1 e 2), substituídos por SECTION_VERTICES.
+    SECTION_INDICES              = 4,
+    SECTION_SHAPES               = 5,
+    SECTION_MATERIALS            = 6,
+    SECTION_BOUNDS               = 7,
+    SECTION_VERTICES             = 8,
+    SECTION_VERTEX_FORMAT        = 9,
+    SECTION_MATERIAL_SOURCES     = 10,
+};
+
+// Conteúdo de SECTION_VERTEX_FORMAT, com os parâmetros de MeshData.
+struct MeshCacheVertexFormat
+{
+    uint32_t vertex_format;
+    uint32_t has_normals;
+    uint32_t has_texcoords;
+    uint32_t index_size;
+    float    position_offset[3];
+    float    position_scale[3];
+};
+
+struct MeshCacheHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t num_sections;
+    uint64_t path_hash;    // FNV-1a do caminho do ".obj"
+    uint64_t source_size;  // Tamanho do ".obj" em bytes
+    int64_t  source_mtime; // Data de modificação do ".obj"
+};
+
+// Um ".mtl" citado pelo ".obj", gravado em SECTION_MATERIAL_SOURCES como o
+// caminho (string) seguido destes campos. Um arquivo que não existia ao
+// gravar o cache tem tamanho MISSING_SOURCE_SIZE.
+struct MeshCacheSourceStamp
+{
+    uint64_t size;
+    int64_t  mtime;
+};
+
+const uint64_t MISSING_SOURCE_SIZE = UINT64_MAX;
+
+struct MeshCacheSection
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+uint64_t HashPath(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        hash ^= (unsigned char)path[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool StatSource(const std::string& filename, uint64_t* size, int64_t* mtime)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return false;
+    *size  = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+MeshCacheSourceStamp StampSource(const std::string& filename)
+{
+    MeshCacheSourceStamp stamp;
+    if (!StatSource(filename, &stamp.size, &stamp.mtime))
+    {
+        stamp.size  = MISSING_SOURCE_SIZE;
+        stamp.mtime = 0;
+    }
+    return stamp;
+}
+
+// Caminhos dos ".mtl" citados nas linhas "mtllib" do ".obj", relativos ao
+// diretório dele (como o construtor de ObjModel os procura). Só é chamada ao
+// gravar o cache, logo depois de o ".obj" ter sido lido.
+void ListMaterialLibraries(const std::string& obj_filename, std::vector<std::string>* filenames)
+{
+    std::string dirname;
+    size_t slash = obj_filename.find_last_of("/");
+    if (slash != std::string::npos)
+        dirname = obj_filename.substr(0, slash + 1);
+
+    std::ifstream file(obj_filename.c_str());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword, name;
+        if (!(tokens >> keyword) || keyword != "mtllib")
+            continue;
+        while (tokens >> name)
+            filenames->push_back(dirname + name);
+    }
+}
+
+// Escrita sequencial de valores e strings em um buffer de bytes.
+struct Writer
+{
+    std::vector<unsigned char> bytes;
+
+    void Put(const void* p, size_t n)
+    {
+        const unsigned char* b = (const unsigned char*)p;
+        bytes.insert(bytes.end(), b, b + n);
+    }
+    template <typename T> void Put(const T& value) { Put(&value, sizeof(T)); }
+    void PutString(const std::string& s)
+    {
+        Put((uint32_t)s.size());
+        Put(s.data(), s.size());
+    }
+};
+
+// Leitura sequencial com verificação de limites.
+struct Reader
+{
+    const unsigned char* p;
+    const unsigned char* end;
+
+    bool Get(void* out, size_t n)
+    {
+        if ((size_t)(end - p) < n)
+            return false;
+        memcpy(out, p, n);
+        p += n;
+        return true;
+    }
+    template <typename T> bool Get(T* value) { return Get(value, sizeof(T)); }
+    bool GetString(std::string* s)
+    {
+        uint32_t n;
+        if (!Get(&n) || (size_t)(end - p) < n)
+            return false;
+        s->assign((const char*)p, n);
+        p += n;
+        return true;
+    }
+};
+
+void PutMaterial(Writer& w, const tinyobj::material_t& m)
+{
+    w.PutString(m.name);
+    w.Put(m.ambient);
+    w.Put(m.diffuse);
+    w.Put(m.specular);
+    w.Put(m.transmittance);
+    w.Put(m.emission);
+    w.Put(m.shininess);
+    w.Put(m.ior);
+    w.Put(m.dissolve);
+    w.Put((int32_t)m.illum);
+    w.PutString(m.ambient_texname);
+    w.PutString(m.diffuse_texname);
+    w.PutString(m.specular_texname);
+    w.PutString(m.specular_highlight_texname);
+    w.PutString(m.bump_texname);
+    w.PutString(m.displacement_texname);
+    w.PutString(m.alpha_texname);
+}
+
+bool GetMaterial(Reader& r, tinyobj::material_t* m)
+{
+    int32_t illum = 0;
+    bool ok = r.GetString(&m->name)
+        && r.Get(&m->ambient)
+        && r.Get(&m->diffuse)
+        && r.Get(&m->specular)
+        && r.Get(&m->transmittance)
+        && r.Get(&m->emission)
+        && r.Get(&m->shininess)
+        && r.Get(&m->ior)
+        && r.Get(&m->dissolve)
+        && r.Get(&illum)
+        && r.GetString(&m->ambient_texname)
+        && r.GetString(&m->diffuse_texname)
+        && r.GetString(&m->specular_texname)
+        && r.GetString(&m->specular_highlight_texname)
+        && r.GetString(&m->bump_texname)
+        && r.GetString(&m->displacement_texname)
+        && r.GetString(&m->alpha_texname);
+    m->illum = illum;
+    return ok;
+}
+
+} // namespace
+
+std::string MeshCacheFilename(const std::string& obj_filename)
+{
+    return obj_filename + ".meshcache";
+}
+
+// Tenta carregar o modelo do cache. Retorna false (sem alterar o modelo) se o
+// cache não existir, estiver desatualizado, corrompido ou em um formato de
+// vértice diferente de model->vertex_format.
+bool LoadMeshCache(ObjModel* model)
+{
+    uint64_t source_size;
+    int64_t  source_mtime;
+    if (!StatSource(model->filename, &source_size, &source_mtime))
+        return false;
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    if (!file->Open(MeshCacheFilename(model->filename).c_str()))
+        return false;
+
+    const unsigned char* base = file->Data();
+    const size_t         size = file->Size();
+
+    MeshCacheHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, base, sizeof(header));
+
+    if (memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0
+        || header.version != MESH_CACHE_VERSION
+        || header.byte_order != MESH_CACHE_BYTE_ORDER
+        || header.path_hash != HashPath(model->filename)
+        || header.source_size != source_size
+        || header.source_mtime != source_mtime)
+        return false;
+
+    if (header.num_sections > (size - sizeof(header)) / sizeof(MeshCacheSection))
+        return false;
+
+    MeshData mesh;
+    bool has_format = false;
+    bool has_material_sources = false;
+    std::vector<tinyobj::material_t> materials;
+    BoundingBox bbox;
+    std::vector<BoundingBox> shape_bboxes;
+
+    const MeshCacheSection* sections = (const MeshCacheSection*)(base + sizeof(header));
+    for (uint32_t i = 0; i < header.num_sections; ++i)
+    {
+        const MeshCacheSection& section = sections[i];
+        if (section.offset > size || section.size > size - section.offset)
+            return false;
+
+        const unsigned char* data = base + section.offset;
+        Reader reader = { data, data + section.size };
+
+        switch (section.type)
+        {
+        case SECTION_VERTICES: mesh.vertices.Map(data, section.size); break;
+        case SECTION_INDICES:  mesh.indices.Map(data, section.size); break;
+        case SECTION_VERTEX_FORMAT:
+        {
+            MeshCacheVertexFormat format;
+            if (!reader.Get(&format))
+                return false;
+            if (format.vertex_format != (uint32_t)model->vertex_format
+                || (format.index_size != 2 && format.index_size != 4))
+                return false;
+            mesh.vertex_format = (VertexFormat)format.vertex_format;
+            mesh.has_normals   = format.has_normals != 0;
+            mesh.has_texcoords = format.has_texcoords != 0;
+            mesh.index_size    = format.index_size;
+            memcpy(mesh.position_offset, format.position_offset, sizeof(mesh.position_offset));
+            memcpy(mesh.position_scale, format.position_scale, sizeof(mesh.position_scale));
+            has_format = true;
+            break;
+        }
+        case SECTION_SHAPES:
+        {
+            uint32_t count;
+            if (!reader.Get(&count))
+                return false;
+            for (uint32_t s = 0; s < count; ++s)
+            {
+                MeshShape shape;
+                int32_t material_id;
+                uint32_t num_lods, num_meshlets;
+                if (!reader.GetString(&shape.name) || !reader.Get(&shape.first_index)
+                    || !reader.Get(&shape.num_indices) || !reader.Get(&material_id)
+                    || !reader.Get(&num_lods) || num_lods > (size_t)(reader.end - reader.p) / sizeof(MeshLod))
+                    return false;
+                shape.material_id = material_id;
+                shape.lods.resize(num_lods);
+                for (uint32_t l = 0; l < num_lods; ++l)
+                    if (!reader.Get(&shape.lods[l]))
+                        return false;
+                if (!reader.Get(&num_meshlets) || num_meshlets > (size_t)(reader.end - reader.p) / sizeof(Meshlet))
+                    return false;
+                shape.meshlets.resize(num_meshlets);
+                for (uint32_t m = 0; m < num_meshlets; ++m)
+                    if (!reader.Get(&shape.meshlets[m]))
+                        return false;
+                mesh.shapes.push_back(shape);
+            }
+            break;
+        }
+        case SECTION_MATERIALS:
+        {
+            uint32_t count;
+            if (!reader.Get(&count))
+                return false;
+            materials.resize(count);
+            for (uint32_t m = 0; m < count; ++m)
+                if (!GetMaterial(reader, &materials[m]))
+                    return false;
+            break;
+        }
+        case SECTION_MATERIAL_SOURCES:
+        {
+            // Um ".mtl" alterado muda os materiais guardados no cache.
+            uint32_t count;
+            if (!reader.Get(&count))
+                return false;
+            for (uint32_t m = 0; m < count; ++m)
+            {
+                std::string filename;
+                MeshCacheSourceStamp stamp;
+                if (!reader.GetString(&filename) || !reader.Get(&stamp))
+                    return false;
+                MeshCacheSourceStamp current = StampSource(filename);
+                if (current.size != stamp.size || current.mtime != stamp.mtime)
+                    return false;
+            }
+            has_material_sources = true;
+            break;
+        }
+        case SECTION_BOUNDS:
+        {
+            uint32_t count;
+            if (!reader.Get(&bbox) || !reader.Get(&count))
+                return false;
+            shape_bboxes.resize(count);
+            for (uint32_t b = 0; b < count; ++b)
+                if (!reader.Get(&shape_bboxes[b]))
+                    return false;
+            break;
+        }
+        default:
+            break; // Seções desconhecidas são ignoradas
+        }
+    }
+
+    if (!has_format || !has_material_sources || mesh.Empty() || mesh.vertices.Empty() || mesh.indices.Empty()
+        || shape_bboxes.size() != mesh.shapes.size())
+        return false;
+
+    // Confere se os intervalos dos shapes cabem no fluxo de índices e se os
+    // índices cabem no fluxo de vértices.
+    size_t num_indices = mesh.NumIndices();
+    for (size_t s = 0; s < mesh.shapes.size(); ++s)
+    {
+        if ((size_t)mesh.shapes[s].first_index + mesh.shapes[s].num_indices > num_indices)
+            return false;
+        for (size_t l = 0; l < mesh.shapes[s].lods.size(); ++l)
+            if ((size_t)mesh.shapes[s].lods[l].first_index + mesh.shapes[s].lods[l].num_indices > num_indices)
+                return false;
+        for (size_t m = 0; m < mesh.shapes[s].meshlets.size(); ++m)
+            if ((size_t)mesh.shapes[s].meshlets[m].first_index + mesh.shapes[s].meshlets[m].num_indices > num_indices)
+                return false;
+    }
+
+    size_t num_vertices = mesh.NumVertices();
+    if (mesh.vertices.Size() != num_vertices * VertexFormatStride(mesh.vertex_format)
+        || mesh.indices.Size() != num_indices * mesh.index_size)
+        return false;
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        uint32_t index;
+        if (mesh.index_size == 2)
+            index = ((const uint16_t*)mesh.indices.Data())[i];
+        else
+            index = ((const uint32_t*)mesh.indices.Data())[i];
+        if (index >= num_vertices)
+            return false;
+    }
+
+    mesh.mapping = file;
+    model->mesh = mesh;
+    model->materials.swap(materials);
+    model->bbox = bbox;
+    model->shape_bboxes.swap(shape_bboxes);
+    return true;
+}
+
+// Grava o cache de um modelo cuja malha já foi construída. O arquivo é escrito
+// com outro nome e renomeado no final, para que uma execução interrompida não
+// deixe um cache pela metade.
+bool SaveMeshCache(const ObjModel& model)
+{
+    const MeshData& mesh = model.mesh;
+
+    MeshCacheHeader header;
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version    = MESH_CACHE_VERSION;
+    header.byte_order = MESH_CACHE_BYTE_ORDER;
+    header.path_hash  = HashPath(model.filename);
+    if (!StatSource(model.filename, &header.source_size, &header.source_mtime))
+        return false;
+
+    MeshCacheVertexFormat format;
+    format.vertex_format = (uint32_t)mesh.vertex_format;
+    format.has_normals   = mesh.has_normals ? 1 : 0;
+    format.has_texcoords = mesh.has_texcoords ? 1 : 0;
+    format.index_size    = mesh.index_size;
+    memcpy(format.position_offset, mesh.position_offset, sizeof(format.position_offset));
+    memcpy(format.position_scale, mesh.position_scale, sizeof(format.position_scale));
+
+    Writer shapes;
+    shapes.Put((uint32_t)mesh.shapes.size());
+    for (size_t s = 0; s < mesh.shapes.size(); ++s)
+    {
+        shapes.PutString(mesh.shapes[s].name);
+        shapes.Put(mesh.shapes[s].first_index);
+        shapes.Put(mesh.shapes[s].num_indices);
+        shapes.Put((int32_t)mesh.shapes[s].material_id);
+        shapes.Put((uint32_t)mesh.shapes[s].lods.size());
+        for (size_t l = 0; l < mesh.shapes[s].lods.size(); ++l)
+            shapes.Put(mesh.shapes[s].lods[l]);
+        shapes.Put((uint32_t)mesh.shapes[s].meshlets.size());
+        for (size_t m = 0; m < mesh.shapes[s].meshlets.size(); ++m)
+            shapes.Put(mesh.shapes[s].meshlets[m]);
+    }
+
+    Writer materials;
+    materials.Put((uint32_t)model.materials.size());
+    for (size_t m = 0; m < model.materials.size(); ++m)
+        PutMaterial(materials, model.materials[m]);
+
+    std::vector<std::string> material_filenames;
+    ListMaterialLibraries(model.filename, &material_filenames);
+    Writer material_sources;
+    material_sources.Put((uint32_t)material_filenames.size());
+    for (size_t m = 0; m < material_filenames.size(); ++m)
+    {
+        material_sources.PutString(material_filenames[m]);
+        material_sources.Put(StampSource(material_filenames[m]));
+    }
+
+    Writer bounds;
+    bounds.Put(model.bbox);
+    bounds.Put((uint32_t)model.shape_bboxes.size());
+    for (size_t b = 0; b < model.shape_bboxes.size(); ++b)
+        bounds.Put(model.shape_bboxes[b]);
+
+    struct { uint32_t type; const void* data; size_t size; } contents[] = {
+        { SECTION_VERTEX_FORMAT,        &format,                          sizeof(format) },
+        { SECTION_VERTICES,             mesh.vertices.Data(),             mesh.vertices.Size() },
+        { SECTION_INDICES,              mesh.indices.Data(),              mesh.indices.Size() },
+        { SECTION_SHAPES,               shapes.bytes.data(),              shapes.bytes.size() },
+        { SECTION_MATERIALS,            materials.bytes.data(),           materials.bytes.size() },
+        { SECTION_MATERIAL_SOURCES,     material_sources.bytes.data(),    material_sources.bytes.size() },
+        { SECTION_BOUNDS,               bounds.bytes.data(),              bounds.bytes.size() },
+    };
+    const uint32_t num_sections = sizeof(contents) / sizeof(contents[0]);
+    header.num_sections = num_sections;
+
+    std::vector<MeshCacheSection> sections(num_sections);
+    uint64_t offset = sizeof(header) + num_sections * sizeof(MeshCacheSection);
+    for (uint32_t i = 0; i < num_sections; ++i)
+    {
+        offset = (offset + 15) & ~(uint64_t)15;
+        sections[i].type     = contents[i].type;
+        sections[i].reserved = 0;
+        sections[i].offset   = offset;
+        sections[i].size     = contents[i].size;
+        offset += contents[i].size;
+    }
+
+    std::string filename = MeshCacheFilename(model.filename);
+    std::string tmp_filename = filename + ".tmp";
+
+    FILE* f = fopen(tmp_filename.c_str(), "wb");
+    if (f == NULL)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+           && fwrite(sections.data(), sizeof(MeshCacheSection), num_sections, f) == num_sections;
+
+    static const unsigned char zeros[16] = { 0 };
+    uint64_t written = sizeof(header) + num_sections * sizeof(MeshCacheSection);
+    for (uint32_t i = 0; ok && i < num_sections; ++i)
+    {
+        size_t padding = (size_t)(sections[i].offset - written);
+        ok = fwrite(zeros, 1, padding, f) == padding
+          && fwrite(contents[i].data, 1, contents[i].size, f) == contents[i].size;
+        written = sections[i].offset + sections[i].size;
+    }
+
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok)
+    {
+        remove(filename.c_str()); // rename() falha no Windows se o destino existir
+        ok = rename(tmp_filename.c_str(), filename.c_str()) == 0;
+    }
+    if (!ok)
+    {
+        remove(tmp_filename.c_str());
+        fprintf(stderr, "WARNING: Cannot write mesh cache \"%s\".\n", filename.c_str());
+    }
+    return ok;
+}
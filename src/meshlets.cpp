@@ -0,0 +1,281 @@
+#include "meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "meshoptimizer.h"
+
+namespace {
+
+// Peso do desvio da normal (1 - cosseno) em relação a um vértice novo na
+// escolha do próximo triângulo de um meshlet.
+const float CONE_WEIGHT = 0.25f;
+
+const float* Position(const float* positions, size_t position_stride, uint32_t vertex)
+{
+    return (const float*)((const char*)positions + vertex * position_stride);
+}
+
+float Distance(const float* a, const float* b)
+{
+    float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+    return std::sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+// Esfera envolvente de um conjunto de pontos pelo algoritmo de Ritter: parte
+// do par de pontos extremos mais distante entre os três eixos e aumenta a
+// esfera a cada ponto que ficar de fora.
+void ComputeBoundingSphere(Meshlet* meshlet, const std::vector<uint32_t>& vertices,
+                           const float* positions, size_t position_stride)
+{
+    const float* minimum[3];
+    const float* maximum[3];
+    for (int axis = 0; axis < 3; ++axis)
+        minimum[axis] = maximum[axis] = Position(positions, position_stride, vertices[0]);
+
+    for (size_t v = 1; v < vertices.size(); ++v)
+    {
+        const float* p = Position(positions, position_stride, vertices[v]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (p[axis] < minimum[axis][axis]) minimum[axis] = p;
+            if (p[axis] > maximum[axis][axis]) maximum[axis] = p;
+        }
+    }
+
+    int widest = 0;
+    for (int axis = 1; axis < 3; ++axis)
+        if (Distance(minimum[axis], maximum[axis]) > Distance(minimum[widest], maximum[widest]))
+            widest = axis;
+
+    float center[3];
+    for (int k = 0; k < 3; ++k)
+        center[k] = 0.5f * (minimum[widest][k] + maximum[widest][k]);
+    float radius = 0.5f * Distance(minimum[widest], maximum[widest]);
+
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        const float* p = Position(positions, position_stride, vertices[v]);
+        float distance = Distance(p, center);
+        if (distance > radius)
+        {
+            // Nova esfera: tangente à antiga do lado oposto e passando por p.
+            float shift = 0.5f * (distance - radius);
+            for (int k = 0; k < 3; ++k)
+                center[k] += shift * (p[k] - center[k]) / distance;
+            radius = 0.5f * (radius + distance);
+        }
+    }
+
+    memcpy(meshlet->center, center, sizeof(center));
+    meshlet->radius = radius;
+}
+
+// Normal geométrica unitária de um triângulo (anti-horário visto de frente).
+// Retorna false, com normal zero, para triângulos degenerados.
+bool TriangleNormal(float* normal, const uint32_t* triangle, const float* positions, size_t position_stride)
+{
+    const float* a = Position(positions, position_stride, triangle[0]);
+    const float* b = Position(positions, position_stride, triangle[1]);
+    const float* c = Position(positions, position_stride, triangle[2]);
+
+    float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float w[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    float n[3] = {u[1]*w[2] - u[2]*w[1], u[2]*w[0] - u[0]*w[2], u[0]*w[1] - u[1]*w[0]};
+    float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+    for (int k = 0; k < 3; ++k)
+        normal[k] = length > 0.0f ? n[k] / length : 0.0f;
+    return length > 0.0f;
+}
+
+// Cone que contém as normais (geométricas) de todos os triângulos do meshlet.
+void ComputeNormalCone(Meshlet* meshlet, const uint32_t* indices,
+                       const float* positions, size_t position_stride)
+{
+    size_t triangle_count = meshlet->num_indices / 3;
+    std::vector<float> normals(3 * triangle_count);
+    size_t valid = 0;
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+
+    for (size_t t = 0; t < triangle_count; ++t)
+    {
+        // Triângulos degenerados não têm orientação e não restringem o cone.
+        if (!TriangleNormal(&normals[3*valid], indices + 3*t, positions, position_stride))
+            continue;
+
+        for (int k = 0; k < 3; ++k)
+            axis[k] += normals[3*valid + k];
+        ++valid;
+    }
+
+    float length = std::sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+    if (valid == 0 || length < 1e-6f)
+    {
+        meshlet->cone_axis[0] = meshlet->cone_axis[1] = 0.0f;
+        meshlet->cone_axis[2] = 1.0f;
+        meshlet->cone_cutoff = 1.0f;
+        return;
+    }
+
+    for (int k = 0; k < 3; ++k)
+        axis[k] /= length;
+
+    float minimum_dot = 1.0f;
+    for (size_t t = 0; t < valid; ++t)
+        minimum_dot = std::min(minimum_dot, axis[0]*normals[3*t] + axis[1]*normals[3*t+1] + axis[2]*normals[3*t+2]);
+
+    memcpy(meshlet->cone_axis, axis, sizeof(axis));
+
+    // Com semiângulo perto de 90 graus o teste nunca descartaria nada.
+    meshlet->cone_cutoff = minimum_dot <= 0.1f ? 1.0f : std::sqrt(1.0f - minimum_dot * minimum_dot);
+}
+
+} // namespace
+
+void BuildMeshlets(std::vector<Meshlet>* meshlets, uint32_t* indices, size_t index_count, size_t vertex_count,
+                   const float* positions, size_t position_stride)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    // Triângulos que usam cada vértice, e quantos deles ainda não foram
+    // colocados em algum meshlet.
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t i = 0; i < index_count; ++i)
+        live[indices[i]]++;
+
+    std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v)
+        adjacency_offset[v + 1] = adjacency_offset[v] + live[v];
+
+    std::vector<uint32_t> adjacency(index_count);
+    std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+    for (size_t i = 0; i < index_count; ++i)
+        adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+    // Normais unitárias dos triângulos (zero nos degenerados).
+    std::vector<float> triangle_normals(3 * triangle_count, 0.0f);
+    for (size_t t = 0; t < triangle_count; ++t)
+        TriangleNormal(&triangle_normals[3*t], indices + 3*t, positions, position_stride);
+
+    std::vector<char>     emitted(triangle_count, 0);
+    std::vector<uint32_t> owner(vertex_count, UINT32_MAX); // Meshlet que já contém o vértice
+    std::vector<uint32_t> result;
+    result.reserve(index_count);
+
+    std::vector<uint32_t> meshlet_vertices;
+    std::vector<uint32_t> local_index(vertex_count); // Posição do vértice em meshlet_vertices
+    size_t seed = 0;
+    uint32_t meshlet_id = 0;
+
+    while (result.size() < index_count)
+    {
+        // Começa um meshlet pelo primeiro triângulo livre na ordem original,
+        // que já foi otimizada para o cache e por isso tem boa localidade.
+        while (emitted[seed])
+            ++seed;
+
+        size_t first = result.size();
+        meshlet_vertices.clear();
+
+        size_t triangle = seed;
+        size_t triangles = 0;
+        float normal_sum[3] = {0.0f, 0.0f, 0.0f};
+        while (true)
+        {
+            emitted[triangle] = 1;
+            for (int k = 0; k < 3; ++k)
+                normal_sum[k] += triangle_normals[3*triangle + k];
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t v = indices[3*triangle + k];
+                live[v]--;
+                if (owner[v] != meshlet_id)
+                {
+                    owner[v] = meshlet_id;
+                    meshlet_vertices.push_back(v);
+                }
+                result.push_back(v);
+            }
+            if (++triangles == MESHLET_MAX_TRIANGLES)
+                break;
+
+            // Próximo triângulo: o vizinho que acrescenta menos vértices novos,
+            // penalizando os que se desviam da normal média do meshlet (cones
+            // mais estreitos descartam mais) e, no empate, o que termina o
+            // leque de algum vértice, deixando menos vértices repetidos entre
+            // meshlets.
+            float average[3] = {normal_sum[0], normal_sum[1], normal_sum[2]};
+            float length = std::sqrt(average[0]*average[0] + average[1]*average[1] + average[2]*average[2]);
+            if (length > 0.0f)
+                for (int k = 0; k < 3; ++k)
+                    average[k] /= length;
+
+            size_t   best = triangle_count;
+            float    best_score = std::numeric_limits<float>::max();
+            uint32_t best_live = UINT32_MAX;
+            for (size_t m = 0; m < meshlet_vertices.size(); ++m)
+            {
+                uint32_t v = meshlet_vertices[m];
+                for (uint32_t a = adjacency_offset[v]; a < adjacency_offset[v + 1]; ++a)
+                {
+                    uint32_t candidate = adjacency[a];
+                    if (emitted[candidate])
+                        continue;
+
+                    unsigned extra = 0;
+                    uint32_t minimum_live = UINT32_MAX;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        uint32_t w = indices[3*candidate + k];
+                        extra += owner[w] != meshlet_id;
+                        minimum_live = std::min(minimum_live, live[w]);
+                    }
+                    if (meshlet_vertices.size() + extra > MESHLET_MAX_VERTICES)
+                        continue;
+
+                    const float* n = &triangle_normals[3*candidate];
+                    float spread = 1.0f - (n[0]*average[0] + n[1]*average[1] + n[2]*average[2]);
+                    float score = extra + CONE_WEIGHT * spread;
+
+                    if (score < best_score || (score == best_score && minimum_live < best_live))
+                    {
+                        best = candidate;
+                        best_score = score;
+                        best_live = minimum_live;
+                    }
+                }
+            }
+
+            if (best == triangle_count)
+                break;
+            triangle = best;
+        }
+
+        Meshlet meshlet;
+        meshlet.first_index = (uint32_t)first;
+        meshlet.num_indices = (uint32_t)(result.size() - first);
+
+        // Otimiza com os vértices do meshlet numerados 0..n-1 (n <= 64), para
+        // não alocar vetores do tamanho da malha a cada meshlet.
+        uint32_t* meshlet_indices = result.data() + first;
+        for (size_t m = 0; m < meshlet_vertices.size(); ++m)
+            local_index[meshlet_vertices[m]] = (uint32_t)m;
+        for (size_t i = 0; i < meshlet.num_indices; ++i)
+            meshlet_indices[i] = local_index[meshlet_indices[i]];
+        OptimizeVertexCache(meshlet_indices, meshlet.num_indices, meshlet_vertices.size());
+        for (size_t i = 0; i < meshlet.num_indices; ++i)
+            meshlet_indices[i] = meshlet_vertices[meshlet_indices[i]];
+
+        ComputeBoundingSphere(&meshlet, meshlet_vertices, positions, position_stride);
+        ComputeNormalCone(&meshlet, result.data() + first, positions, position_stride);
+
+        meshlets->push_back(meshlet);
+        ++meshlet_id;
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
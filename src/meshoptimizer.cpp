@@ -0,0 +1,396 @@
+#include "meshoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Parâmetros do algoritmo de Forsyth.
+const int   FORSYTH_CACHE_SIZE       = 32;
+const float FORSYTH_DECAY_POWER      = 1.5f;
+const float FORSYTH_LAST_TRI_SCORE   = 0.75f;
+const float FORSYTH_VALENCE_SCALE    = 2.0f;
+const float FORSYTH_VALENCE_POWER    = 0.5f;
+
+// Cache FIFO usado nas simulações de AnalyzeVertexCache() e OptimizeOverdraw().
+const unsigned SIMULATED_CACHE_SIZE = 16;
+
+float ForsythVertexScore(int cache_position, unsigned remaining_triangles)
+{
+    if (remaining_triangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        if (cache_position < 3)
+            score = FORSYTH_LAST_TRI_SCORE;
+        else
+        {
+            const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cache_position - 3) * scaler, FORSYTH_DECAY_POWER);
+        }
+    }
+
+    score += FORSYTH_VALENCE_SCALE * std::pow((float)remaining_triangles, -FORSYTH_VALENCE_POWER);
+    return score;
+}
+
+// Simulação de um cache FIFO: um vértice é transformado quando não foi
+// transformado nas últimas "cache_size" transformações.
+struct FifoCache
+{
+    std::vector<size_t> timestamp; // Momento em que cada vértice entrou no cache
+    size_t              time;
+    unsigned            cache_size;
+
+    FifoCache(size_t vertex_count, unsigned cache_size)
+        : timestamp(vertex_count, 0), time(cache_size + 1), cache_size(cache_size) {}
+
+    // Retorna 1 se o vértice precisou ser transformado.
+    unsigned Access(uint32_t vertex)
+    {
+        if (time - timestamp[vertex] > cache_size)
+        {
+            timestamp[vertex] = time++;
+            return 1;
+        }
+        return 0;
+    }
+
+    void Reset()
+    {
+        time += cache_size + 1;
+    }
+};
+
+} // namespace
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+                                         unsigned cache_size)
+{
+    FifoCache cache(vertex_count, cache_size);
+    std::vector<char> used(vertex_count, 0);
+    size_t unique = 0;
+
+    VertexCacheStatistics stats;
+    stats.vertices_transformed = 0;
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        stats.vertices_transformed += cache.Access(indices[i]);
+        if (!used[indices[i]])
+        {
+            used[indices[i]] = 1;
+            ++unique;
+        }
+    }
+
+    size_t triangles = index_count / 3;
+    stats.acmr = triangles > 0 ? (float)stats.vertices_transformed / triangles : 0.0f;
+    stats.atvr = unique > 0 ? (float)stats.vertices_transformed / unique : 0.0f;
+    return stats;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+    const size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    // Lista de triângulos de cada vértice (formato CSR).
+    std::vector<unsigned> valence(vertex_count, 0);
+    for (size_t i = 0; i < index_count; ++i)
+        ++valence[indices[i]];
+
+    std::vector<size_t> adjacency_offset(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v)
+        adjacency_offset[v + 1] = adjacency_offset[v] + valence[v];
+
+    std::vector<uint32_t> adjacency(index_count);
+    std::vector<unsigned> remaining(vertex_count, 0); // Triângulos ainda não emitidos de cada vértice
+    for (size_t t = 0; t < triangle_count; ++t)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = indices[3*t + k];
+            adjacency[adjacency_offset[v] + remaining[v]++] = (uint32_t)t;
+        }
+    }
+
+    std::vector<int>   cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        vertex_score[v] = ForsythVertexScore(-1, remaining[v]);
+
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<char>  emitted(triangle_count, 0);
+    for (size_t t = 0; t < triangle_count; ++t)
+        triangle_score[t] = vertex_score[indices[3*t]] + vertex_score[indices[3*t+1]] + vertex_score[indices[3*t+2]];
+
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+
+    // Cache LRU com espaço para os 3 vértices novos de um triângulo.
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    int cache_count = 0;
+
+    size_t next_unemitted = 0;
+    long best_triangle = 0;
+    {
+        float best_score = -1.0f;
+        for (size_t t = 0; t < triangle_count; ++t)
+            if (triangle_score[t] > best_score)
+            {
+                best_score = triangle_score[t];
+                best_triangle = (long)t;
+            }
+    }
+
+    while (best_triangle >= 0)
+    {
+        // Emite o triângulo e atualiza o cache (os vértices dele vão para a frente).
+        emitted[best_triangle] = 1;
+        uint32_t triangle[3] = { indices[3*best_triangle], indices[3*best_triangle+1], indices[3*best_triangle+2] };
+        output.insert(output.end(), triangle, triangle + 3);
+
+        uint32_t new_cache[FORSYTH_CACHE_SIZE + 3];
+        int new_count = 0;
+        for (int k = 0; k < 3; ++k)
+            new_cache[new_count++] = triangle[k];
+        for (int c = 0; c < cache_count; ++c)
+        {
+            uint32_t v = cache[c];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                new_cache[new_count++] = v;
+        }
+
+        // Remove o triângulo das listas de adjacência dos seus vértices.
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = triangle[k];
+            uint32_t* list = &adjacency[adjacency_offset[v]];
+            for (unsigned a = 0; a < remaining[v]; ++a)
+            {
+                if (list[a] == (uint32_t)best_triangle)
+                {
+                    list[a] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            --remaining[v];
+        }
+
+        // Atualiza as pontuações dos vértices que estão (ou estavam) no cache
+        // e dos triângulos que os usam, escolhendo o melhor candidato.
+        for (int c = FORSYTH_CACHE_SIZE; c < new_count; ++c)
+            cache_position[new_cache[c]] = -1; // Saiu do cache
+
+        cache_count = std::min(new_count, FORSYTH_CACHE_SIZE);
+        memcpy(cache, new_cache, cache_count * sizeof(uint32_t));
+
+        best_triangle = -1;
+        float best_score = -1.0f;
+        for (int c = 0; c < new_count; ++c)
+        {
+            uint32_t v = new_cache[c];
+            if (c < FORSYTH_CACHE_SIZE)
+                cache_position[v] = c;
+
+            float score = ForsythVertexScore(cache_position[v], remaining[v]);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+
+            const uint32_t* list = &adjacency[adjacency_offset[v]];
+            for (unsigned a = 0; a < remaining[v]; ++a)
+            {
+                uint32_t t = list[a];
+                triangle_score[t] += delta;
+                if (c < FORSYTH_CACHE_SIZE && triangle_score[t] > best_score)
+                {
+                    best_score = triangle_score[t];
+                    best_triangle = (long)t;
+                }
+            }
+        }
+
+        // Nenhum triângulo usa vértices do cache: recomeça pelo próximo
+        // triângulo ainda não emitido.
+        if (best_triangle < 0)
+        {
+            while (next_unemitted < triangle_count && emitted[next_unemitted])
+                ++next_unemitted;
+            if (next_unemitted < triangle_count)
+                best_triangle = (long)next_unemitted;
+        }
+    }
+
+    memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t index_count, size_t vertex_count,
+                      const float* positions, size_t position_stride, float threshold)
+{
+    const size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    // Fronteiras "duras": triângulos em que os 3 vértices são transformados,
+    // isto é, onde a ordem otimizada para o cache recomeça em outra região.
+    FifoCache cache(vertex_count, SIMULATED_CACHE_SIZE);
+    std::vector<unsigned> misses(triangle_count);
+    std::vector<size_t> hard_boundaries;
+    for (size_t t = 0; t < triangle_count; ++t)
+    {
+        misses[t] = cache.Access(indices[3*t]) + cache.Access(indices[3*t+1]) + cache.Access(indices[3*t+2]);
+        if (t == 0 || misses[t] == 3)
+            hard_boundaries.push_back(t);
+    }
+    hard_boundaries.push_back(triangle_count);
+
+    // Fronteiras "suaves": dentro de cada grupo, corta assim que o ACMR
+    // acumulado desde o último corte fica dentro de "threshold" do ACMR do
+    // grupo inteiro. Grupos menores dão mais liberdade para a ordenação.
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hard_boundaries.size(); ++h)
+    {
+        size_t start = hard_boundaries[h];
+        size_t end   = hard_boundaries[h + 1];
+
+        unsigned cluster_misses = 0;
+        for (size_t t = start; t < end; ++t)
+            cluster_misses += misses[t];
+        float cluster_threshold = threshold * (float)cluster_misses / (float)(end - start);
+
+        clusters.push_back(start);
+        cache.Reset();
+        unsigned running_misses = 0;
+        size_t running_start = start;
+        for (size_t t = start; t < end; ++t)
+        {
+            running_misses += cache.Access(indices[3*t]) + cache.Access(indices[3*t+1]) + cache.Access(indices[3*t+2]);
+            if (t + 1 < end && (float)running_misses / (float)(t + 1 - running_start) <= cluster_threshold)
+            {
+                clusters.push_back(t + 1);
+                cache.Reset();
+                running_misses = 0;
+                running_start = t + 1;
+            }
+        }
+    }
+    clusters.push_back(triangle_count);
+
+    // Centróide da malha, ponderado pela área dos triângulos.
+    const unsigned char* base = (const unsigned char*)positions;
+    struct Triangle { float centroid[3]; float normal[3]; float area; };
+    std::vector<Triangle> triangles(triangle_count);
+    float mesh_centroid[3] = { 0.0f, 0.0f, 0.0f };
+    float mesh_area = 0.0f;
+    for (size_t t = 0; t < triangle_count; ++t)
+    {
+        const float* a = (const float*)(base + indices[3*t+0] * position_stride);
+        const float* b = (const float*)(base + indices[3*t+1] * position_stride);
+        const float* c = (const float*)(base + indices[3*t+2] * position_stride);
+
+        float e1[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+        float e2[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+        float n[3] = { e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0] };
+        float area = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+        Triangle& tri = triangles[t];
+        for (int i = 0; i < 3; ++i)
+        {
+            tri.centroid[i] = (a[i] + b[i] + c[i]) / 3.0f;
+            tri.normal[i]   = n[i]; // Comprimento proporcional à área
+            mesh_centroid[i] += tri.centroid[i] * area;
+        }
+        tri.area = area;
+        mesh_area += area;
+    }
+    for (int i = 0; i < 3; ++i)
+        mesh_centroid[i] = mesh_area > 0.0f ? mesh_centroid[i] / mesh_area : 0.0f;
+
+    // Chave de cada grupo: quanto ele está "para fora" da malha na direção da
+    // sua normal média. Grupos externos são desenhados primeiro e ocultam os
+    // internos.
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<float>  sort_key(cluster_count);
+    std::vector<size_t> order(cluster_count);
+    for (size_t k = 0; k < cluster_count; ++k)
+    {
+        float centroid[3] = { 0.0f, 0.0f, 0.0f }, normal[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (size_t t = clusters[k]; t < clusters[k + 1]; ++t)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                centroid[i] += triangles[t].centroid[i] * triangles[t].area;
+                normal[i]   += triangles[t].normal[i];
+            }
+            area += triangles[t].area;
+        }
+        float inv_area = area > 0.0f ? 1.0f / area : 0.0f;
+        float normal_length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+        float inv_normal = normal_length > 0.0f ? 1.0f / normal_length : 0.0f;
+
+        float key = 0.0f;
+        for (int i = 0; i < 3; ++i)
+            key += (centroid[i] * inv_area - mesh_centroid[i]) * normal[i] * inv_normal;
+        sort_key[k] = key;
+        order[k] = k;
+    }
+
+    std::stable_sort(order.begin(), order.end(),
+                     [&sort_key](size_t a, size_t b) { return sort_key[a] > sort_key[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+    for (size_t k = 0; k < cluster_count; ++k)
+    {
+        size_t cluster = order[k];
+        output.insert(output.end(), indices + 3*clusters[cluster], indices + 3*clusters[cluster + 1]);
+    }
+    memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+}
+
+size_t OptimizeVertexFetchRemap(std::vector<uint32_t>* remap, const uint32_t* indices, size_t index_count,
+                                size_t vertex_count)
+{
+    remap->assign(vertex_count, UINT32_MAX);
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < index_count; ++i)
+        if ((*remap)[indices[i]] == UINT32_MAX)
+            (*remap)[indices[i]] = next++;
+
+    return next;
+}
+
+void MakeLocalIndices(uint32_t* indices, size_t index_count, size_t vertex_count,
+                      std::vector<uint32_t>* remap, std::vector<uint32_t>* local_vertices)
+{
+    if (remap->empty())
+        remap->assign(vertex_count, UINT32_MAX);
+
+    local_vertices->clear();
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        uint32_t& local = (*remap)[indices[i]];
+        if (local == UINT32_MAX)
+        {
+            local = (uint32_t)local_vertices->size();
+            local_vertices->push_back(indices[i]);
+        }
+        indices[i] = local;
+    }
+
+    // Só as posições usadas foram tocadas; só elas voltam.
+    for (size_t v = 0; v < local_vertices->size(); ++v)
+        (*remap)[(*local_vertices)[v]] = UINT32_MAX;
+}
+
+void RestoreGlobalIndices(uint32_t* indices, size_t index_count, const std::vector<uint32_t>& local_vertices)
+{
+    for (size_t i = 0; i < index_count; ++i)
+        indices[i] = local_vertices[indices[i]];
+}
@@ -0,0 +1,296 @@
+#include "meshsimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Quádrica simétrica 4x4 (10 coeficientes) de uma soma de planos.
+struct Quadric
+{
+    double a00, a01, a02, a03;
+    double      a11, a12, a13;
+    double           a22, a23;
+    double                a33;
+
+    void Clear() { memset(this, 0, sizeof(*this)); }
+
+    void AddPlane(double a, double b, double c, double d)
+    {
+        a00 += a*a; a01 += a*b; a02 += a*c; a03 += a*d;
+                    a11 += b*b; a12 += b*c; a13 += b*d;
+                                a22 += c*c; a23 += c*d;
+                                            a33 += d*d;
+    }
+
+    void Add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+    }
+
+    // Soma dos quadrados das distâncias de p aos planos.
+    double Error(const float* p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        double e = a00*x*x + 2*a01*x*y + 2*a02*x*z + 2*a03*x
+                 + a11*y*y + 2*a12*y*z + 2*a13*y
+                 + a22*z*z + 2*a23*z
+                 + a33;
+        return e > 0.0 ? e : 0.0;
+    }
+};
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    double   error;
+
+    bool operator<(const Collapse& other) const { return error < other.error; }
+};
+
+const float* Position(const float* positions, size_t stride, uint32_t v)
+{
+    return (const float*)((const unsigned char*)positions + v * stride);
+}
+
+void TriangleNormal(const float* a, const float* b, const float* c, double* n)
+{
+    double ux = b[0]-a[0], uy = b[1]-a[1], uz = b[2]-a[2];
+    double vx = c[0]-a[0], vy = c[1]-a[1], vz = c[2]-a[2];
+    n[0] = uy*vz - uz*vy;
+    n[1] = uz*vx - ux*vz;
+    n[2] = ux*vy - uy*vx;
+}
+
+// Trava os vértices que não podem ser colapsados (veja "meshsimplify.h").
+void ComputeLocks(const uint32_t* indices, size_t index_count, const float* positions, size_t stride,
+                  size_t vertex_count, std::vector<char>* locked)
+{
+    locked->assign(vertex_count, 0);
+
+    // Costuras: vértices distintos usados por este conjunto de triângulos que
+    // compartilham a mesma posição.
+    struct Key
+    {
+        float p[3];
+        bool operator==(const Key& o) const { return memcmp(p, o.p, sizeof(p)) == 0; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const
+        {
+            uint32_t h[3];
+            memcpy(h, k.p, sizeof(h));
+            return (size_t)(h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u);
+        }
+    };
+
+    std::vector<char> used(vertex_count, 0);
+    std::unordered_map<Key, uint32_t, KeyHash> first_with_position;
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        uint32_t v = indices[i];
+        if (used[v])
+            continue;
+        used[v] = 1;
+
+        Key key;
+        memcpy(key.p, Position(positions, stride, v), sizeof(key.p));
+        std::pair<std::unordered_map<Key, uint32_t, KeyHash>::iterator, bool> inserted
+            = first_with_position.insert(std::make_pair(key, v));
+        if (!inserted.second)
+        {
+            (*locked)[v] = 1;
+            (*locked)[inserted.first->second] = 1;
+        }
+    }
+
+    // Bordas: arestas usadas por um único triângulo.
+    std::unordered_map<uint64_t, unsigned> edge_count;
+    edge_count.reserve(index_count);
+    for (size_t i = 0; i < index_count; i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+            uint64_t key = a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+            ++edge_count[key];
+        }
+    }
+    for (std::unordered_map<uint64_t, unsigned>::const_iterator it = edge_count.begin(); it != edge_count.end(); ++it)
+    {
+        if (it->second == 1)
+        {
+            (*locked)[(uint32_t)(it->first >> 32)] = 1;
+            (*locked)[(uint32_t)(it->first & 0xffffffffu)] = 1;
+        }
+    }
+}
+
+} // namespace
+
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t index_count,
+                    const float* positions, size_t position_stride, size_t vertex_count,
+                    size_t target_index_count, float target_error, float* result_error)
+{
+    std::vector<uint32_t> result(indices, indices + index_count);
+
+    std::vector<char> locked;
+    ComputeLocks(indices, index_count, positions, position_stride, vertex_count, &locked);
+
+    // Quádrica de cada vértice: planos dos triângulos em volta dele.
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        quadrics[v].Clear();
+    for (size_t i = 0; i < index_count; i += 3)
+    {
+        const float* a = Position(positions, position_stride, indices[i + 0]);
+        const float* b = Position(positions, position_stride, indices[i + 1]);
+        const float* c = Position(positions, position_stride, indices[i + 2]);
+        double n[3];
+        TriangleNormal(a, b, c, n);
+        double length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if (length == 0.0)
+            continue;
+        n[0] /= length; n[1] /= length; n[2] /= length;
+        double d = -(n[0]*a[0] + n[1]*a[1] + n[2]*a[2]);
+        for (int k = 0; k < 3; ++k)
+            quadrics[indices[i + k]].AddPlane(n[0], n[1], n[2], d);
+    }
+
+    const double max_error = (double)target_error * target_error;
+    double achieved_error = 0.0;
+
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<char>     touched(vertex_count);
+    std::vector<size_t>   adjacency_offset(vertex_count + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+
+    while (result.size() > target_index_count)
+    {
+        const size_t triangle_count = result.size() / 3;
+
+        // Triângulos em volta de cada vértice (CSR).
+        std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+        for (size_t i = 0; i < result.size(); ++i)
+            ++adjacency_offset[result[i] + 1];
+        for (size_t v = 0; v < vertex_count; ++v)
+            adjacency_offset[v + 1] += adjacency_offset[v];
+        adjacency.resize(result.size());
+        {
+            std::vector<size_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+            for (size_t t = 0; t < triangle_count; ++t)
+                for (int k = 0; k < 3; ++k)
+                    adjacency[fill[result[3*t + k]]++] = (uint32_t)t;
+        }
+
+        // Candidatos: cada aresta nos dois sentidos, a partir de vértices livres.
+        collapses.clear();
+        for (size_t t = 0; t < triangle_count; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t from = result[3*t + k], to = result[3*t + (k + 1) % 3];
+                for (int direction = 0; direction < 2; ++direction)
+                {
+                    if (!locked[from])
+                    {
+                        Quadric q = quadrics[from];
+                        q.Add(quadrics[to]);
+                        Collapse c = { from, to, q.Error(Position(positions, position_stride, to)) };
+                        if (c.error <= max_error)
+                            collapses.push_back(c);
+                    }
+                    std::swap(from, to);
+                }
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end());
+
+        for (size_t v = 0; v < vertex_count; ++v)
+            remap[v] = (uint32_t)v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        // Cada colapso remove cerca de 2 triângulos; não passa do alvo.
+        size_t budget = (result.size() - target_index_count) / 6 + 1;
+        size_t applied = 0;
+
+        for (size_t c = 0; c < collapses.size() && applied < budget; ++c)
+        {
+            const Collapse& collapse = collapses[c];
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Rejeita o colapso se algum triângulo em volta de "from" virar
+            // (ou ficar degenerado) ao trocar "from" por "to".
+            const float* target = Position(positions, position_stride, collapse.to);
+            bool flips = false;
+            for (size_t a = adjacency_offset[collapse.from]; a < adjacency_offset[collapse.from + 1] && !flips; ++a)
+            {
+                const uint32_t* tri = &result[3 * adjacency[a]];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                    continue; // Vai desaparecer
+
+                const float* p[3];
+                const float* q[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    p[k] = Position(positions, position_stride, tri[k]);
+                    q[k] = tri[k] == collapse.from ? target : p[k];
+                }
+                double before[3], after[3];
+                TriangleNormal(p[0], p[1], p[2], before);
+                TriangleNormal(q[0], q[1], q[2], after);
+                double dot = before[0]*after[0] + before[1]*after[1] + before[2]*after[2];
+                double length2 = (before[0]*before[0] + before[1]*before[1] + before[2]*before[2])
+                               * (after[0]*after[0] + after[1]*after[1] + after[2]*after[2]);
+                if (dot <= 0.0 || dot * dot < 0.25 * length2) // Gira mais de 60 graus
+                    flips = true;
+            }
+            if (flips)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            achieved_error = std::max(achieved_error, collapse.error);
+            ++applied;
+
+            // Os vizinhos de "from" não podem participar de outro colapso nesta
+            // passada, pois a vizinhança deles mudou.
+            for (size_t a = adjacency_offset[collapse.from]; a < adjacency_offset[collapse.from + 1]; ++a)
+                for (int k = 0; k < 3; ++k)
+                    touched[result[3 * adjacency[a] + k]] = 1;
+        }
+
+        if (applied == 0)
+            break;
+
+        // Aplica os colapsos e remove os triângulos degenerados.
+        size_t write = 0;
+        for (size_t t = 0; t < triangle_count; ++t)
+        {
+            uint32_t a = remap[result[3*t]], b = remap[result[3*t + 1]], c = remap[result[3*t + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    memcpy(destination, result.data(), result.size() * sizeof(uint32_t));
+    if (result_error)
+        *result_error = (float)std::sqrt(achieved_error);
+    return result.size();
+}
@@ -0,0 +1,250 @@
+#include "normals.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+#include "threadpool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NORMALS_USE_SSE
+#endif
+
+namespace {
+
+// Número mínimo de triângulos/vértices por tarefa, para que tarefas pequenas
+// não custem mais do que o trabalho que fazem.
+const size_t MIN_TRIANGLES_PER_TASK = 4096;
+const size_t MIN_VERTICES_PER_TASK  = 8192;
+
+// Posições em SoA e triângulos achatados (todos os shapes em sequência).
+struct NormalInput
+{
+    std::vector<float>    x, y, z;
+    std::vector<uint32_t> corner[3];
+    size_t                num_triangles;
+};
+
+// Normais das faces em SoA, já com o peso de cada canto do triângulo.
+struct FaceNormals
+{
+    std::vector<float> x, y, z;
+    std::vector<float> weight[3]; // Usado só com NORMAL_WEIGHTING_ANGLE
+};
+
+float CornerAngle(float ax, float ay, float az, float bx, float by, float bz)
+{
+    float la = std::sqrt(ax*ax + ay*ay + az*az);
+    float lb = std::sqrt(bx*bx + by*by + bz*bz);
+    if (la == 0.0f || lb == 0.0f)
+        return 0.0f;
+    float c = (ax*bx + ay*by + az*bz) / (la * lb);
+    return std::acos(std::max(-1.0f, std::min(1.0f, c)));
+}
+
+// Normal (produto vetorial das arestas) de um triângulo, sem SIMD. Usado no
+// fim dos lotes e quando não há SSE.
+void FaceNormalScalar(const NormalInput& in, size_t t, float* n)
+{
+    uint32_t i0 = in.corner[0][t], i1 = in.corner[1][t], i2 = in.corner[2][t];
+    float ux = in.x[i1] - in.x[i0], uy = in.y[i1] - in.y[i0], uz = in.z[i1] - in.z[i0];
+    float vx = in.x[i2] - in.x[i0], vy = in.y[i2] - in.y[i0], vz = in.z[i2] - in.z[i0];
+    n[0] = uy*vz - uz*vy;
+    n[1] = uz*vx - ux*vz;
+    n[2] = ux*vy - uy*vx;
+}
+
+// Calcula as normais das faces [begin, end).
+void ComputeFaceNormals(const NormalInput& in, NormalWeighting weighting, size_t begin, size_t end, FaceNormals* out)
+{
+    size_t t = begin;
+
+#ifdef NORMALS_USE_SSE
+    for (; t + 4 <= end; t += 4)
+    {
+        // Junta as coordenadas dos 4 triângulos do lote (gather).
+        float ax[4], ay[4], az[4], bx[4], by[4], bz[4], cx[4], cy[4], cz[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            uint32_t i0 = in.corner[0][t+k], i1 = in.corner[1][t+k], i2 = in.corner[2][t+k];
+            ax[k] = in.x[i0]; ay[k] = in.y[i0]; az[k] = in.z[i0];
+            bx[k] = in.x[i1]; by[k] = in.y[i1]; bz[k] = in.z[i1];
+            cx[k] = in.x[i2]; cy[k] = in.y[i2]; cz[k] = in.z[i2];
+        }
+
+        __m128 a_x = _mm_loadu_ps(ax), a_y = _mm_loadu_ps(ay), a_z = _mm_loadu_ps(az);
+        __m128 ux = _mm_sub_ps(_mm_loadu_ps(bx), a_x);
+        __m128 uy = _mm_sub_ps(_mm_loadu_ps(by), a_y);
+        __m128 uz = _mm_sub_ps(_mm_loadu_ps(bz), a_z);
+        __m128 vx = _mm_sub_ps(_mm_loadu_ps(cx), a_x);
+        __m128 vy = _mm_sub_ps(_mm_loadu_ps(cy), a_y);
+        __m128 vz = _mm_sub_ps(_mm_loadu_ps(cz), a_z);
+
+        __m128 nx = _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy));
+        __m128 ny = _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz));
+        __m128 nz = _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx));
+
+        if (weighting != NORMAL_WEIGHTING_AREA)
+        {
+            // Normaliza; triângulos degenerados ficam com normal nula.
+            __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+            __m128 length  = _mm_sqrt_ps(length2);
+            __m128 valid   = _mm_cmpgt_ps(length, _mm_setzero_ps());
+            __m128 inv     = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), length));
+            nx = _mm_mul_ps(nx, inv);
+            ny = _mm_mul_ps(ny, inv);
+            nz = _mm_mul_ps(nz, inv);
+        }
+
+        _mm_storeu_ps(&out->x[t], nx);
+        _mm_storeu_ps(&out->y[t], ny);
+        _mm_storeu_ps(&out->z[t], nz);
+    }
+#endif
+
+    for (; t < end; ++t)
+    {
+        float n[3];
+        FaceNormalScalar(in, t, n);
+        if (weighting != NORMAL_WEIGHTING_AREA)
+        {
+            float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+            float inv = length > 0.0f ? 1.0f / length : 0.0f;
+            n[0] *= inv; n[1] *= inv; n[2] *= inv;
+        }
+        out->x[t] = n[0];
+        out->y[t] = n[1];
+        out->z[t] = n[2];
+    }
+
+    if (weighting == NORMAL_WEIGHTING_ANGLE)
+    {
+        for (t = begin; t < end; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t p = in.corner[k][t], q = in.corner[(k+1)%3][t], r = in.corner[(k+2)%3][t];
+                out->weight[k][t] = CornerAngle(in.x[q] - in.x[p], in.y[q] - in.y[p], in.z[q] - in.z[p],
+                                                in.x[r] - in.x[p], in.y[r] - in.y[p], in.z[r] - in.z[p]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void ComputeVertexNormals(const tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>* shapes,
+                          NormalWeighting weighting, std::vector<float>* normals)
+{
+    const size_t num_vertices = attrib.vertices.size() / 3;
+
+    NormalInput in;
+    in.x.resize(num_vertices);
+    in.y.resize(num_vertices);
+    in.z.resize(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        in.x[v] = attrib.vertices[3*v + 0];
+        in.y[v] = attrib.vertices[3*v + 1];
+        in.z[v] = attrib.vertices[3*v + 2];
+    }
+
+    in.num_triangles = 0;
+    for (size_t shape = 0; shape < shapes->size(); ++shape)
+        in.num_triangles += (*shapes)[shape].mesh.num_face_vertices.size();
+    for (int k = 0; k < 3; ++k)
+        in.corner[k].resize(in.num_triangles);
+
+    // Achata os triângulos e faz a normal de cada canto ser a da sua posição.
+    size_t triangle = 0;
+    for (size_t shape = 0; shape < shapes->size(); ++shape)
+    {
+        tinyobj::mesh_t& mesh = (*shapes)[shape].mesh;
+        for (size_t face = 0; face < mesh.num_face_vertices.size(); ++face, ++triangle)
+        {
+            assert(mesh.num_face_vertices[face] == 3);
+            for (int k = 0; k < 3; ++k)
+            {
+                tinyobj::index_t& idx = mesh.indices[3*face + k];
+                in.corner[k][triangle] = (uint32_t)idx.vertex_index;
+                idx.normal_index = idx.vertex_index;
+            }
+        }
+    }
+
+    // Sem vértices ou sem triângulos não há o que acumular (e &sum[0] abaixo
+    // seria inválido).
+    if (num_vertices == 0 || in.num_triangles == 0)
+    {
+        normals->assign(3 * num_vertices, 0.0f);
+        return;
+    }
+
+    FaceNormals faces;
+    faces.x.resize(in.num_triangles);
+    faces.y.resize(in.num_triangles);
+    faces.z.resize(in.num_triangles);
+    if (weighting == NORMAL_WEIGHTING_ANGLE)
+        for (int k = 0; k < 3; ++k)
+            faces.weight[k].resize(in.num_triangles);
+
+    // Divide os triângulos em um bloco por thread (no máximo); cada bloco tem
+    // o seu próprio buffer de acumulação, então não há escrita compartilhada.
+    size_t num_tasks = std::min<size_t>(GetThreadPool().NumThreads() + 1,
+                                        (in.num_triangles + MIN_TRIANGLES_PER_TASK - 1) / MIN_TRIANGLES_PER_TASK);
+    num_tasks = std::max<size_t>(num_tasks, 1);
+
+    std::vector<std::vector<float> > accumulators(num_tasks);
+
+    ParallelFor(num_tasks, [&](size_t task) {
+        size_t begin = in.num_triangles * task / num_tasks;
+        size_t end   = in.num_triangles * (task + 1) / num_tasks;
+        ComputeFaceNormals(in, weighting, begin, end, &faces);
+
+        // Acumulação em SoA: [x... | y... | z...]
+        std::vector<float>& sum = accumulators[task];
+        sum.assign(3 * num_vertices, 0.0f);
+        float* sx = &sum[0];
+        float* sy = sx + num_vertices;
+        float* sz = sy + num_vertices;
+        for (size_t t = begin; t < end; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t v = in.corner[k][t];
+                float w = weighting == NORMAL_WEIGHTING_ANGLE ? faces.weight[k][t] : 1.0f;
+                sx[v] += faces.x[t] * w;
+                sy[v] += faces.y[t] * w;
+                sz[v] += faces.z[t] * w;
+            }
+        }
+    });
+
+    // Soma os buffers de todas as tarefas e normaliza, em paralelo por
+    // intervalos de vértices.
+    normals->resize(3 * num_vertices);
+    size_t num_ranges = std::max<size_t>(1, (num_vertices + MIN_VERTICES_PER_TASK - 1) / MIN_VERTICES_PER_TASK);
+
+    ParallelFor(num_ranges, [&](size_t range) {
+        size_t begin = num_vertices * range / num_ranges;
+        size_t end   = num_vertices * (range + 1) / num_ranges;
+        for (size_t v = begin; v < end; ++v)
+        {
+            float n[3] = { 0.0f, 0.0f, 0.0f };
+            for (size_t task = 0; task < num_tasks; ++task)
+            {
+                const float* sum = &accumulators[task][0];
+                n[0] += sum[v];
+                n[1] += sum[v + num_vertices];
+                n[2] += sum[v + 2*num_vertices];
+            }
+            float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+            float inv = length > 0.0f ? 1.0f / length : 0.0f;
+            (*normals)[3*v + 0] = n[0] * inv;
+            (*normals)[3*v + 1] = n[1] * inv;
+            (*normals)[3*v + 2] = n[2] * inv;
+        }
+    });
+}
@@ -1,11 +1,43 @@
 #include "object.h"
+#include "meshcache.h"
+#include "objparser.h"
+#include "gltf.h"
+#include <chrono>
 #include <cstdio>
+#include <fstream>
 #include <string>
 
     // Este construtor lê o modelo de um arquivo utilizando a biblioteca tinyobjloader.
     // Veja: https://github.com/syoyo/tinyobjloader
-ObjModel::ObjModel(const char* filename, const char* basepath, bool triangulate)
+ObjModel::ObjModel(const char* filename, const char* basepath, bool triangulate, ObjLoader loader, VertexFormat vertex_format)
+    : filename(filename), vertex_format(vertex_format)
     {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        // Modelos glTF já chegam no formato da GPU e não usam o cache.
+        if (IsGltfFilename(filename))
+        {
+            std::string err;
+            if (!LoadGltf(filename, this, &err))
+            {
+                fprintf(stderr, "\nErro ao ler \"%s\": %s\n", filename, err.c_str());
+                throw std::runtime_error("Erro ao carregar modelo.");
+            }
+            return;
+        }
+
+        // Se existe um cache binário válido para este arquivo, não é preciso
+        // interpretar o texto do ".obj".
+        if (triangulate && LoadMeshCache(this))
+        {
+            for (size_t shape = 0; shape < mesh.shapes.size(); ++shape)
+                printf("- Objeto '%s'\n", mesh.shapes[shape].name.c_str());
+
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            printf("Modelo \"%s\" carregado do cache em %.2f ms\n", filename, ms);
+            return;
+        }
+
         // Se basepath == NULL, então setamos basepath como o dirname do
         // filename, para que os arquivos MTL sejam corretamente carregados caso
         // estejam no mesmo diretório dos arquivos OBJ.
@@ -23,7 +55,24 @@ ObjModel::ObjModel(const char* filename, const char* basepath, bool triangulate)
 
         std::string warn;
         std::string err;
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, basepath, triangulate);
+        bool ret = false;
+        if (loader == OBJ_LOADER_PARALLEL)
+        {
+            ret = LoadObjParallel(&attrib, &shapes, &materials, &warn, &err, filename, basepath, triangulate);
+
+            // Em caso de erro, tenta de novo com a tinyobjloader, que é a
+            // referência para o formato.
+            if (!ret)
+            {
+                fprintf(stderr, "Leitor paralelo falhou para \"%s\": %s", filename, err.c_str());
+                warn.clear();
+                err.clear();
+                materials.clear();
+                loader = OBJ_LOADER_TINYOBJ;
+            }
+        }
+        if (loader == OBJ_LOADER_TINYOBJ)
+            ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, basepath, triangulate);
 
         if (!err.empty())
             fprintf(stderr, "\n%s\n", err.c_str());
@@ -45,4 +94,66 @@ ObjModel::ObjModel(const char* filename, const char* basepath, bool triangulate)
             }
             printf("- Objeto '%s'\n", shapes[shape].name.c_str());
         }
-    }
\ No newline at end of file
+
+        // As posições dos vértices não mudam depois do carregamento, então as
+        // bounding boxes locais são calculadas aqui e reaproveitadas em todos
+        // os quadros.
+        bbox = ComputeLocalBoundingBox(attrib);
+        shape_bboxes.resize(shapes.size());
+        for (size_t shape = 0; shape < shapes.size(); ++shape)
+            shape_bboxes[shape] = ComputeShapeBoundingBox(attrib, shapes[shape]);
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        double megabytes = file ? (double)file.tellg() / (1024.0 * 1024.0) : 0.0;
+        printf("Modelo \"%s\" lido do OBJ em %.2f ms (%s, %.1f MB/s)\n", filename, ms,
+               loader == OBJ_LOADER_PARALLEL ? "paralelo" : "tinyobj",
+               ms > 0.0 ? megabytes / (ms / 1000.0) : 0.0);
+    }
+namespace {
+
+template <typename T>
+size_t VectorBytes(const std::vector<T>& values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+} // namespace
+
+void ObjModelMemoryUsage(const ObjModel& model, size_t* heap, size_t* mapped)
+{
+    const tinyobj::attrib_t& attrib = model.attrib;
+    size_t size = VectorBytes(attrib.vertices) + VectorBytes(attrib.vertex_weights) + VectorBytes(attrib.normals)
+                + VectorBytes(attrib.texcoords) + VectorBytes(attrib.texcoord_ws) + VectorBytes(attrib.colors)
+                + VectorBytes(attrib.skin_weights);
+
+    size += VectorBytes(model.shapes);
+    for (size_t s = 0; s < model.shapes.size(); ++s)
+    {
+        const tinyobj::shape_t& shape = model.shapes[s];
+        size += shape.name.capacity() + VectorBytes(shape.mesh.indices) + VectorBytes(shape.mesh.num_face_vertices)
+              + VectorBytes(shape.mesh.material_ids) + VectorBytes(shape.mesh.smoothing_group_ids)
+              + VectorBytes(shape.mesh.tags) + VectorBytes(shape.lines.indices)
+              + VectorBytes(shape.lines.num_line_vertices) + VectorBytes(shape.points.indices);
+    }
+
+    size += VectorBytes(model.materials) + VectorBytes(model.shape_bboxes);
+
+    const MeshData& mesh = model.mesh;
+    size += mesh.vertices.storage.capacity() + mesh.indices.storage.capacity() + VectorBytes(mesh.shapes);
+    for (size_t s = 0; s < mesh.shapes.size(); ++s)
+        size += mesh.shapes[s].name.capacity() + VectorBytes(mesh.shapes[s].lods)
+              + VectorBytes(mesh.shapes[s].meshlets);
+
+    *heap   = size;
+    *mapped = mesh.mapping ? mesh.mapping->Size() : 0;
+}
+
+void ReleaseObjModelGeometry(ObjModel* model)
+{
+    // clear() não devolve a memória dos vetores; a troca por vetores vazios
+    // devolve.
+    model->attrib = tinyobj::attrib_t();
+    std::vector<tinyobj::shape_t>().swap(model->shapes);
+    model->mesh = MeshData(); // Também fecha o mapeamento do cache
+}
@@ -0,0 +1,915 @@
+#include "objparser.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <set>
+
+#include "mappedfile.h"
+#include "threadpool.h"
+
+// O carregamento acontece em quatro fases:
+//
+//   1. (paralela) Cada bloco de linhas é interpretado de forma independente:
+//      vértices, normais e coordenadas de textura vão para vetores locais, as
+//      faces guardam os índices como estão no arquivo e os comandos que mudam
+//      o estado (g, o, usemtl, mtllib, s) viram eventos.
+//   2. (serial) Calcula onde os atributos de cada bloco começam nos vetores
+//      globais e qual o smoothing group ativo no início de cada bloco.
+//   3. (paralela) Copia os atributos para attrib_t, corrige os índices
+//      relativos/locais e triangula as faces de cada bloco.
+//   4. (serial) Percorre os eventos em ordem, montando os shapes exatamente
+//      como a tinyobjloader faria e lendo os arquivos ".mtl".
+
+namespace {
+
+const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+enum
+{
+    RELATIVE_V  = 1,
+    RELATIVE_VT = 2,
+    RELATIVE_VN = 4,
+};
+
+// Índice de um vértice de face. Índices negativos do arquivo (relativos) são
+// convertidos para índices locais do bloco e marcados em "relative"; a fase 3
+// soma o deslocamento do bloco a eles.
+struct FaceIndex
+{
+    int           v, vt, vn;
+    unsigned char relative;
+};
+
+struct ChunkEvent
+{
+    enum Type { GROUP, OBJECT, USEMTL, MTLLIB, SMOOTHING };
+
+    Type        type;
+    size_t      face;      // Número de faces do bloco antes deste evento
+    std::string text;
+    unsigned    smoothing;
+};
+
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+    std::string error;
+
+    // Fase 1
+    std::vector<float>      v, vn, vt, vc;
+    std::vector<FaceIndex>  face_indices;
+    std::vector<unsigned>   face_sizes;
+    std::vector<ChunkEvent> events;
+
+    // Fase 2
+    size_t   v_offset, vn_offset, vt_offset;
+    unsigned smoothing_start;
+
+    // Fase 3: faces de saída (triângulos, se triangulate == true)
+    std::vector<tinyobj::index_t> indices;
+    std::vector<int>              out_face_sizes;
+    std::vector<unsigned>         out_smoothing;
+    std::vector<size_t>           out_face_first;  // Por face de entrada, mais uma sentinela
+    std::vector<size_t>           out_index_first; // Idem, para "indices"
+};
+
+inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline const char* SkipSpace(const char* p, const char* end)
+{
+    while (p < end && IsSpace(*p))
+        ++p;
+    return p;
+}
+
+inline bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Conversão rápida de texto para float. A mantissa é acumulada como inteiro e
+// multiplicada por uma potência de 10 exata quando possível (expoentes até 22),
+// o que dá o resultado corretamente arredondado para os números que aparecem
+// em arquivos OBJ. Retorna false se não há número na posição atual.
+bool ParseFloat(const char** ptr, const char* end, float* out)
+{
+    static const double POW10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = SkipSpace(*ptr, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int      digits = 0;
+    int      exponent = 0;
+    bool     any_digit = false;
+
+    for (; p < end && IsDigit(*p); ++p)
+    {
+        any_digit = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa != 0)
+                ++digits;
+        }
+        else
+            ++exponent;
+    }
+    if (p < end && *p == '.')
+    {
+        ++p;
+        for (; p < end && IsDigit(*p); ++p)
+        {
+            any_digit = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa != 0)
+                    ++digits;
+                --exponent;
+            }
+        }
+    }
+    if (!any_digit)
+        return false;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool exp_negative = false;
+        if (q < end && (*q == '-' || *q == '+'))
+        {
+            exp_negative = (*q == '-');
+            ++q;
+        }
+        if (q < end && IsDigit(*q))
+        {
+            int e = 0;
+            for (; q < end && IsDigit(*q); ++q)
+                if (e < 10000)
+                    e = e * 10 + (*q - '0');
+            exponent += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+
+    double value = (double)mantissa;
+    if (exponent != 0 && mantissa != 0)
+    {
+        if (exponent > 0 && exponent <= 22)
+            value *= POW10[exponent];
+        else if (exponent < 0 && exponent >= -22)
+            value /= POW10[-exponent];
+        else
+            value *= std::pow(10.0, (double)exponent);
+    }
+
+    *out = (float)(negative ? -value : value);
+    *ptr = p;
+    return true;
+}
+
+// Lê um inteiro com sinal (como atoi()); "ok" indica se havia dígitos.
+int ParseInt(const char** ptr, const char* end, bool* ok)
+{
+    const char* p = *ptr;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+    int value = 0;
+    *ok = false;
+    for (; p < end && IsDigit(*p); ++p)
+    {
+        value = value * 10 + (*p - '0');
+        *ok = true;
+    }
+    *ptr = p;
+    return negative ? -value : value;
+}
+
+// Mesma regra de tinyobj::fixIndex(): positivos começam em 1, negativos são
+// relativos ao número de elementos lidos até agora, zero é inválido.
+bool FixIndex(int idx, size_t local_count, bool allow_zero, int* out, unsigned char* relative, unsigned char relative_bit)
+{
+    if (idx > 0)
+    {
+        *out = idx - 1;
+        return true;
+    }
+    if (idx == 0)
+    {
+        *out = -1;
+        return allow_zero;
+    }
+    *out = (int)local_count + idx;
+    *relative |= relative_bit;
+    return true;
+}
+
+// Equivalente a parseTriple() da tinyobjloader: v, v/vt, v//vn ou v/vt/vn.
+bool ParseFaceIndex(const char** ptr, const char* end, ObjChunk* chunk, FaceIndex* fi)
+{
+    const char* p = *ptr;
+    bool ok;
+
+    fi->v = fi->vt = fi->vn = -1;
+    fi->relative = 0;
+
+    int v = ParseInt(&p, end, &ok);
+    if (!FixIndex(v, chunk->v.size() / 3, false, &fi->v, &fi->relative, RELATIVE_V))
+        return false;
+
+    if (p < end && *p == '/')
+    {
+        ++p;
+        if (p < end && *p == '/')
+        {
+            ++p;
+            int vn = ParseInt(&p, end, &ok);
+            if (!FixIndex(vn, chunk->vn.size() / 3, true, &fi->vn, &fi->relative, RELATIVE_VN))
+                return false;
+        }
+        else
+        {
+            int vt = ParseInt(&p, end, &ok);
+            if (!FixIndex(vt, chunk->vt.size() / 2, true, &fi->vt, &fi->relative, RELATIVE_VT))
+                return false;
+            if (p < end && *p == '/')
+            {
+                ++p;
+                int vn = ParseInt(&p, end, &ok);
+                if (!FixIndex(vn, chunk->vn.size() / 3, true, &fi->vn, &fi->relative, RELATIVE_VN))
+                    return false;
+            }
+        }
+    }
+
+    // Ignora qualquer resto do token, como a tinyobjloader.
+    while (p < end && !IsSpace(*p))
+        ++p;
+
+    *ptr = p;
+    return true;
+}
+
+// Próxima palavra (sequência sem espaços) a partir de p.
+std::string ParseWord(const char* p, const char* end)
+{
+    p = SkipSpace(p, end);
+    const char* q = p;
+    while (q < end && !IsSpace(*q))
+        ++q;
+    return std::string(p, q);
+}
+
+void AddEvent(ObjChunk* chunk, ChunkEvent::Type type, const std::string& text, unsigned smoothing = 0)
+{
+    ChunkEvent event;
+    event.type      = type;
+    event.face      = chunk->face_sizes.size();
+    event.text      = text;
+    event.smoothing = smoothing;
+    chunk->events.push_back(event);
+}
+
+// Interpreta uma linha [p, end) já sem espaços iniciais e sem "\r\n".
+bool ParseLine(ObjChunk* chunk, const char* p, const char* end)
+{
+    const char c0 = p[0];
+    const char c1 = p + 1 < end ? p[1] : '\0';
+    const char c2 = p + 2 < end ? p[2] : '\0';
+
+    if (c0 == '#')
+        return true;
+
+    if (c0 == 'v' && IsSpace(c1))
+    {
+        p += 2;
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        ParseFloat(&p, end, &x);
+        ParseFloat(&p, end, &y);
+        ParseFloat(&p, end, &z);
+        chunk->v.push_back(x);
+        chunk->v.push_back(y);
+        chunk->v.push_back(z);
+
+        // Cor opcional por vértice; a tinyobjloader usa branco quando não há.
+        float r = 1.0f, g = 1.0f, b = 1.0f;
+        if (!(ParseFloat(&p, end, &r) && ParseFloat(&p, end, &g) && ParseFloat(&p, end, &b)))
+            r = g = b = 1.0f;
+        chunk->vc.push_back(r);
+        chunk->vc.push_back(g);
+        chunk->vc.push_back(b);
+        return true;
+    }
+
+    if (c0 == 'v' && c1 == 'n' && IsSpace(c2))
+    {
+        p += 3;
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        ParseFloat(&p, end, &x);
+        ParseFloat(&p, end, &y);
+        ParseFloat(&p, end, &z);
+        chunk->vn.push_back(x);
+        chunk->vn.push_back(y);
+        chunk->vn.push_back(z);
+        return true;
+    }
+
+    if (c0 == 'v' && c1 == 't' && IsSpace(c2))
+    {
+        p += 3;
+        float u = 0.0f, v = 0.0f;
+        ParseFloat(&p, end, &u);
+        ParseFloat(&p, end, &v);
+        chunk->vt.push_back(u);
+        chunk->vt.push_back(v);
+        return true;
+    }
+
+    if (c0 == 'f' && IsSpace(c1))
+    {
+        p += 2;
+        unsigned count = 0;
+        for (p = SkipSpace(p, end); p < end; p = SkipSpace(p, end))
+        {
+            FaceIndex fi;
+            if (!ParseFaceIndex(&p, end, chunk, &fi))
+            {
+                chunk->error = "Failed to parse `f' line (e.g. a zero value for vertex index).\n";
+                return false;
+            }
+            chunk->face_indices.push_back(fi);
+            ++count;
+        }
+        chunk->face_sizes.push_back(count);
+        return true;
+    }
+
+    if (end - p >= 7 && strncmp(p, "usemtl", 6) == 0 && IsSpace(p[6]))
+    {
+        AddEvent(chunk, ChunkEvent::USEMTL, ParseWord(p + 7, end));
+        return true;
+    }
+
+    if (end - p >= 7 && strncmp(p, "mtllib", 6) == 0 && IsSpace(p[6]))
+    {
+        AddEvent(chunk, ChunkEvent::MTLLIB, std::string(p + 7, end));
+        return true;
+    }
+
+    if (c0 == 'g' && IsSpace(c1))
+    {
+        // Nome do grupo: todas as palavras depois de "g", separadas por um espaço.
+        std::string name;
+        for (const char* q = SkipSpace(p + 2, end); q < end; q = SkipSpace(q, end))
+        {
+            const char* word_end = q;
+            while (word_end < end && !IsSpace(*word_end))
+                ++word_end;
+            if (!name.empty())
+                name += ' ';
+            name.append(q, word_end);
+            q = word_end;
+        }
+        AddEvent(chunk, ChunkEvent::GROUP, name);
+        return true;
+    }
+
+    if (c0 == 'o' && IsSpace(c1))
+    {
+        AddEvent(chunk, ChunkEvent::OBJECT, std::string(SkipSpace(p + 2, end), end));
+        return true;
+    }
+
+    if (c0 == 's' && IsSpace(c1))
+    {
+        p = SkipSpace(p + 2, end);
+        if (p >= end)
+            return true;
+
+        unsigned smoothing = 0;
+        if (!(end - p >= 3 && strncmp(p, "off", 3) == 0))
+        {
+            bool ok;
+            int id = ParseInt(&p, end, &ok);
+            smoothing = id < 0 ? 0 : (unsigned)id;
+        }
+        AddEvent(chunk, ChunkEvent::SMOOTHING, std::string(), smoothing);
+        return true;
+    }
+
+    // Comandos desconhecidos (e "l", "p", "t", "vw") são ignorados.
+    return true;
+}
+
+// Fase 1: interpreta todas as linhas de um bloco.
+void ParseChunk(ObjChunk* chunk)
+{
+    const char* p = chunk->begin;
+    while (p < chunk->end)
+    {
+        const char* line_end = (const char*)memchr(p, '\n', chunk->end - p);
+        if (line_end == NULL)
+            line_end = chunk->end;
+        const char* next = line_end < chunk->end ? line_end + 1 : chunk->end;
+
+        const char* e = line_end;
+        if (e > p && e[-1] == '\r')
+            --e;
+
+        p = SkipSpace(p, e);
+        if (p < e && !ParseLine(chunk, p, e))
+            return;
+
+        p = next;
+    }
+}
+
+// Triangulação de quadriláteros igual à da tinyobjloader: divide pela
+// diagonal mais curta.
+bool SplitQuadAlong02(const std::vector<float>& v, const tinyobj::index_t* q)
+{
+    const float* p0 = &v[3*q[0].vertex_index];
+    const float* p1 = &v[3*q[1].vertex_index];
+    const float* p2 = &v[3*q[2].vertex_index];
+    const float* p3 = &v[3*q[3].vertex_index];
+
+    float e02x = p2[0] - p0[0], e02y = p2[1] - p0[1], e02z = p2[2] - p0[2];
+    float e13x = p3[0] - p1[0], e13y = p3[1] - p1[1], e13z = p3[2] - p1[2];
+
+    return e02x*e02x + e02y*e02y + e02z*e02z < e13x*e13x + e13y*e13y + e13z*e13z;
+}
+
+// Teste de ponto dentro de triângulo usado pela tinyobjloader (pnpoly).
+bool PointInTriangle(const float* vx, const float* vy, float tx, float ty)
+{
+    bool inside = false;
+    for (int i = 0, j = 2; i < 3; j = i++)
+        if (((vy[i] > ty) != (vy[j] > ty)) && (tx < (vx[j] - vx[i]) * (ty - vy[i]) / (vy[j] - vy[i]) + vx[i]))
+            inside = !inside;
+    return inside;
+}
+
+// Triangulação de polígonos com mais de 4 vértices por "ear clipping",
+// reproduzindo passo a passo a implementação embutida da tinyobjloader para
+// que o resultado seja idêntico.
+void EarClipPolygon(const std::vector<float>& v, std::vector<tinyobj::index_t> polygon,
+                    std::vector<tinyobj::index_t>* out, size_t* num_triangles)
+{
+    // Escolhe os dois eixos do plano de projeção a partir do primeiro canto
+    // não degenerado.
+    size_t n = polygon.size();
+    size_t axes[2] = { 1, 2 };
+    for (size_t k = 0; k < n; ++k)
+    {
+        const float* p0 = &v[3*polygon[(k + 0) % n].vertex_index];
+        const float* p1 = &v[3*polygon[(k + 1) % n].vertex_index];
+        const float* p2 = &v[3*polygon[(k + 2) % n].vertex_index];
+        float e0x = p1[0] - p0[0], e0y = p1[1] - p0[1], e0z = p1[2] - p0[2];
+        float e1x = p2[0] - p1[0], e1y = p2[1] - p1[1], e1z = p2[2] - p1[2];
+        float cx = std::fabs(e0y * e1z - e0z * e1y);
+        float cy = std::fabs(e0z * e1x - e0x * e1z);
+        float cz = std::fabs(e0x * e1y - e0y * e1x);
+        const float epsilon = std::numeric_limits<float>::epsilon();
+        if (cx > epsilon || cy > epsilon || cz > epsilon)
+        {
+            if (!(cx > cy && cx > cz))
+            {
+                axes[0] = 0;
+                if (cz > cx && cz > cy)
+                    axes[1] = 1;
+            }
+            break;
+        }
+    }
+
+    size_t guess = 0;
+    size_t remaining_iterations = n;
+    size_t previous_remaining = n;
+
+    while (polygon.size() > 3 && remaining_iterations > 0)
+    {
+        n = polygon.size();
+        if (guess >= n)
+            guess -= n;
+
+        if (previous_remaining != n)
+        {
+            previous_remaining = n;
+            remaining_iterations = n;
+        }
+        else
+            --remaining_iterations;
+
+        tinyobj::index_t ind[3];
+        float vx[3], vy[3];
+        for (size_t k = 0; k < 3; ++k)
+        {
+            ind[k] = polygon[(guess + k) % n];
+            vx[k] = v[3*ind[k].vertex_index + axes[0]];
+            vy[k] = v[3*ind[k].vertex_index + axes[1]];
+        }
+
+        float e0x = vx[1] - vx[0], e0y = vy[1] - vy[0];
+        float e1x = vx[2] - vx[1], e1y = vy[2] - vy[1];
+        float cross = e0x * e1y - e0y * e1x;
+        float area = (vx[0] * vy[1] - vy[0] * vx[1]) * 0.5f;
+        if (cross * area < 0.0f)
+        {
+            ++guess;
+            continue;
+        }
+
+        bool overlap = false;
+        for (size_t other = 3; other < n; ++other)
+        {
+            int ovi = polygon[(guess + other) % n].vertex_index;
+            if (PointInTriangle(vx, vy, v[3*ovi + axes[0]], v[3*ovi + axes[1]]))
+            {
+                overlap = true;
+                break;
+            }
+        }
+        if (overlap)
+        {
+            ++guess;
+            continue;
+        }
+
+        out->insert(out->end(), ind, ind + 3);
+        ++(*num_triangles);
+        polygon.erase(polygon.begin() + (guess + 1) % n);
+    }
+
+    if (polygon.size() == 3)
+    {
+        out->insert(out->end(), polygon.begin(), polygon.end());
+        ++(*num_triangles);
+    }
+}
+
+// Fase 3: corrige os índices de um bloco e gera as faces de saída.
+void ResolveChunk(ObjChunk* chunk, const tinyobj::attrib_t& attrib, bool triangulate)
+{
+    const int num_v  = (int)(attrib.vertices.size() / 3);
+    const int num_vn = (int)(attrib.normals.size() / 3);
+    const int num_vt = (int)(attrib.texcoords.size() / 2);
+
+    const size_t num_faces = chunk->face_sizes.size();
+    chunk->out_face_first.resize(num_faces + 1);
+    chunk->out_index_first.resize(num_faces + 1);
+    chunk->indices.reserve(chunk->face_indices.size() * 3 / 2);
+    chunk->out_face_sizes.reserve(num_faces * 2);
+    chunk->out_smoothing.reserve(num_faces * 2);
+
+    unsigned smoothing = chunk->smoothing_start;
+    size_t next_event = 0;
+    size_t first = 0;
+    std::vector<tinyobj::index_t> polygon;
+
+    for (size_t face = 0; face < num_faces; ++face)
+    {
+        for (; next_event < chunk->events.size() && chunk->events[next_event].face <= face; ++next_event)
+            if (chunk->events[next_event].type == ChunkEvent::SMOOTHING)
+                smoothing = chunk->events[next_event].smoothing;
+
+        chunk->out_face_first[face]  = chunk->out_face_sizes.size();
+        chunk->out_index_first[face] = chunk->indices.size();
+
+        const unsigned n = chunk->face_sizes[face];
+        polygon.resize(n);
+        bool valid = true;
+        for (unsigned k = 0; k < n; ++k)
+        {
+            const FaceIndex& fi = chunk->face_indices[first + k];
+            tinyobj::index_t& idx = polygon[k];
+            idx.vertex_index   = fi.v  + ((fi.relative & RELATIVE_V)  ? (int)chunk->v_offset  : 0);
+            idx.texcoord_index = fi.vt + ((fi.relative & RELATIVE_VT) ? (int)chunk->vt_offset : 0);
+            idx.normal_index   = fi.vn + ((fi.relative & RELATIVE_VN) ? (int)chunk->vn_offset : 0);
+            if (idx.vertex_index < 0 || idx.vertex_index >= num_v
+                || idx.normal_index < -1 || idx.normal_index >= num_vn
+                || idx.texcoord_index < -1 || idx.texcoord_index >= num_vt)
+                valid = false;
+        }
+        first += n;
+
+        if (!valid)
+        {
+            chunk->error = "Face with invalid vertex index found.\n";
+            return;
+        }
+        if (n < 3)
+            continue; // Face degenerada, descartada como na tinyobjloader
+
+        if (!triangulate || n == 3)
+        {
+            chunk->indices.insert(chunk->indices.end(), polygon.begin(), polygon.end());
+            chunk->out_face_sizes.push_back((int)n);
+            chunk->out_smoothing.push_back(smoothing);
+        }
+        else if (n == 4)
+        {
+            static const int SPLIT_02[6] = { 0, 1, 2, 0, 2, 3 };
+            static const int SPLIT_13[6] = { 0, 1, 3, 1, 2, 3 };
+            const int* order = SplitQuadAlong02(attrib.vertices, &polygon[0]) ? SPLIT_02 : SPLIT_13;
+            for (int k = 0; k < 6; ++k)
+                chunk->indices.push_back(polygon[order[k]]);
+            for (int t = 0; t < 2; ++t)
+            {
+                chunk->out_face_sizes.push_back(3);
+                chunk->out_smoothing.push_back(smoothing);
+            }
+        }
+        else
+        {
+            size_t num_triangles = 0;
+            EarClipPolygon(attrib.vertices, polygon, &chunk->indices, &num_triangles);
+            for (size_t t = 0; t < num_triangles; ++t)
+            {
+                chunk->out_face_sizes.push_back(3);
+                chunk->out_smoothing.push_back(smoothing);
+            }
+        }
+    }
+
+    chunk->out_face_first[num_faces]  = chunk->out_face_sizes.size();
+    chunk->out_index_first[num_faces] = chunk->indices.size();
+}
+
+// Separa os nomes de arquivo de um "mtllib" por espaços, aceitando "\\ "
+// para espaços dentro do nome (mesma regra da tinyobjloader).
+void SplitFilenames(const std::string& text, std::vector<std::string>* filenames)
+{
+    std::string token;
+    bool escaping = false;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char ch = text[i];
+        if (escaping)
+            escaping = false;
+        else if (ch == '\\')
+        {
+            escaping = true;
+            continue;
+        }
+        else if (ch == ' ')
+        {
+            if (!token.empty())
+                filenames->push_back(token);
+            token.clear();
+            continue;
+        }
+        token += ch;
+    }
+    if (!token.empty())
+        filenames->push_back(token);
+}
+
+// Acrescenta ao shape atual as faces de saída correspondentes às faces de
+// entrada [face_begin, face_end) de um bloco.
+void AppendFaces(tinyobj::shape_t* shape, const ObjChunk& chunk, size_t face_begin, size_t face_end, int material_id)
+{
+    size_t out_begin = chunk.out_face_first[face_begin];
+    size_t out_end   = chunk.out_face_first[face_end];
+    if (out_begin == out_end)
+        return;
+
+    tinyobj::mesh_t& mesh = shape->mesh;
+    mesh.indices.insert(mesh.indices.end(),
+                        chunk.indices.begin() + chunk.out_index_first[face_begin],
+                        chunk.indices.begin() + chunk.out_index_first[face_end]);
+    mesh.num_face_vertices.insert(mesh.num_face_vertices.end(),
+                                  chunk.out_face_sizes.begin() + out_begin,
+                                  chunk.out_face_sizes.begin() + out_end);
+    mesh.material_ids.insert(mesh.material_ids.end(), out_end - out_begin, material_id);
+    mesh.smoothing_group_ids.insert(mesh.smoothing_group_ids.end(),
+                                    chunk.out_smoothing.begin() + out_begin,
+                                    chunk.out_smoothing.begin() + out_end);
+}
+
+} // namespace
+
+bool LoadObjParallel(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+                     std::vector<tinyobj::material_t>* materials, std::string* warn,
+                     std::string* err, const char* filename, const char* mtl_basedir,
+                     bool triangulate)
+{
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->colors.clear();
+    shapes->clear();
+
+    MappedFile file;
+    if (!file.Open(filename))
+    {
+        if (err)
+            (*err) += "Cannot open file [" + std::string(filename) + "]\n";
+        return false;
+    }
+
+    const char* data = (const char*)file.Data();
+    const size_t size = file.Size();
+
+    // Divide o arquivo em blocos de tamanho parecido, sempre terminando logo
+    // depois de um '\n' para que nenhuma linha fique dividida.
+    size_t num_chunks = GetThreadPool().NumThreads() * 4;
+    if (num_chunks > size / MIN_CHUNK_SIZE)
+        num_chunks = size / MIN_CHUNK_SIZE;
+    if (num_chunks < 1)
+        num_chunks = 1;
+
+    std::vector<ObjChunk> chunks(num_chunks);
+    const char* begin = data;
+    for (size_t c = 0; c < num_chunks; ++c)
+    {
+        const char* end = (c + 1 == num_chunks) ? data + size : data + size * (c + 1) / num_chunks;
+        if (end < begin)
+            end = begin;
+        const char* newline = (const char*)memchr(end, '\n', data + size - end);
+        end = (c + 1 == num_chunks || newline == NULL) ? data + size : newline + 1;
+        chunks[c].begin = begin;
+        chunks[c].end   = end;
+        begin = end;
+    }
+
+    // Fase 1
+    ParallelFor(num_chunks, [&chunks](size_t c) { ParseChunk(&chunks[c]); });
+
+    for (size_t c = 0; c < num_chunks; ++c)
+    {
+        if (!chunks[c].error.empty())
+        {
+            if (err)
+                (*err) += chunks[c].error;
+            return false;
+        }
+    }
+
+    // Fase 2
+    size_t num_v = 0, num_vn = 0, num_vt = 0;
+    unsigned smoothing = 0;
+    for (size_t c = 0; c < num_chunks; ++c)
+    {
+        ObjChunk& chunk = chunks[c];
+        chunk.v_offset  = num_v;
+        chunk.vn_offset = num_vn;
+        chunk.vt_offset = num_vt;
+        chunk.smoothing_start = smoothing;
+        num_v  += chunk.v.size() / 3;
+        num_vn += chunk.vn.size() / 3;
+        num_vt += chunk.vt.size() / 2;
+        for (size_t e = 0; e < chunk.events.size(); ++e)
+            if (chunk.events[e].type == ChunkEvent::SMOOTHING)
+                smoothing = chunk.events[e].smoothing;
+    }
+
+    attrib->vertices.resize(3 * num_v);
+    attrib->colors.resize(3 * num_v);
+    attrib->normals.resize(3 * num_vn);
+    attrib->texcoords.resize(2 * num_vt);
+
+    // Fase 3: primeiro os atributos (a triangulação precisa das posições
+    // globais), depois os índices.
+    ParallelFor(num_chunks, [&chunks, attrib](size_t c) {
+        ObjChunk& chunk = chunks[c];
+        std::copy(chunk.v.begin(),  chunk.v.end(),  attrib->vertices.begin()  + 3 * chunk.v_offset);
+        std::copy(chunk.vc.begin(), chunk.vc.end(), attrib->colors.begin()    + 3 * chunk.v_offset);
+        std::copy(chunk.vn.begin(), chunk.vn.end(), attrib->normals.begin()   + 3 * chunk.vn_offset);
+        std::copy(chunk.vt.begin(), chunk.vt.end(), attrib->texcoords.begin() + 2 * chunk.vt_offset);
+        std::vector<float>().swap(chunk.v);
+        std::vector<float>().swap(chunk.vc);
+        std::vector<float>().swap(chunk.vn);
+        std::vector<float>().swap(chunk.vt);
+    });
+
+    ParallelFor(num_chunks, [&chunks, attrib, triangulate](size_t c) {
+        ResolveChunk(&chunks[c], *attrib, triangulate);
+    });
+
+    for (size_t c = 0; c < num_chunks; ++c)
+    {
+        if (!chunks[c].error.empty())
+        {
+            if (err)
+                (*err) += chunks[c].error;
+            return false;
+        }
+    }
+
+    // Fase 4
+    tinyobj::MaterialFileReader material_reader(mtl_basedir ? mtl_basedir : "");
+    std::map<std::string, int> material_map;
+    std::set<std::string> material_filenames;
+    int material = -1;
+    std::string name;
+    tinyobj::shape_t shape;
+
+    for (size_t c = 0; c < num_chunks; ++c)
+    {
+        const ObjChunk& chunk = chunks[c];
+        size_t face = 0;
+
+        for (size_t e = 0; e <= chunk.events.size(); ++e)
+        {
+            size_t event_face = e < chunk.events.size() ? chunk.events[e].face : chunk.face_sizes.size();
+            if (event_face > face)
+            {
+                if (shape.mesh.indices.empty())
+                    shape.name = name;
+                AppendFaces(&shape, chunk, face, event_face, material);
+                face = event_face;
+            }
+            if (e == chunk.events.size())
+                break;
+
+            const ChunkEvent& event = chunk.events[e];
+            switch (event.type)
+            {
+            case ChunkEvent::GROUP:
+            case ChunkEvent::OBJECT:
+                if (!shape.mesh.indices.empty())
+                    shapes->push_back(shape);
+                shape = tinyobj::shape_t();
+                name = event.text;
+                break;
+
+            case ChunkEvent::USEMTL:
+            {
+                std::map<std::string, int>::const_iterator it = material_map.find(event.text);
+                if (it != material_map.end())
+                    material = it->second;
+                else
+                {
+                    material = -1;
+                    if (warn)
+                        (*warn) += "material [ '" + event.text + "' ] not found in .mtl\n";
+                }
+                break;
+            }
+
+            case ChunkEvent::MTLLIB:
+            {
+                // Vários arquivos podem ser listados; usa o primeiro que for
+                // lido com sucesso.
+                std::vector<std::string> mtl_filenames;
+                SplitFilenames(event.text, &mtl_filenames);
+
+                bool found = false;
+                for (size_t f = 0; f < mtl_filenames.size(); ++f)
+                {
+                    if (material_filenames.count(mtl_filenames[f]) > 0)
+                    {
+                        found = true;
+                        continue;
+                    }
+
+                    std::string warn_mtl, err_mtl;
+                    bool ok = material_reader(mtl_filenames[f], materials, &material_map, &warn_mtl, &err_mtl);
+                    if (warn)
+                        (*warn) += warn_mtl;
+                    if (err)
+                        (*err) += err_mtl;
+                    if (ok)
+                    {
+                        found = true;
+                        material_filenames.insert(mtl_filenames[f]);
+                        break;
+                    }
+                }
+                if (!found && warn)
+                    (*warn) += "Failed to load material file(s). Use default material.\n";
+                break;
+            }
+
+            case ChunkEvent::SMOOTHING:
+                break; // Já aplicado na fase 3
+            }
+        }
+    }
+
+    if (!shape.mesh.indices.empty())
+        shapes->push_back(shape);
+
+    return true;
+}
@@ -0,0 +1,557 @@
+#include "objstream.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// Entradas da tabela de vértices recentes (potência de 2).
+const size_t VERTEX_CACHE_SIZE = 4096;
+
+// Primeira passada: só contagens e a caixa das posições.
+struct CountPass
+{
+    size_t positions;
+    size_t normals;
+    size_t texcoords;
+    size_t corners;   // Soma dos vértices de todas as faces
+    size_t indices;   // Índices depois da triangulação em leque
+    float  minimum[3];
+    float  maximum[3];
+
+    CountPass() : positions(0), normals(0), texcoords(0), corners(0), indices(0)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            minimum[i] = 0.0f;
+            maximum[i] = 0.0f;
+        }
+    }
+};
+
+void CountVertex(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t)
+{
+    CountPass* pass = (CountPass*)user_data;
+    float p[3] = { (float)x, (float)y, (float)z };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (pass->positions == 0 || p[i] < pass->minimum[i])
+            pass->minimum[i] = p[i];
+        if (pass->positions == 0 || p[i] > pass->maximum[i])
+            pass->maximum[i] = p[i];
+    }
+    pass->positions++;
+}
+
+void CountNormal(void* user_data, tinyobj::real_t, tinyobj::real_t, tinyobj::real_t)
+{
+    ((CountPass*)user_data)->normals++;
+}
+
+void CountTexcoord(void* user_data, tinyobj::real_t, tinyobj::real_t, tinyobj::real_t)
+{
+    ((CountPass*)user_data)->texcoords++;
+}
+
+void CountFace(void* user_data, tinyobj::index_t*, int num_indices)
+{
+    CountPass* pass = (CountPass*)user_data;
+    if (num_indices < 3)
+        return;
+    pass->corners += (size_t)num_indices;
+    pass->indices += (size_t)(num_indices - 2) * 3;
+}
+
+struct CachedVertex
+{
+    int      position;
+    int      normal;
+    int      texcoord;
+    uint32_t index;
+};
+
+// Segunda passada: codifica os vértices e índices e envia os blocos cheios.
+struct StreamPass
+{
+    ObjModel*       model;
+    MeshAllocation* allocation;
+    VertexFormat    format;
+    size_t          stride;
+    uint32_t        index_size;
+    std::string     error;
+
+    // Atributos do arquivo, na ordem das linhas "v", "vn" e "vt".
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+
+    std::vector<CachedVertex> cache;
+
+    // Arquivos sem "vn": as normais de área das faces são somadas em cada
+    // posição, e os vértices (posição e textura de cada um, em "deferred")
+    // só são codificados no fim, quando as somas estão completas.
+    bool               generate_normals;
+    std::vector<float> position_normals;
+    std::vector<int>   deferred;
+
+    std::vector<unsigned char> vertex_block;
+    std::vector<unsigned char> index_block;
+    size_t block_vertices;
+    size_t block_indices;
+    size_t num_vertices;  // Já emitidos, inclusive os que estão no bloco
+    size_t num_indices;
+    size_t flushes;
+
+    // Shape aberto (o último de model->mesh.shapes), se houver.
+    bool        shape_open;
+    std::string name;
+    int         material_id;
+
+    StreamPass()
+        : model(NULL), allocation(NULL), format(VERTEX_FORMAT_FLOAT), stride(0), index_size(4),
+          generate_normals(false), block_vertices(0), block_indices(0), num_vertices(0), num_indices(0),
+          flushes(0), shape_open(false), material_id(-1)
+    {
+    }
+};
+
+void FlushVertices(StreamPass* pass)
+{
+    if (pass->block_vertices == 0)
+        return;
+    size_t first = pass->num_vertices - pass->block_vertices;
+    MeshArena_WriteVertices(*pass->allocation, first * pass->stride, pass->vertex_block.data(),
+                            pass->block_vertices * pass->stride);
+    pass->block_vertices = 0;
+    pass->flushes++;
+}
+
+void FlushIndices(StreamPass* pass)
+{
+    if (pass->block_indices == 0)
+        return;
+    size_t first = pass->num_indices - pass->block_indices;
+    MeshArena_WriteIndices(*pass->allocation, first * pass->index_size, pass->index_block.data(),
+                           pass->block_indices * pass->index_size);
+    pass->block_indices = 0;
+    pass->flushes++;
+}
+
+// Converte um índice do ".obj" (a partir de 1, negativo = relativo ao fim da
+// lista, 0 = ausente) para um índice a partir de 0, ou -1 se ausente. Retorna
+// false se o índice estiver fora da lista.
+bool FixIndex(int index, size_t count, int* fixed)
+{
+    if (index == 0)
+    {
+        *fixed = -1;
+        return true;
+    }
+    long long value = index > 0 ? (long long)index - 1 : (long long)count + index;
+    if (value < 0 || value >= (long long)count)
+        return false;
+    *fixed = (int)value;
+    return true;
+}
+
+// Índice do vértice com estes atributos, emitindo-o se ele não estiver entre
+// os recentes.
+uint32_t EmitVertex(StreamPass* pass, int position, int normal, int texcoord)
+{
+    uint32_t hash = (uint32_t)position * 73856093u ^ (uint32_t)normal * 19349663u ^ (uint32_t)texcoord * 83492791u;
+    CachedVertex& cached = pass->cache[hash & (VERTEX_CACHE_SIZE - 1)];
+    if (cached.position == position && cached.normal == normal && cached.texcoord == texcoord)
+        return cached.index;
+
+    cached.position = position;
+    cached.normal   = normal;
+    cached.texcoord = texcoord;
+    cached.index    = (uint32_t)pass->num_vertices++;
+
+    if (pass->generate_normals)
+    {
+        pass->deferred.push_back(position);
+        pass->deferred.push_back(texcoord);
+        return cached.index;
+    }
+
+    if (pass->block_vertices == OBJ_STREAM_BLOCK_VERTICES)
+        FlushVertices(pass);
+
+    const MeshData& mesh = pass->model->mesh;
+    EncodeVertex(pass->format, &pass->positions[3 * position],
+                 normal >= 0 ? &pass->normals[3 * normal] : NULL,
+                 texcoord >= 0 ? &pass->texcoords[2 * texcoord] : NULL,
+                 mesh.position_offset, mesh.position_scale,
+                 &pass->vertex_block[pass->block_vertices * pass->stride]);
+    pass->block_vertices++;
+    return cached.index;
+}
+
+// Soma a normal do triângulo, com o tamanho proporcional à área, nas suas
+// três posições.
+void AccumulateFaceNormal(StreamPass* pass, const int* positions)
+{
+    const float* p0 = &pass->positions[3 * positions[0]];
+    const float* p1 = &pass->positions[3 * positions[1]];
+    const float* p2 = &pass->positions[3 * positions[2]];
+    glm::vec3 n = glm::cross(glm::vec3(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]),
+                             glm::vec3(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]));
+    for (int k = 0; k < 3; ++k)
+    {
+        float* sum = &pass->position_normals[3 * positions[k]];
+        sum[0] += n.x;
+        sum[1] += n.y;
+        sum[2] += n.z;
+    }
+}
+
+// Normaliza as somas de AccumulateFaceNormal() e codifica os vértices
+// adiados, enviando-os à GPU em blocos.
+void EncodeDeferredVertices(StreamPass* pass)
+{
+    for (size_t v = 0; 3 * v < pass->position_normals.size(); ++v)
+    {
+        float* n = &pass->position_normals[3 * v];
+        float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        float inv = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int k = 0; k < 3; ++k)
+            n[k] *= inv;
+    }
+
+    const MeshData& mesh = pass->model->mesh;
+    size_t emitted = pass->num_vertices;
+    pass->num_vertices = 0;
+    for (size_t v = 0; v < emitted; ++v)
+    {
+        if (pass->block_vertices == OBJ_STREAM_BLOCK_VERTICES)
+            FlushVertices(pass);
+
+        int position = pass->deferred[2 * v], texcoord = pass->deferred[2 * v + 1];
+        EncodeVertex(pass->format, &pass->positions[3 * position], &pass->position_normals[3 * position],
+                     texcoord >= 0 ? &pass->texcoords[2 * texcoord] : NULL,
+                     mesh.position_offset, mesh.position_scale,
+                     &pass->vertex_block[pass->block_vertices * pass->stride]);
+        pass->block_vertices++;
+        pass->num_vertices++;
+    }
+}
+
+void EmitIndex(StreamPass* pass, uint32_t index)
+{
+    if (pass->block_indices == OBJ_STREAM_BLOCK_INDICES)
+        FlushIndices(pass);
+
+    unsigned char* out = &pass->index_block[pass->block_indices * pass->index_size];
+    if (pass->index_size == 2)
+    {
+        uint16_t value = (uint16_t)index;
+        memcpy(out, &value, sizeof(value));
+    }
+    else
+        memcpy(out, &index, sizeof(index));
+    pass->block_indices++;
+    pass->num_indices++;
+}
+
+void CloseShape(StreamPass* pass)
+{
+    if (!pass->shape_open)
+        return;
+    MeshShape& shape = pass->model->mesh.shapes.back();
+    shape.num_indices = (uint32_t)(pass->num_indices - shape.first_index);
+    pass->shape_open = false;
+}
+
+void StreamVertex(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    pass->positions.push_back((float)x);
+    pass->positions.push_back((float)y);
+    pass->positions.push_back((float)z);
+}
+
+void StreamNormal(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    pass->normals.push_back((float)x);
+    pass->normals.push_back((float)y);
+    pass->normals.push_back((float)z);
+}
+
+void StreamTexcoord(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    pass->texcoords.push_back((float)x);
+    pass->texcoords.push_back((float)y);
+}
+
+void StreamFace(void* user_data, tinyobj::index_t* indices, int num_indices)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    if (!pass->error.empty() || num_indices < 3)
+        return;
+
+    // Os índices do leque são validados antes de qualquer vértice ser emitido.
+    uint32_t corners[3];
+    int      corner_positions[3];
+    int      fixed[3];
+    for (int corner = 0; corner < num_indices; ++corner)
+    {
+        const tinyobj::index_t& index = indices[corner];
+        if (!FixIndex(index.vertex_index, pass->positions.size() / 3, &fixed[0]) || fixed[0] < 0
+            || !FixIndex(index.normal_index, pass->normals.size() / 3, &fixed[1])
+            || !FixIndex(index.texcoord_index, pass->texcoords.size() / 2, &fixed[2]))
+        {
+            pass->error = "face index out of range";
+            return;
+        }
+    }
+
+    if (!pass->shape_open)
+    {
+        if (pass->name.empty())
+        {
+            pass->error = "face outside of a named object";
+            return;
+        }
+        MeshShape shape;
+        shape.name        = pass->name;
+        shape.first_index = (uint32_t)pass->num_indices;
+        shape.num_indices = 0;
+        shape.material_id = pass->material_id;
+        pass->model->mesh.shapes.push_back(shape);
+
+        pass->model->shape_bboxes.push_back(BoundingBox());
+        pass->shape_open = true;
+    }
+
+    BoundingBox& box = pass->model->shape_bboxes.back();
+    bool first_face = pass->num_indices == pass->model->mesh.shapes.back().first_index;
+    for (int corner = 0; corner < num_indices; ++corner)
+    {
+        const tinyobj::index_t& index = indices[corner];
+        int position = -1, normal = -1, texcoord = -1;
+        FixIndex(index.vertex_index, pass->positions.size() / 3, &position);
+        FixIndex(index.normal_index, pass->normals.size() / 3, &normal);
+        FixIndex(index.texcoord_index, pass->texcoords.size() / 2, &texcoord);
+
+        glm::vec3 p(pass->positions[3 * position], pass->positions[3 * position + 1], pass->positions[3 * position + 2]);
+        if (first_face && corner == 0)
+        {
+            box.min = p;
+            box.max = p;
+        }
+        box.min = glm::min(box.min, p);
+        box.max = glm::max(box.max, p);
+
+        // Triangulação em leque: (0, 1, 2), (0, 2, 3), ...
+        uint32_t vertex = EmitVertex(pass, position, normal, texcoord);
+        if (corner < 3)
+        {
+            corners[corner] = vertex;
+            corner_positions[corner] = position;
+        }
+        else
+        {
+            corners[1] = corners[2];
+            corners[2] = vertex;
+            corner_positions[1] = corner_positions[2];
+            corner_positions[2] = position;
+        }
+        if (corner >= 2)
+        {
+            EmitIndex(pass, corners[0]);
+            EmitIndex(pass, corners[1]);
+            EmitIndex(pass, corners[2]);
+            if (pass->generate_normals)
+                AccumulateFaceNormal(pass, corner_positions);
+        }
+    }
+}
+
+void StreamUsemtl(void* user_data, const char*, int material_id)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    pass->material_id = material_id;
+
+    // Como em BuildMeshData(), o material do shape é o da sua primeira face.
+    if (pass->shape_open && pass->num_indices == pass->model->mesh.shapes.back().first_index)
+        pass->model->mesh.shapes.back().material_id = material_id;
+}
+
+void StreamMtllib(void* user_data, const tinyobj::material_t* materials, int num_materials)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    pass->model->materials.assign(materials, materials + num_materials);
+}
+
+void StreamGroup(void* user_data, const char** names, int num_names)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    CloseShape(pass);
+
+    // Mesmo nome que tinyobj::LoadObj() dá ao shape: os nomes do "g" separados
+    // por espaço.
+    pass->name.clear();
+    for (int i = 0; i < num_names; ++i)
+    {
+        if (i > 0)
+            pass->name += ' ';
+        pass->name += names[i];
+    }
+}
+
+void StreamObject(void* user_data, const char* name)
+{
+    StreamPass* pass = (StreamPass*)user_data;
+    CloseShape(pass);
+    pass->name = name != NULL ? name : "";
+}
+
+std::string Dirname(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash != std::string::npos ? path.substr(0, slash + 1) : std::string();
+}
+
+template <typename T>
+size_t VectorBytes(const std::vector<T>& values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+} // namespace
+
+bool ShouldStreamObj(const char* filename)
+{
+    size_t length = strlen(filename);
+    if (length < 4 || strcmp(filename + length - 4, ".obj") != 0)
+        return false;
+
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    return file && (long long)file.tellg() >= (long long)OBJ_STREAM_MIN_FILE_SIZE;
+}
+
+ObjModel* StreamObjToArena(const char* filename, VertexFormat format, MeshAllocation* allocation, std::string* err)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        *err = "cannot open file";
+        return NULL;
+    }
+
+    CountPass count;
+    tinyobj::callback_t count_callbacks;
+    count_callbacks.vertex_cb   = CountVertex;
+    count_callbacks.normal_cb   = CountNormal;
+    count_callbacks.texcoord_cb = CountTexcoord;
+    count_callbacks.index_cb    = CountFace;
+    std::string warn;
+    if (!tinyobj::LoadObjWithCallback(file, count_callbacks, &count, NULL, &warn, err))
+        return NULL;
+    if (count.indices == 0)
+    {
+        *err = "no faces";
+        return NULL;
+    }
+
+    ObjModel* model = new ObjModel();
+    model->filename      = filename;
+    model->vertex_format = format;
+
+    MeshData& mesh = model->mesh;
+    mesh.vertex_format = format;
+    mesh.has_normals   = true; // Calculadas abaixo se o arquivo não tiver
+    mesh.has_texcoords = count.texcoords > 0;
+    mesh.index_size    = count.corners < 65536 ? 2 : 4;
+    if (format == VERTEX_FORMAT_COMPACT)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            mesh.position_offset[i] = count.minimum[i];
+            mesh.position_scale[i]  = count.maximum[i] - count.minimum[i];
+        }
+    }
+    model->bbox.min = glm::vec3(count.minimum[0], count.minimum[1], count.minimum[2]);
+    model->bbox.max = glm::vec3(count.maximum[0], count.maximum[1], count.maximum[2]);
+
+    // Cada canto de face vira no máximo um vértice.
+    StreamPass pass;
+    pass.model      = model;
+    pass.allocation = allocation;
+    pass.format     = format;
+    pass.stride     = VertexFormatStride(format);
+    pass.index_size = mesh.index_size;
+    pass.generate_normals = count.normals == 0;
+    *allocation = MeshArena_Allocate(format, count.corners * pass.stride, count.indices * mesh.index_size,
+                                     mesh.index_size);
+
+    pass.positions.reserve(3 * count.positions);
+    pass.normals.reserve(3 * count.normals);
+    pass.texcoords.reserve(2 * count.texcoords);
+    if (pass.generate_normals)
+    {
+        pass.position_normals.assign(3 * count.positions, 0.0f);
+        pass.deferred.reserve(2 * count.corners);
+    }
+    CachedVertex empty = { -2, -2, -2, 0 };
+    pass.cache.assign(VERTEX_CACHE_SIZE, empty);
+    pass.vertex_block.resize(OBJ_STREAM_BLOCK_VERTICES * pass.stride);
+    pass.index_block.resize(OBJ_STREAM_BLOCK_INDICES * mesh.index_size);
+
+    tinyobj::callback_t callbacks;
+    callbacks.vertex_cb   = StreamVertex;
+    callbacks.normal_cb   = StreamNormal;
+    callbacks.texcoord_cb = StreamTexcoord;
+    callbacks.index_cb    = StreamFace;
+    callbacks.usemtl_cb   = StreamUsemtl;
+    callbacks.mtllib_cb   = StreamMtllib;
+    callbacks.group_cb    = StreamGroup;
+    callbacks.object_cb   = StreamObject;
+    tinyobj::MaterialFileReader material_reader(Dirname(filename));
+
+    file.clear();
+    file.seekg(0);
+    warn.clear();
+    bool ok = tinyobj::LoadObjWithCallback(file, callbacks, &pass, &material_reader, &warn, err);
+    if (ok && !pass.error.empty())
+    {
+        *err = pass.error;
+        ok = false;
+    }
+    if (!ok)
+    {
+        MeshArena_Free(*allocation);
+        *allocation = MeshAllocation();
+        delete model;
+        return NULL;
+    }
+
+    if (pass.generate_normals)
+        EncodeDeferredVertices(&pass);
+    FlushVertices(&pass);
+    FlushIndices(&pass);
+    CloseShape(&pass);
+    MeshArena_Shrink(allocation, pass.num_vertices * pass.stride, pass.num_indices * mesh.index_size);
+
+    for (size_t shape = 0; shape < mesh.shapes.size(); ++shape)
+        printf("- Objeto '%s'\n", mesh.shapes[shape].name.c_str());
+
+    size_t peak = VectorBytes(pass.positions) + VectorBytes(pass.normals) + VectorBytes(pass.texcoords)
+                + VectorBytes(pass.cache) + VectorBytes(pass.vertex_block) + VectorBytes(pass.index_block)
+                + VectorBytes(pass.position_normals) + VectorBytes(pass.deferred);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Modelo \"%s\" lido em fluxo em %.2f ms: %zu vértices (de %zu cantos), %zu índices, "
+           "%zu envio(s) à GPU, pico de %.1f MB em CPU%s\n",
+           filename, ms, pass.num_vertices, count.corners, pass.num_indices, pass.flushes,
+           (double)peak / (1024.0 * 1024.0), pass.generate_normals ? ", normais calculadas" : "");
+    return model;
+}
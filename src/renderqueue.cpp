@@ -0,0 +1,742 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "glstate.h"
+
+namespace {
+
+// Erro máximo, em pixels, aceito ao trocar um objeto por um nível de detalhe
+// mais simples.
+const float LOD_MAX_SCREEN_ERROR = 1.0f;
+
+// Capacidade inicial do buffer de instâncias, em instâncias.
+const size_t INITIAL_INSTANCE_CAPACITY = 256;
+
+// Pontos de ligação dos blocos de uniforms (veja "renderqueue.h").
+const GLuint FRAME_BLOCK_BINDING    = 0;
+const GLuint MATERIAL_BLOCK_BINDING = 1;
+const GLuint DRAW_BLOCK_BINDING     = 2;
+
+// Blocos de uniforms, com o layout std140 de "shader_vertex.glsl".
+struct FrameBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 camera_position;
+    glm::vec4 light_direction;
+    glm::vec4 light_color;
+    glm::vec4 ambient_color;
+};
+
+struct MaterialBlock
+{
+    glm::vec4 Kd;
+    glm::vec4 Ka;
+    glm::vec4 Ks; // w = q
+};
+
+struct DrawBlock
+{
+    int32_t   material_index; // Posição na tabela de materiais
+    int32_t   material_id;
+    int32_t   lighting_model;
+    int32_t   pad0;
+    glm::vec3 position_offset;
+    float     pad1;
+    glm::vec3 position_scale;
+    float     pad2;
+};
+
+// Dados de uma instância no buffer de instâncias, lidos pelo Vertex Shader
+// (veja "shader_vertex.glsl"): a matriz "model" nas locations 3 a 6, uma
+// coluna por location, e (object_id, camada da textura) na location 7.
+struct InstanceData
+{
+    float   model[16];
+    int32_t object_id;
+    int32_t texture_layer;
+    int32_t pad[2]; // Mantém as instâncias alinhadas em 16 bytes
+};
+
+// Pacote com o objeto e o material já resolvidos.
+struct QueuedDraw
+{
+    const SceneObject*         object;
+    uint32_t                   object_index; // Posição do objeto na cena, para a chave
+    const RenderProgram*       program;
+    const tinyobj::material_t* material;       // NULL se não houver
+    uint32_t                   material_index; // Posição de "material" na tabela de materiais
+    int                        material_id;
+    TextureLayer               texture;
+    glm::mat4                  model;
+    int                        object_id;
+    int                        lighting_model;
+    RenderPass                 pass;
+
+    // Preenchidos em RenderQueue_Flush(), na escolha do nível de detalhe.
+    size_t                     first_index;
+    size_t                     num_indices;
+    bool                       meshlets; // Desenhado por DrawVisibleMeshlets()
+};
+
+// Pacotes seguidos que viram uma única chamada de desenho: as posições
+// [first, first + count) de g_Order, com as instâncias na mesma ordem no
+// buffer de instâncias.
+struct DrawBatch
+{
+    size_t first;
+    size_t count;
+    size_t draw_offset; // Registro do bloco DrawData no buffer de registros
+};
+
+// Estado do OpenGL conhecido pela fila. "valid" = false quando o valor é
+// desconhecido (no começo de RenderQueue_Flush()).
+struct BoundState
+{
+    const RenderProgram*       program;
+    int                        cull_face; // -1 = desconhecido
+    GLuint                     vao;
+    bool                       vao_valid;
+    int                        array;
+    GLuint                     instance_vao;    // VAO cujos atributos de instância apontam para
+    size_t                     instance_offset; // este deslocamento do buffer de instâncias
+    bool                       instance_valid;
+    size_t                     draw_offset;     // Registro ligado ao bloco DrawData
+    bool                       draw_valid;
+};
+
+glm::mat4   g_View(1.0f);
+glm::mat4   g_Projection(1.0f);
+float       g_ScreenHeight = 1.0f;
+RenderLight g_Light;
+
+std::vector<QueuedDraw> g_Draws;
+std::vector<uint64_t>   g_Keys;
+std::vector<uint32_t>   g_Order;
+std::vector<uint64_t>   g_SortKeys;  // Auxiliares do radix sort
+std::vector<uint32_t>   g_SortOrder;
+std::vector<DrawBatch>  g_Batches;
+
+// Intervalos de índices dos meshlets visíveis de um desenho, para
+// glMultiDrawElementsBaseVertex(). Refeitos em cada DrawVisibleMeshlets().
+std::vector<GLsizei>     g_MeshletCounts;
+std::vector<const void*> g_MeshletOffsets;
+std::vector<GLint>       g_MeshletBaseVertices;
+
+std::vector<InstanceData> g_Instances;
+GLuint                    g_InstanceBuffer = 0;
+size_t                    g_InstanceCapacity = 0; // Em instâncias
+std::vector<GLuint>       g_InstancedVaos;        // VAOs com os atributos de instância já ligados
+
+GLuint                    g_FrameBuffer = 0;
+GLuint                    g_DrawBuffer = 0;
+size_t                    g_DrawCapacity = 0;     // Em bytes
+size_t                    g_DrawStride = 0;       // DrawBlock alinhado a GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+std::vector<unsigned char> g_DrawRecords;
+
+// Tabela de materiais. A posição 0 é a de "sem material"; as outras são
+// dadas aos materiais na ordem em que aparecem e reusadas quando eles saem.
+GLuint                                                   g_MaterialBuffer = 0;
+std::vector<MaterialBlock>                               g_MaterialTable;
+std::unordered_map<const tinyobj::material_t*, uint32_t> g_MaterialIndices;
+std::vector<uint32_t>                                    g_FreeMaterialIndices;
+uint32_t                                                 g_NextMaterialIndex = 1;
+bool                                                     g_MaterialTableDirty = false;
+
+// Posições pequenas e estáveis para os campos da chave. Os programas e VAOs
+// são poucos; os materiais usam a posição na tabela de materiais. Posições
+// além do número de bits do campo só pioram o agrupamento, não o resultado.
+std::vector<GLuint> g_ProgramRanks;
+std::vector<GLuint> g_VaoRanks;
+
+RenderQueueStats g_Stats;
+BoundState       g_State;
+
+uint32_t Rank(std::vector<GLuint>& ranks, GLuint value)
+{
+    for (size_t i = 0; i < ranks.size(); ++i)
+        if (ranks[i] == value)
+            return (uint32_t)i;
+    ranks.push_back(value);
+    return (uint32_t)ranks.size() - 1;
+}
+
+void InitBuffers()
+{
+    if (g_FrameBuffer != 0)
+        return;
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    g_DrawStride = (sizeof(DrawBlock) + alignment - 1) / alignment * alignment;
+
+    g_MaterialTable.resize(RENDER_MAX_MATERIALS);
+    memset(g_MaterialTable.data(), 0, g_MaterialTable.size() * sizeof(MaterialBlock));
+
+    glGenBuffers(1, &g_FrameBuffer);
+    GLState_BindBuffer(GL_UNIFORM_BUFFER, g_FrameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_STREAM_DRAW);
+    GLState_BindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, g_FrameBuffer, 0, 0);
+
+    glGenBuffers(1, &g_MaterialBuffer);
+    GLState_BindBuffer(GL_UNIFORM_BUFFER, g_MaterialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, g_MaterialTable.size() * sizeof(MaterialBlock), g_MaterialTable.data(), GL_STATIC_DRAW);
+    GLState_BindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, g_MaterialBuffer, 0, 0);
+
+    glGenBuffers(1, &g_DrawBuffer);
+}
+
+void UploadMaterialTable()
+{
+    GLState_BindBuffer(GL_UNIFORM_BUFFER, g_MaterialBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, g_MaterialTable.size() * sizeof(MaterialBlock), g_MaterialTable.data());
+    g_MaterialTableDirty = false;
+}
+
+// Posição do material na tabela, pondo-o lá se ainda não estiver.
+uint32_t MaterialIndex(const tinyobj::material_t* material)
+{
+    if (material == NULL)
+        return 0;
+    std::unordered_map<const tinyobj::material_t*, uint32_t>::const_iterator it = g_MaterialIndices.find(material);
+    if (it != g_MaterialIndices.end())
+        return it->second;
+
+    InitBuffers();
+    uint32_t index = 0;
+    if (!g_FreeMaterialIndices.empty())
+    {
+        index = g_FreeMaterialIndices.back();
+        g_FreeMaterialIndices.pop_back();
+    }
+    else if (g_NextMaterialIndex < RENDER_MAX_MATERIALS)
+        index = g_NextMaterialIndex++;
+    else
+        fprintf(stderr, "WARNING: Material table is full (%d materials), material \"%s\" is drawn without material.\n",
+                RENDER_MAX_MATERIALS, material->name.c_str());
+
+    // Um material que não coube fica com a posição 0, para o aviso sair uma
+    // vez só.
+    g_MaterialIndices[material] = index;
+    if (index == 0)
+        return 0;
+
+    MaterialBlock& entry = g_MaterialTable[index];
+    entry.Kd = glm::vec4(material->diffuse[0], material->diffuse[1], material->diffuse[2], 0.0f);
+    entry.Ka = glm::vec4(material->ambient[0], material->ambient[1], material->ambient[2], 0.0f);
+    entry.Ks = glm::vec4(material->specular[0], material->specular[1], material->specular[2], material->shininess);
+    g_MaterialTableDirty = true;
+    return index;
+}
+
+// Os 16 bits mais altos de um float positivo crescem com o valor.
+uint32_t DepthBits(float depth)
+{
+    depth = std::max(depth, 0.0f);
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> 16;
+}
+
+uint64_t BuildKey(const QueuedDraw& draw)
+{
+    const SceneObject& obj = *draw.object;
+    glm::vec4 center = g_View * draw.model * glm::vec4(obj.bounding_center, 1.0f);
+
+    uint64_t key = 0;
+    key |= (uint64_t)(draw.pass & 0xf) << 60;
+    key |= (uint64_t)(Rank(g_ProgramRanks, draw.program->id) & 0x3f) << 54;
+    key |= (uint64_t)((draw.texture.array + 1) & 0xff) << 46;
+    key |= (uint64_t)(Rank(g_VaoRanks, obj.vertex_array_object_id) & 0x3f) << 40;
+    key |= (uint64_t)(draw.material_index & 0x3fff) << 26;
+    key |= (uint64_t)(draw.object_index & 0x3ff) << 16;
+    key |= (uint64_t)DepthBits(-center.z);
+    return key;
+}
+
+// Radix sort LSD de g_Keys, 8 bits por passada; g_Order recebe a ordem. Os
+// bytes iguais em todas as chaves são pulados.
+void SortKeys()
+{
+    size_t count = g_Keys.size();
+    g_Order.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        g_Order[i] = (uint32_t)i;
+    g_SortKeys.resize(count);
+    g_SortOrder.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256] = { 0 };
+        for (size_t i = 0; i < count; ++i)
+            histogram[(g_Keys[i] >> shift) & 0xff]++;
+        if (count == 0 || histogram[(g_Keys[0] >> shift) & 0xff] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int b = 0; b < 256; ++b)
+        {
+            size_t n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t position = histogram[(g_Keys[i] >> shift) & 0xff]++;
+            g_SortKeys[position]  = g_Keys[i];
+            g_SortOrder[position] = g_Order[i];
+        }
+        g_Keys.swap(g_SortKeys);
+        g_Order.swap(g_SortOrder);
+    }
+}
+
+// Liga o estado do pacote e o registro "draw_offset" do bloco DrawData, só
+// onde mudam. Os blocos ficam ligados a pontos fixos, então trocar de
+// programa não obriga a enviar nada de novo.
+void BindState(const QueuedDraw& draw, size_t draw_offset)
+{
+    if (g_State.program != draw.program)
+    {
+        GLState_UseProgram(draw.program->id);
+        g_State.program = draw.program;
+        g_Stats.state_changes++;
+    }
+
+    int cull_face = draw.pass == RENDER_PASS_OPAQUE ? 1 : 0;
+    if (g_State.cull_face != cull_face)
+    {
+        GLState_SetEnabled(GL_CULL_FACE, cull_face != 0);
+        g_State.cull_face = cull_face;
+        g_Stats.state_changes++;
+    }
+
+    const SceneObject& obj = *draw.object;
+    if (!g_State.vao_valid || g_State.vao != obj.vertex_array_object_id)
+    {
+        GLState_BindVertexArray(obj.vertex_array_object_id);
+        g_State.vao = obj.vertex_array_object_id;
+        g_State.vao_valid = true;
+        g_Stats.state_changes++;
+    }
+
+    // Como todas as texturas estão em arrays, trocar de material só troca a
+    // camada; a textura ligada só muda quando o array muda.
+    if (draw.texture.array >= 0 && g_State.array != draw.texture.array)
+    {
+        TextureArrays_Bind(draw.texture.array);
+        g_State.array = draw.texture.array;
+        g_Stats.state_changes++;
+    }
+
+    if (!g_State.draw_valid || g_State.draw_offset != draw_offset)
+    {
+        GLState_BindBufferRange(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, g_DrawBuffer, draw_offset, sizeof(DrawBlock));
+        g_State.draw_offset = draw_offset;
+        g_State.draw_valid = true;
+        g_Stats.uniforms++;
+    }
+}
+
+// Aponta os atributos de instância do VAO ligado para a instância de número
+// "first_instance" do buffer de instâncias. O OpenGL 3.3 não tem
+// glDrawElementsInstancedBaseInstance(), então cada grupo troca o
+// deslocamento dos atributos.
+void BindInstances(size_t first_instance)
+{
+    size_t offset = first_instance * sizeof(InstanceData);
+    if (g_State.instance_valid && g_State.instance_vao == g_State.vao && g_State.instance_offset == offset)
+        return;
+
+    bool configured = std::find(g_InstancedVaos.begin(), g_InstancedVaos.end(), g_State.vao) != g_InstancedVaos.end();
+
+    GLState_BindBuffer(GL_ARRAY_BUFFER, g_InstanceBuffer);
+    GLsizei stride = (GLsizei)sizeof(InstanceData);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + column * 4 * sizeof(float)));
+        if (!configured)
+        {
+            glVertexAttribDivisor(3 + column, 1);
+            glEnableVertexAttribArray(3 + column);
+        }
+    }
+    glVertexAttribIPointer(7, 2, GL_INT, stride, (void*)(offset + offsetof(InstanceData, object_id)));
+    if (!configured)
+    {
+        glVertexAttribDivisor(7, 1);
+        glEnableVertexAttribArray(7);
+        g_InstancedVaos.push_back(g_State.vao);
+    }
+
+    g_State.instance_vao    = g_State.vao;
+    g_State.instance_offset = offset;
+    g_State.instance_valid  = true;
+    g_Stats.state_changes++;
+}
+
+// Desenha só os meshlets do objeto que estão dentro do frustum e que não estão
+// inteiramente de costas para a câmera, com uma única chamada. Meshlets
+// visíveis consecutivos viram um único intervalo de índices.
+void DrawVisibleMeshlets(const QueuedDraw& draw, const DrawBatch& batch)
+{
+    const SceneObject& obj = *draw.object;
+
+    // Planos do frustum no espaço do modelo (Gribb & Hartmann): um ponto p
+    // está dentro se -w <= x, y, z <= w, com (x, y, z, w) = MVP * p.
+    glm::mat4 view_model = g_View * draw.model;
+    glm::mat4 mvp = g_Projection * view_model;
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2],
+    };
+    for (int p = 0; p < 6; ++p)
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+
+    // O teste de costas só vale com o descarte de faces ligado e sem
+    // espelhamento, que inverteria a orientação dos triângulos.
+    bool backface_culling = draw.pass == RENDER_PASS_OPAQUE && glm::determinant(glm::mat3(view_model)) > 0.0f;
+    glm::vec3 camera = glm::vec3(glm::inverse(view_model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+    size_t index_size = obj.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+    std::vector<GLsizei>&     counts        = g_MeshletCounts;
+    std::vector<const void*>& offsets       = g_MeshletOffsets;
+    std::vector<GLint>&       base_vertices = g_MeshletBaseVertices;
+    counts.clear();
+    offsets.clear();
+    base_vertices.clear();
+
+    size_t next_index = 0;
+    for (size_t m = 0; m < obj.meshlets.size(); ++m)
+    {
+        const Meshlet& meshlet = obj.meshlets[m];
+        glm::vec3 center = glm::make_vec3(meshlet.center);
+
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; ++p)
+            visible = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -meshlet.radius;
+
+        if (visible && backface_culling)
+        {
+            glm::vec3 direction = center - camera;
+            visible = glm::dot(direction, glm::make_vec3(meshlet.cone_axis))
+                    < meshlet.cone_cutoff * glm::length(direction) + meshlet.radius;
+        }
+
+        if (!visible)
+            continue;
+
+        if (!counts.empty() && next_index == meshlet.first_index)
+            counts.back() += meshlet.num_indices;
+        else
+        {
+            counts.push_back(meshlet.num_indices);
+            offsets.push_back((const void*)(meshlet.first_index * index_size));
+            base_vertices.push_back(obj.base_vertex);
+        }
+        next_index = meshlet.first_index + meshlet.num_indices;
+    }
+
+    if (counts.empty())
+        return;
+
+    BindState(draw, batch.draw_offset);
+    BindInstances(batch.first);
+    glMultiDrawElementsBaseVertex(obj.rendering_mode, counts.data(), obj.index_type,
+                                  offsets.data(), (GLsizei)counts.size(), base_vertices.data());
+    g_Stats.draws++;
+}
+
+// Escolhe o intervalo de índices do pacote e se ele é desenhado por meshlets.
+void SelectLod(QueuedDraw& draw)
+{
+    const SceneObject& obj = *draw.object;
+
+    draw.first_index = obj.first_index;
+    draw.num_indices = obj.num_indices;
+    if (!obj.lods.empty())
+    {
+        // Projeta o erro de cada nível na tela, usando a parte da esfera
+        // envolvente mais próxima da câmera, e escolhe o nível mais simples
+        // cujo erro fica abaixo de LOD_MAX_SCREEN_ERROR pixels.
+        const glm::mat4& model = draw.model;
+        float scale = std::max(glm::length(glm::vec3(model[0])),
+                      std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        glm::vec4 center = g_View * model * glm::vec4(obj.bounding_center, 1.0f);
+        float distance = std::max(-center.z - obj.bounding_radius * scale, 0.1f);
+        float pixels_per_unit = std::abs(g_Projection[1][1]) * g_ScreenHeight / (2.0f * distance);
+
+        for (size_t l = 0; l < obj.lods.size(); ++l)
+        {
+            if (obj.lods[l].error * scale * pixels_per_unit > LOD_MAX_SCREEN_ERROR)
+                break;
+            draw.first_index = obj.lods[l].first_index;
+            draw.num_indices = obj.lods[l].num_indices;
+        }
+    }
+
+    // No nível 0, objetos divididos em meshlets são desenhados por partes.
+    draw.meshlets = draw.first_index == obj.first_index && !obj.meshlets.empty();
+}
+
+// true se "b" pode ser desenhado na mesma chamada instanciada que "a": mesmos
+// índices e mesmo estado, exceto o que vai no buffer de instâncias.
+bool CanBatch(const QueuedDraw& a, const QueuedDraw& b)
+{
+    return !a.meshlets && !b.meshlets
+        && a.object == b.object
+        && a.first_index == b.first_index
+        && a.num_indices == b.num_indices
+        && a.program == b.program
+        && a.pass == b.pass
+        && a.material_index == b.material_index
+        && a.material_id == b.material_id
+        && a.lighting_model == b.lighting_model
+        && a.texture.array == b.texture.array;
+}
+
+// Envia as instâncias do quadro, reaproveitando o buffer quando cabem.
+void UploadInstances()
+{
+    if (g_InstanceBuffer == 0)
+        glGenBuffers(1, &g_InstanceBuffer);
+
+    GLState_BindBuffer(GL_ARRAY_BUFFER, g_InstanceBuffer);
+    if (g_Instances.size() > g_InstanceCapacity)
+    {
+        g_InstanceCapacity = std::max(g_InstanceCapacity * 2, INITIAL_INSTANCE_CAPACITY);
+        while (g_InstanceCapacity < g_Instances.size())
+            g_InstanceCapacity *= 2;
+    }
+    // Descarta o conteúdo do quadro anterior para não esperar a GPU terminar
+    // de lê-lo.
+    glBufferData(GL_ARRAY_BUFFER, g_InstanceCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, g_Instances.size() * sizeof(InstanceData), g_Instances.data());
+}
+
+// Acrescenta o registro do bloco DrawData do pacote, ou reusa o último se for
+// igual, e retorna o seu deslocamento no buffer de registros.
+size_t AddDrawRecord(const QueuedDraw& draw)
+{
+    DrawBlock block;
+    memset(&block, 0, sizeof(block));
+    block.material_index  = (int32_t)draw.material_index;
+    block.material_id     = draw.material_id;
+    block.lighting_model  = draw.lighting_model;
+    block.position_offset = draw.object->position_offset;
+    block.position_scale  = draw.object->position_scale;
+
+    size_t size = g_DrawRecords.size();
+    if (size > 0 && memcmp(&g_DrawRecords[size - g_DrawStride], &block, sizeof(block)) == 0)
+        return size - g_DrawStride;
+
+    g_DrawRecords.resize(size + g_DrawStride, 0);
+    memcpy(&g_DrawRecords[size], &block, sizeof(block));
+    return size;
+}
+
+// Envia os registros do bloco DrawData do quadro, como UploadInstances().
+void UploadDrawRecords()
+{
+    GLState_BindBuffer(GL_UNIFORM_BUFFER, g_DrawBuffer);
+    if (g_DrawRecords.size() > g_DrawCapacity)
+    {
+        g_DrawCapacity = std::max(g_DrawCapacity * 2, 64 * g_DrawStride);
+        while (g_DrawCapacity < g_DrawRecords.size())
+            g_DrawCapacity *= 2;
+    }
+    glBufferData(GL_UNIFORM_BUFFER, g_DrawCapacity, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, g_DrawRecords.size(), g_DrawRecords.data());
+}
+
+void Draw(const DrawBatch& batch)
+{
+    const QueuedDraw& draw = g_Draws[g_Order[batch.first]];
+    const SceneObject& obj = *draw.object;
+
+    if (draw.meshlets)
+    {
+        DrawVisibleMeshlets(draw, batch);
+        return;
+    }
+
+    BindState(draw, batch.draw_offset);
+    BindInstances(batch.first);
+    size_t index_size = obj.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    if (batch.count == 1)
+        glDrawElementsBaseVertex(obj.rendering_mode, (GLsizei)draw.num_indices, obj.index_type,
+                                 (void*)(draw.first_index * index_size), obj.base_vertex);
+    else
+        glDrawElementsInstancedBaseVertex(obj.rendering_mode, (GLsizei)draw.num_indices, obj.index_type,
+                                          (void*)(draw.first_index * index_size), (GLsizei)batch.count,
+                                          obj.base_vertex);
+    g_Stats.draws++;
+}
+
+} // namespace
+
+void RenderQueue_Begin(const glm::mat4& view, const glm::mat4& projection, float screen_height,
+                       const RenderLight& light)
+{
+    g_View         = view;
+    g_Projection   = projection;
+    g_ScreenHeight = screen_height;
+    g_Light        = light;
+    g_Draws.clear();
+}
+
+void RenderQueue_Submit(const RenderPacket& packet)
+{
+    const SceneObject* obj = Scene_Get(packet.object);
+    if (obj == NULL || packet.program == NULL)
+        return;
+
+    QueuedDraw draw;
+    draw.object         = obj;
+    draw.object_index   = packet.object.index;
+    draw.program        = packet.program;
+    draw.material       = packet.material;
+    draw.material_id    = -1;
+    draw.texture        = packet.texture.array >= 0 ? packet.texture : obj->texture;
+    draw.model          = packet.model;
+    draw.object_id      = packet.object_id;
+    draw.lighting_model = packet.lighting_model;
+    draw.pass           = packet.pass;
+    draw.first_index    = obj->first_index;
+    draw.num_indices    = obj->num_indices;
+    draw.meshlets       = false;
+
+    const ModelAsset* asset = Assets_GetModel(obj->model);
+    if (obj->material_id >= 0 && asset != NULL && obj->material_id < (int)asset->model->materials.size())
+    {
+        draw.material_id = obj->material_id;
+        if (draw.material == NULL)
+            draw.material = &asset->model->materials[obj->material_id];
+    }
+    draw.material_index = MaterialIndex(draw.material);
+    g_Draws.push_back(draw);
+}
+
+void RenderQueue_Flush()
+{
+    g_Stats = RenderQueueStats();
+    g_Stats.packets = g_Draws.size();
+
+    InitBuffers();
+    FrameBlock frame;
+    frame.view            = g_View;
+    frame.projection      = g_Projection;
+    frame.camera_position = glm::inverse(g_View) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    frame.light_direction = g_Light.direction;
+    frame.light_color     = glm::vec4(g_Light.color, 1.0f);
+    frame.ambient_color   = glm::vec4(g_Light.ambient, 1.0f);
+    GLState_BindBuffer(GL_UNIFORM_BUFFER, g_FrameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), &frame, GL_STREAM_DRAW);
+    g_Stats.uniforms++;
+
+    if (g_MaterialTableDirty)
+    {
+        UploadMaterialTable();
+        g_Stats.uniforms++;
+    }
+
+    g_Keys.resize(g_Draws.size());
+    for (size_t i = 0; i < g_Draws.size(); ++i)
+        g_Keys[i] = BuildKey(g_Draws[i]);
+    SortKeys();
+
+    // Agrupa os pacotes e monta as instâncias e os registros do bloco DrawData
+    // na ordem em que são desenhados.
+    g_Batches.clear();
+    g_DrawRecords.clear();
+    g_Instances.resize(g_Order.size());
+    for (size_t i = 0; i < g_Order.size(); ++i)
+    {
+        QueuedDraw& draw = g_Draws[g_Order[i]];
+        SelectLod(draw);
+
+        InstanceData& instance = g_Instances[i];
+        memcpy(instance.model, glm::value_ptr(draw.model), sizeof(instance.model));
+        instance.object_id     = draw.object_id;
+        instance.texture_layer = draw.texture.layer;
+        instance.pad[0] = instance.pad[1] = 0;
+
+        if (!g_Batches.empty() && CanBatch(g_Draws[g_Order[i - 1]], draw))
+            g_Batches.back().count++;
+        else
+        {
+            DrawBatch batch;
+            batch.first = i;
+            batch.count = 1;
+            batch.draw_offset = AddDrawRecord(draw);
+            g_Batches.push_back(batch);
+        }
+    }
+    if (!g_Instances.empty())
+    {
+        UploadInstances();
+        UploadDrawRecords();
+    }
+
+    g_State = BoundState();
+    g_State.program        = NULL;
+    g_State.cull_face      = -1;
+    g_State.vao_valid      = false;
+    g_State.array          = -1;
+    g_State.instance_valid = false;
+    g_State.draw_valid     = false;
+
+    for (size_t i = 0; i < g_Batches.size(); ++i)
+        Draw(g_Batches[i]);
+    g_Draws.clear();
+}
+
+void RenderQueue_InitProgram(GLuint program)
+{
+    static const char* const names[]    = { "FrameData", "MaterialTable", "DrawData" };
+    static const GLuint      bindings[] = { FRAME_BLOCK_BINDING, MATERIAL_BLOCK_BINDING, DRAW_BLOCK_BINDING };
+    for (int i = 0; i < 3; ++i)
+    {
+        GLuint block = glGetUniformBlockIndex(program, names[i]);
+        if (block != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, block, bindings[i]);
+    }
+}
+
+void RenderQueue_AddMaterials(const tinyobj::material_t* materials, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        MaterialIndex(&materials[i]);
+    if (g_MaterialTableDirty)
+        UploadMaterialTable();
+}
+
+void RenderQueue_RemoveMaterials(const tinyobj::material_t* materials, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::unordered_map<const tinyobj::material_t*, uint32_t>::iterator it = g_MaterialIndices.find(&materials[i]);
+        if (it == g_MaterialIndices.end())
+            continue;
+        if (it->second != 0)
+            g_FreeMaterialIndices.push_back(it->second);
+        g_MaterialIndices.erase(it);
+    }
+}
+
+const RenderQueueStats& RenderQueue_Stats()
+{
+    return g_Stats;
+}
@@ -0,0 +1,86 @@
+#include "scene.h"
+
+#include <map>
+
+namespace {
+
+std::vector<SceneObject>         g_Objects;     // Dados do desenho
+std::vector<uint32_t>            g_Generations; // Mesma posição de g_Objects
+std::vector<std::string>         g_Names;       // Idem; vazio = posição livre
+std::vector<uint32_t>            g_FreeObjects;
+std::map<std::string, uint32_t>  g_ObjectsByName;
+
+bool IsValid(SceneObjectHandle handle)
+{
+    return handle.generation != 0 && handle.index < g_Generations.size()
+        && g_Generations[handle.index] == handle.generation;
+}
+
+// Invalida os handles que apontam para a posição.
+void NextGeneration(uint32_t index)
+{
+    if (++g_Generations[index] == 0)
+        g_Generations[index] = 1;
+}
+
+} // namespace
+
+SceneObjectHandle Scene_Add(const std::string& name, const SceneObject& object)
+{
+    uint32_t index;
+    std::map<std::string, uint32_t>::const_iterator it = g_ObjectsByName.find(name);
+    if (it != g_ObjectsByName.end())
+    {
+        index = it->second;
+        NextGeneration(index);
+    }
+    else if (!g_FreeObjects.empty())
+    {
+        index = g_FreeObjects.back();
+        g_FreeObjects.pop_back();
+    }
+    else
+    {
+        index = (uint32_t)g_Objects.size();
+        g_Objects.push_back(SceneObject());
+        g_Generations.push_back(1);
+        g_Names.push_back(std::string());
+    }
+
+    g_Objects[index] = object;
+    g_Names[index]   = name;
+    g_ObjectsByName[name] = index;
+
+    SceneObjectHandle handle;
+    handle.index      = index;
+    handle.generation = g_Generations[index];
+    return handle;
+}
+
+SceneObjectHandle Scene_Find(const std::string& name)
+{
+    SceneObjectHandle handle;
+    std::map<std::string, uint32_t>::const_iterator it = g_ObjectsByName.find(name);
+    if (it == g_ObjectsByName.end())
+        return handle;
+    handle.index      = it->second;
+    handle.generation = g_Generations[it->second];
+    return handle;
+}
+
+const SceneObject* Scene_Get(SceneObjectHandle handle)
+{
+    return IsValid(handle) ? &g_Objects[handle.index] : NULL;
+}
+
+void Scene_Remove(SceneObjectHandle handle)
+{
+    if (!IsValid(handle))
+        return;
+
+    g_ObjectsByName.erase(g_Names[handle.index]);
+    g_Names[handle.index].clear();
+    g_Objects[handle.index] = SceneObject();
+    NextGeneration(handle.index);
+    g_FreeObjects.push_back(handle.index);
+}
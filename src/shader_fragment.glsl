@@ -13,10 +13,37 @@ in vec2 texcoords;
 // Cor calculada no vertex shader para Gouraud
 in vec3 gouraud_color;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Blocos de uniforms da fila de desenho, iguais aos de "shader_vertex.glsl"
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+    vec4 light_direction;
+    vec4 light_color;
+    vec4 ambient_color;
+};
+
+struct Material
+{
+    vec4 Kd;
+    vec4 Ka;
+    vec4 Ks; // w = expoente especular q
+};
+
+layout (std140) uniform MaterialTable
+{
+    Material materials[256];
+};
+
+layout (std140) uniform DrawData
+{
+    int  material_index;
+    int  material_id;    // ID do material do objeto atual
+    int  lighting_model; // Modelo de iluminação: 0 = Phong, 1 = Gouraud
+    vec3 position_offset;
+    vec3 position_scale;
+};
 
 // Identificador que define qual objeto está sendo desenhado no momento
 #define CHARACTER 0
@@ -30,43 +57,17 @@ uniform mat4 projection;
 #define ARCHER 3
 #define ARROW 4
 
-uniform int object_id;
-
-// ID do material do objeto atual
-uniform int material_id;
-
-// Modelo de iluminação: 0 = Phong, 1 = Gouraud
-uniform int lighting_model;
+flat in int object_id; // Da instância (veja "shader_vertex.glsl")
 
 // Parâmetros da axis-aligned bounding box (AABB) do modelo
 uniform vec4 bbox_min;
 uniform vec4 bbox_max;
 
-// Variáveis para acesso das imagens de textura
-uniform sampler2D TextureImage0;
-uniform sampler2D TextureImage1;
-uniform sampler2D TextureImage2;
-uniform sampler2D TextureImage3;
-uniform sampler2D TextureImage4;
-uniform sampler2D TextureImage5;
-uniform sampler2D TextureImage6;
-uniform sampler2D TextureImage7;
-uniform sampler2D TextureImage8;
-uniform sampler2D TextureImage9;
-uniform sampler2D TextureImage10;
-uniform sampler2D TextureImage11;
-uniform sampler2D TextureImage12;
-uniform sampler2D TextureImage13;
-uniform sampler2D TextureImage14;
-uniform sampler2D TextureImage15;
-uniform sampler2D TextureImage16;
-uniform sampler2D TextureImage17;
-
-// Variáveis para acesso às propriedades espectrais do objeto
-uniform vec3 Kd_uniform;
-uniform vec3 Ka_uniform;
-uniform vec3 Ks_uniform;
-uniform float q_uniform;
+// Todas as texturas ficam em arrays de texturas, agrupadas por tamanho (veja
+// "texturearray.h"). O código C++ liga o array do material atual e informa a
+// camada da textura, por instância; -1 quando o material não tem textura.
+uniform sampler2DArray TextureArray;
+flat in int texture_layer;
 
 // O valor de saída ("out") de um Fragment Shader é a cor final do fragmento.
 out vec4 color;
@@ -77,9 +78,6 @@ out vec4 color;
 
 void main()
 {
-    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-    vec4 camera_position = inverse(view) * origin;
-
     // O fragmento atual é coberto por um ponto que percente à superfície de um
     // dos objetos virtuais da cena. Este ponto, p, possui uma posição no
     // sistema de coordenadas global (World coordinates). Esta posição é obtida
@@ -91,9 +89,9 @@ void main()
     // normais de cada vértice.
     vec4 n = normalize(normal);
 
-    // Vetor que define o sentido da fonte de luz em relação ao ponto atual.
-    // Luz mais frontal e alta para reduzir sombras
-    vec4 l = normalize(vec4(0.2,1.0,1.0,0.0));
+    // Vetor que define o sentido da fonte de luz em relação ao ponto atual
+    // (veja a luz da cena em "main.cpp").
+    vec4 l = normalize(light_direction);
 
     // Vetor que define o sentido da câmera em relação ao ponto atual.
     vec4 v = normalize(camera_position - p);
@@ -119,80 +117,23 @@ void main()
         Ka = vec3(0.04,0.2,0.4);
         q = 32.0;
     }
-    else if (object_id == TARGET)
-    {
-        // Usa as propriedades do material MTL via uniformes
-        Kd = Kd_uniform;
-        Ka = Ka_uniform;
-        Ks = Ks_uniform;
-        q = q_uniform;
-        
-        // Aplica textura baseada no material ID
-        if (material_id == 0) {
-            texcolor = texture(TextureImage6, texcoords); // target-paper
-        } else if (material_id == 1) {
-            texcolor = texture(TextureImage7, texcoords); // wood_hinge
-        } else if (material_id == 2) {
-            texcolor = texture(TextureImage8, texcoords); // Styrofoam
-        } else if (material_id == 3) {
-            texcolor = texture(TextureImage9, texcoords); // Wood_stand
-        } else if (material_id == 4) {
-            texcolor = texture(TextureImage6, texcoords); // target-paper (repetido)
-        } else if (material_id == 5) {
-            texcolor = texture(TextureImage8, texcoords); // Styrofoam (repetido)
-        }
-        
-        // Mistura a textura com as propriedades do material
-        Kd = Kd * texcolor.rgb;
-    }
-    else if (object_id == ARCHER)
+    else if (object_id == TARGET || object_id == ARCHER || object_id == ARROW)
     {
-        // Usa as propriedades do material MTL via uniformes
-        Kd = Kd_uniform;
-        Ka = Ka_uniform;
-        Ks = Ks_uniform;
-        q = q_uniform;
+        // Usa as propriedades do material MTL, da tabela de materiais
+        Kd = materials[material_index].Kd.rgb;
+        Ka = materials[material_index].Ka.rgb;
+        Ks = materials[material_index].Ks.rgb;
+        q = materials[material_index].Ks.w;
         
-        // Aplica textura baseada no material ID
-        if (material_id == 0) { // CARA - OK
-            texcolor = texture(TextureImage13, texcoords);  
-        } else if (material_id == 1) { // Arco
-         texcolor = texture(TextureImage12, texcoords); 
-        } else if (material_id == 2) { // Cabelo do archer
-            texcolor = texture(TextureImage16, texcoords);  
-        } else if (material_id == 3) { // Membros inferiores do archer
-            texcolor = texture(TextureImage15, texcoords);
-        } else if (material_id == 4) { // Roupa do archer
-            texcolor = texture(TextureImage11, texcoords);  
-        } else if (material_id == 5) { // Corpo do archer
-          texcolor = texture(TextureImage14, texcoords); 
-        } else if (material_id == 6) { 
-          texcolor = texture(TextureImage10, texcoords); 
-        } else if (material_id == 7) { // Olhos do archer 
-            texcolor = texture(TextureImage10, texcoords); 
-        } else if (material_id == 8) { 
-            texcolor = texture(TextureImage11, texcoords); 
+        // Aplica a textura do material, uma única consulta qualquer que seja
+        // o material
+        if (texture_layer >= 0) {
+            texcolor = texture(TextureArray, vec3(texcoords, texture_layer));
         }
         
         // Mistura a textura com as propriedades do material
         Kd = Kd * texcolor.rgb;
     }
-    else if (object_id == ARROW)
-    {
-        // Usa as propriedades do material MTL via uniformes
-        Kd = Kd_uniform;
-        Ka = Ka_uniform;
-        Ks = Ks_uniform;
-        q = q_uniform;
-        
-        // Aplica textura baseada no material ID
-        if (material_id == 0) {
-            texcolor = texture(TextureImage17, texcoords); 
-        } 
-        
-        // Mistura a textura com as propriedades do material
-        Kd = Kd * texcolor.rgb;
-    }
     else if (
         object_id == PLANE_LEFT  || object_id == PLANE_RIGHT ||
         object_id == PLANE_TOP   || object_id == PLANE_BOTTOM ||
@@ -201,28 +142,23 @@ void main()
         vec2 uv;
         if (object_id == PLANE_LEFT) {
             uv = vec2(1.0 - texcoords.y, texcoords.x);
-            texcolor = texture(TextureImage0, uv);
         }
         else if (object_id == PLANE_RIGHT) {
             uv = vec2(texcoords.y, 1.0 - texcoords.x);
-            texcolor = texture(TextureImage1, uv);
         }
         else if (object_id == PLANE_BOTTOM) {
             uv = vec2(texcoords.x, 1.0 - texcoords.y);
-            texcolor = texture(TextureImage2, uv);
         }
         else if (object_id == PLANE_TOP) {
             uv = vec2(texcoords.x, texcoords.y);
-            texcolor = texture(TextureImage3, uv);
         }
         else if (object_id == PLANE_FRONT) {
             uv = vec2(texcoords.x, texcoords.y);
-            texcolor = texture(TextureImage4, uv);
         }
         else if (object_id == PLANE_BACK) {
             uv = vec2(1.0 - texcoords.x, 1.0 - texcoords.y);
-            texcolor = texture(TextureImage5, uv);
         }
+        texcolor = texture(TextureArray, vec3(uv, texture_layer));
 
         color.rgb = texcolor.rgb;
         color.a = 1.0;
@@ -240,10 +176,10 @@ void main()
     }
 
     // Espectro da fonte de iluminação
-    vec3 I = vec3(1.0,1.0,1.0); 
+    vec3 I = light_color.rgb;
 
     // Espectro da luz ambiente 
-    vec3 Ia = vec3(0.4,0.4,0.4); 
+    vec3 Ia = ambient_color.rgb;
 
     // Termo difuso utilizando a lei dos cossenos de Lambert
     vec3 lambert_diffuse_term = Kd*I*max(0.3,dot(n,l)); 
@@ -1,24 +1,62 @@
 #version 330 core
 
 // Atributos de vértice recebidos como entrada ("in") pelo Vertex Shader.
-// Veja a função BuildTrianglesAndAddToVirtualScene() em "main.cpp".
-layout (location = 0) in vec4 model_coefficients;
+// Veja a função BuildTrianglesAndAddToVirtualScene() em "main.cpp" e os
+// formatos de vértice em "mesh.h". No formato compacto a posição chega
+// normalizada em [0,1] (uint16) e a normal em [-1,1] (10 bits por
+// componente); a GPU faz essa conversão antes do shader.
+layout (location = 0) in vec3 position_coefficients;
 layout (location = 1) in vec4 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Atributos de cada instância (veja "renderqueue.h"): a matriz "model", em
+// quatro colunas (locations 3 a 6), e os parâmetros object_id e texture_layer
+// do objeto. Objetos repetidos são desenhados com uma única chamada, cada
+// instância com os seus valores.
+layout (location = 3) in mat4 instance_model;
+layout (location = 7) in ivec2 instance_parameters;
 
-// Modelo de iluminação: 0 = Phong, 1 = Gouraud
-uniform int lighting_model;
+// Blocos de uniforms preenchidos pela fila de desenho (veja "renderqueue.h"),
+// com o layout std140 das estruturas de "renderqueue.cpp". Os mesmos blocos
+// aparecem em "shader_fragment.glsl".
 
-// Propriedades do material para Gouraud
-uniform vec3 Kd_uniform;
-uniform vec3 Ka_uniform;
-uniform vec3 Ks_uniform;
-uniform float q_uniform;
+// Dados do quadro: matrizes computadas no código C++ e a luz da cena
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position; // Posição da câmera no sistema de coordenadas global
+    vec4 light_direction; // Sentido da fonte de luz (não precisa ser unitário)
+    vec4 light_color;     // Espectro da fonte de luz
+    vec4 ambient_color;   // Espectro da luz ambiente
+};
+
+// Propriedades de todos os materiais carregados. O tamanho do array é
+// RENDER_MAX_MATERIALS; a posição 0 é a de "sem material".
+struct Material
+{
+    vec4 Kd;
+    vec4 Ka;
+    vec4 Ks; // w = expoente especular q
+};
+
+layout (std140) uniform MaterialTable
+{
+    Material materials[256];
+};
+
+// Dados da chamada de desenho atual
+layout (std140) uniform DrawData
+{
+    int  material_index; // Posição do material em "materials"
+    int  material_id;     // ID do material no modelo
+    int  lighting_model;  // Modelo de iluminação: 0 = Phong, 1 = Gouraud
+
+    // Intervalo de quantização das posições da malha. No formato float,
+    // position_offset = (0,0,0) e position_scale = (1,1,1).
+    vec3 position_offset;
+    vec3 position_scale;
+};
 
 // Atributos de vértice que serão gerados como saída ("out") pelo Vertex Shader.
 // ** Estes serão interpolados pelo rasterizador! ** gerando, assim, valores
@@ -29,6 +67,10 @@ out vec4 normal;
 
 out vec2 texcoords;
 
+// Parâmetros da instância, iguais em todo o triângulo
+flat out int object_id;
+flat out int texture_layer;
+
 // Cor calculada no vertex shader para Gouraud
 out vec3 gouraud_color;
 
@@ -43,38 +85,41 @@ void main()
     // as coordenadas finais em NDC (variável gl_Position). Após a execução
     // deste Vertex Shader, a placa de vídeo (GPU) fará a divisão por W.
 
+    mat4 model = instance_model;
+    object_id = instance_parameters.x;
+    texture_layer = instance_parameters.y;
+
+    vec4 model_coefficients = vec4(position_offset + position_scale * position_coefficients, 1.0);
+
     gl_Position = projection * view * model * model_coefficients;
 
     // Posição do vértice atual no sistema de coordenadas global.
     position_world = model * model_coefficients;
 
     // Normal do vértice atual no sistema de coordenadas global.
-    normal = inverse(transpose(model)) * normal_coefficients;
+    normal = inverse(transpose(model)) * vec4(normal_coefficients.xyz, 0.0);
     normal.w = 0.0;
 
     texcoords = texture_coefficients;
 
     // Calcula iluminação Gouraud no vertex shader se necessário
     if (lighting_model == 1) {
-        vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-        vec4 camera_position = inverse(view) * origin;
-
         // Vetores para iluminação
         vec4 p = position_world;
         vec4 n = normalize(normal);
-        vec4 l = normalize(vec4(0.2, 1.0, 1.0, 0.0));
+        vec4 l = normalize(light_direction);
         vec4 v = normalize(camera_position - p);
         vec4 r = -l + 2*n*(dot(n,l));
 
         // Propriedades do material
-        vec3 Kd = Kd_uniform;
-        vec3 Ka = Ka_uniform;
-        vec3 Ks = Ks_uniform;
-        float q = q_uniform;
+        vec3 Kd = materials[material_index].Kd.rgb;
+        vec3 Ka = materials[material_index].Ka.rgb;
+        vec3 Ks = materials[material_index].Ks.rgb;
+        float q = materials[material_index].Ks.w;
 
         // Espectros de luz
-        vec3 I = vec3(1.0, 1.0, 1.0);
-        vec3 Ia = vec3(0.4, 0.4, 0.4);
+        vec3 I = light_color.rgb;
+        vec3 Ia = ambient_color.rgb;
 
         // Termos de iluminação
         vec3 lambert_diffuse_term = Kd * I * max(0.3, dot(n, l));
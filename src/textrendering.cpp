@@ -10,6 +10,7 @@
 
 #include "utils.h"
 #include "dejavufont.h"
+#include "glstate.h"
 
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
 
@@ -118,27 +119,26 @@ void TextRendering_Init()
     glCheckError();
 
     GLuint textureunit = 31;
-    glActiveTexture(GL_TEXTURE0 + textureunit);
-    glBindTexture(GL_TEXTURE_2D, texttexture_id);
+    GLState_BindTexture(textureunit, GL_TEXTURE_2D, texttexture_id);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, dejavufont.tex_width, dejavufont.tex_height, 0, GL_RED, GL_UNSIGNED_BYTE, dejavufont.tex_data);
-    glBindSampler(textureunit, sampler);
+    GLState_BindSampler(textureunit, sampler);
     glCheckError();
 
-    glBindVertexArray(textVAO);
+    GLState_BindVertexArray(textVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, textVBO);
     glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(0);
     glCheckError();
 
-    glUseProgram(textprogram_id);
+    GLState_UseProgram(textprogram_id);
     glUniform1i(texttex_uniform, textureunit);
-    glUseProgram(0);
+    GLState_UseProgram(0);
     glCheckError();
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState_BindVertexArray(0);
     glCheckError();
 }
 
@@ -152,6 +152,16 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
     float sx = scale / width;
     float sy = scale / height;
 
+    // O estado do texto é ligado uma vez para a string toda, não a cada
+    // caractere (veja "glstate.h").
+    GLState_SetEnabled(GL_BLEND, true);
+    GLState_BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState_PolygonMode(GL_FILL);
+    GLState_DepthFunc(GL_ALWAYS);
+    GLState_UseProgram(textprogram_id);
+    GLState_BindVertexArray(textVAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, textVBO);
+
     for (size_t i = 0; i < str.size(); i++)
     {
         // Find the glyph for the character we are looking for
@@ -187,28 +197,14 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
             { x1, y0, s1, t0 }
         };
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_ALWAYS);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
         glBufferSubData(GL_ARRAY_BUFFER, 0, 24 * sizeof(float), data);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        glUseProgram(textprogram_id);
-        glBindVertexArray(textVAO);
-
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDepthFunc(GL_LESS);
-
-        glDisable(GL_BLEND);
-
         x += (glyph->advance_x * sx);
     }
+
+    GLState_DepthFunc(GL_LESS);
+    GLState_SetEnabled(GL_BLEND, false);
 }
 
 float TextRendering_LineHeight(GLFWwindow* window)
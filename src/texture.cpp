@@ -0,0 +1,258 @@
+#include "texture.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TEXTURE_USE_SSE
+#endif
+
+namespace {
+
+// Tabelas de conversão entre sRGB (8 bits) e luz linear. A volta usa 65536
+// entradas, o que é mais do que suficiente para arredondar corretamente para
+// 8 bits.
+struct SrgbTables
+{
+    float         to_linear[256];
+    unsigned char from_linear[65536];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            float c = i / 255.0f;
+            to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 65536; ++i)
+        {
+            float l = i / 65535.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            from_linear[i] = (unsigned char)std::min(255.0f, c * 255.0f + 0.5f);
+        }
+    }
+};
+
+const SrgbTables& GetSrgbTables()
+{
+    static const SrgbTables tables; // Inicialização segura entre threads (C++11)
+    return tables;
+}
+
+// Pesos do filtro de tenda para uma dimensão: cada pixel de destino i é a
+// soma de weights[k] * fonte[first[i] + k - offsets[i]] para k no intervalo
+// [offsets[i], offsets[i+1]).
+struct FilterWeights
+{
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> offsets;
+    std::vector<float>    weights;
+};
+
+void ComputeFilterWeights(uint32_t source_size, uint32_t destination_size, FilterWeights* filter)
+{
+    float scale  = (float)source_size / destination_size;
+    float radius = std::max(scale, 1.0f);
+
+    filter->first.resize(destination_size);
+    filter->offsets.assign(1, 0);
+    filter->weights.clear();
+
+    for (uint32_t i = 0; i < destination_size; ++i)
+    {
+        float center = (i + 0.5f) * scale;
+        int   begin  = std::max(0, (int)std::floor(center - radius));
+        int   end    = std::min((int)source_size, (int)std::ceil(center + radius));
+
+        size_t start = filter->weights.size();
+        float  total = 0.0f;
+        for (int j = begin; j < end; ++j)
+        {
+            float weight = std::max(0.0f, 1.0f - std::fabs(j + 0.5f - center) / radius);
+            filter->weights.push_back(weight);
+            total += weight;
+        }
+        // Nas bordas as amostras de fora da imagem são descartadas e os pesos
+        // restantes renormalizados.
+        for (size_t k = start; k < filter->weights.size(); ++k)
+            filter->weights[k] /= total;
+
+        filter->first[i] = (uint32_t)begin;
+        filter->offsets.push_back((uint32_t)filter->weights.size());
+    }
+}
+
+// Converte uma linha de pixels sRGB para luz linear. O alfa já é linear e só
+// é levado para [0, 1].
+void LinearizeRow(const unsigned char* source, size_t count, uint32_t channels, float* destination)
+{
+    const SrgbTables& srgb = GetSrgbTables();
+    for (size_t i = 0; i < count; ++i)
+        destination[i] = channels == 4 && i % 4 == 3 ? source[i] / 255.0f : srgb.to_linear[source[i]];
+}
+
+// row[i] += weight * source[i] para i em [0, count).
+void AccumulateRow(float* row, const float* source, float weight, size_t count)
+{
+    size_t i = 0;
+#ifdef TEXTURE_USE_SSE
+    __m128 w = _mm_set1_ps(weight);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(row + i, _mm_add_ps(_mm_loadu_ps(row + i), _mm_mul_ps(w, _mm_loadu_ps(source + i))));
+#endif
+    for (; i < count; ++i)
+        row[i] += weight * source[i];
+}
+
+// Reduz uma imagem sRGB para destination_width x destination_height, filtrando
+// primeiro na vertical e depois na horizontal. Cada linha da fonte é
+// convertida para luz linear uma única vez e fica em um anel com as últimas
+// linhas usadas, já que linhas de destino vizinhas compartilham linhas da
+// fonte; as somas dos dois passes são feitas com SSE, com 4 floats por vez
+// (na horizontal, os canais de um pixel).
+void Downsample(const unsigned char* source, uint32_t source_width, uint32_t source_height,
+                unsigned char* destination, uint32_t destination_width, uint32_t destination_height,
+                uint32_t channels)
+{
+    const SrgbTables& srgb = GetSrgbTables();
+    const uint32_t color_channels = std::min(channels, 3u);
+    const size_t   row_size = (size_t)source_width * channels;
+
+    FilterWeights horizontal, vertical;
+    ComputeFilterWeights(source_width, destination_width, &horizontal);
+    ComputeFilterWeights(source_height, destination_height, &vertical);
+
+    // As linhas usadas por uma linha de destino são consecutivas e avançam
+    // junto com ela, então um anel com o maior número de pesos basta.
+    uint32_t ring_size = 0;
+    for (uint32_t y = 0; y < destination_height; ++y)
+        ring_size = std::max(ring_size, vertical.offsets[y + 1] - vertical.offsets[y]);
+    std::vector<float>   ring((size_t)ring_size * row_size);
+    std::vector<int64_t> ring_rows(ring_size, -1); // Linha da fonte em cada posição do anel
+
+    // O passe horizontal lê 4 floats por pixel; com menos de 4 canais, o
+    // último pixel passa do fim da linha. Os 3 floats a mais cobrem qualquer
+    // número de canais (o que passa é lido e descartado).
+    std::vector<float> row(row_size + 3, 0.0f);
+
+    for (uint32_t y = 0; y < destination_height; ++y)
+    {
+        std::fill(row.begin(), row.end(), 0.0f);
+        for (uint32_t k = vertical.offsets[y]; k < vertical.offsets[y + 1]; ++k)
+        {
+            uint32_t source_row = vertical.first[y] + k - vertical.offsets[y];
+            float*   linear = &ring[(size_t)(source_row % ring_size) * row_size];
+            if (ring_rows[source_row % ring_size] != source_row)
+            {
+                LinearizeRow(source + (size_t)source_row * row_size, row_size, channels, linear);
+                ring_rows[source_row % ring_size] = source_row;
+            }
+            AccumulateRow(row.data(), linear, vertical.weights[k], row_size);
+        }
+
+        unsigned char* dst = destination + (size_t)y * destination_width * channels;
+        for (uint32_t x = 0; x < destination_width; ++x)
+        {
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            uint32_t begin = horizontal.offsets[x], end = horizontal.offsets[x + 1];
+            const float* value = &row[(size_t)horizontal.first[x] * channels];
+#ifdef TEXTURE_USE_SSE
+            __m128 acc = _mm_setzero_ps();
+            for (uint32_t k = begin; k < end; ++k, value += channels)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(horizontal.weights[k]), _mm_loadu_ps(value)));
+            _mm_storeu_ps(sum, acc);
+#else
+            for (uint32_t k = begin; k < end; ++k, value += channels)
+                for (uint32_t c = 0; c < channels; ++c)
+                    sum[c] += horizontal.weights[k] * value[c];
+#endif
+            for (uint32_t c = 0; c < color_channels; ++c)
+                dst[x*channels + c] = srgb.from_linear[(int)(std::min(std::max(sum[c], 0.0f), 1.0f) * 65535.0f + 0.5f)];
+            if (channels == 4)
+                dst[x*channels + 3] = (unsigned char)(std::min(std::max(sum[3], 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+} // namespace
+
+size_t TextureData::Size() const
+{
+    size_t size = 0;
+    for (size_t l = 0; l < levels.size(); ++l)
+        size += levels[l].size;
+    return size;
+}
+
+bool TextureFormatIsCompressed(TextureFormat format)
+{
+    return format == TEXTURE_FORMAT_BC1_SRGB || format == TEXTURE_FORMAT_BC3_SRGB;
+}
+
+size_t TextureLevelSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+    size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    switch (format)
+    {
+    case TEXTURE_FORMAT_SRGB8:        return (size_t)width * height * 3;
+    case TEXTURE_FORMAT_SRGB8_ALPHA8: return (size_t)width * height * 4;
+    case TEXTURE_FORMAT_BC1_SRGB:     return blocks * 8;
+    case TEXTURE_FORMAT_BC3_SRGB:     return blocks * 16;
+    }
+    return 0;
+}
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width  = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+        ++levels;
+    }
+    return levels;
+}
+
+void BuildTextureData(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t channels,
+                      TextureData* texture)
+{
+    texture->format = channels == 4 ? TEXTURE_FORMAT_SRGB8_ALPHA8 : TEXTURE_FORMAT_SRGB8;
+    texture->mapping.reset();
+
+    // Todos os níveis ficam em um único bloco, na ordem do maior para o menor.
+    uint32_t num_levels = MipLevelCount(width, height);
+    std::vector<size_t> offsets(num_levels);
+    size_t total = 0;
+    for (uint32_t l = 0, w = width, h = height; l < num_levels; ++l)
+    {
+        offsets[l] = total;
+        total += (size_t)w * h * channels;
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+
+    texture->storage.resize(total);
+    std::copy(pixels, pixels + (size_t)width * height * channels, texture->storage.begin());
+
+    texture->levels.resize(num_levels);
+    for (uint32_t l = 0, w = width, h = height; l < num_levels; ++l)
+    {
+        TextureLevel& level = texture->levels[l];
+        level.width  = w;
+        level.height = h;
+        level.data   = texture->storage.data() + offsets[l];
+        level.size   = (size_t)w * h * channels;
+
+        if (l > 0)
+        {
+            const TextureLevel& previous = texture->levels[l - 1];
+            Downsample(previous.data, previous.width, previous.height,
+                       texture->storage.data() + offsets[l], w, h, channels);
+        }
+
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+}
@@ -0,0 +1,262 @@
+#include "texturearray.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "glstate.h"
+
+// Formatos de GL_EXT_texture_compression_s3tc com GL_EXT_texture_sRGB, que
+// não fazem parte do OpenGL 3.3 e por isso não estão em glad.h.
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT       0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+
+struct TextureArray
+{
+    TextureFormat format;
+    uint32_t      width;
+    uint32_t      height;
+    uint32_t      num_levels;
+    uint32_t      num_layers;  // 0 = posição livre, reusada pela próxima reserva
+    uint32_t      num_released;
+    GLuint        id;          // 0 enquanto não alocado
+
+    std::vector<uint32_t> resident;   // Nível mais fino já enviado de cada camada
+    uint32_t              base_level; // Maior valor de "resident"
+};
+
+std::vector<TextureArray> g_TextureArrays;
+GLuint                    g_Sampler = 0;
+
+GLenum InternalFormat(TextureFormat format)
+{
+    switch (format)
+    {
+    case TEXTURE_FORMAT_SRGB8:        return GL_SRGB8;
+    case TEXTURE_FORMAT_SRGB8_ALPHA8: return GL_SRGB8_ALPHA8;
+    case TEXTURE_FORMAT_BC1_SRGB:     return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    case TEXTURE_FORMAT_BC3_SRGB:     return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    }
+    return GL_NONE;
+}
+
+// Byte "offset" de um nível branco de 1x1 pixel (ou de um bloco, nos formatos
+// comprimidos): cores de 16 bits 0xFFFF nos extremos BC1 e alfa 255 no BC3.
+unsigned char WhiteByte(TextureFormat format, size_t offset)
+{
+    switch (format)
+    {
+    case TEXTURE_FORMAT_BC1_SRGB: return offset < 4 ? 0xFF : 0x00;
+    case TEXTURE_FORMAT_BC3_SRGB: return offset < 2 || (offset >= 8 && offset < 12) ? 0xFF : 0x00;
+    default:                      return 0xFF;
+    }
+}
+
+// Envia o nível "level" das camadas [first_layer, first_layer + num_layers),
+// com "size" bytes no total. O array deve estar ligado.
+void UploadLayers(const TextureArray& array, uint32_t level, uint32_t first_layer, uint32_t num_layers,
+                  size_t size, const void* pixels)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    GLsizei width  = std::max(1u, array.width >> level);
+    GLsizei height = std::max(1u, array.height >> level);
+    if (TextureFormatIsCompressed(array.format))
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, first_layer, width, height, num_layers,
+                                  InternalFormat(array.format), (GLsizei)size, pixels);
+    else
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, first_layer, width, height, num_layers,
+                        array.format == TEXTURE_FORMAT_SRGB8 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+size_t ArraySize(const TextureArray& array)
+{
+    size_t size = 0;
+    for (uint32_t l = 0, w = array.width, h = array.height; l < array.num_levels; ++l)
+    {
+        size += TextureLevelSize(array.format, w, h) * array.num_layers;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    return size;
+}
+
+} // namespace
+
+TextureLayer TextureArrays_Reserve(TextureFormat format, uint32_t width, uint32_t height)
+{
+    GLint max_layers = 256; // Mínimo garantido pelo OpenGL 3.3
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+    // Procura um array ainda não alocado, com o mesmo formato e tamanho e com
+    // espaço livre.
+    TextureLayer result;
+    for (size_t a = 0; a < g_TextureArrays.size(); ++a)
+    {
+        TextureArray& array = g_TextureArrays[a];
+        if (array.id == 0 && array.num_layers > 0 && array.format == format && array.width == width
+            && array.height == height && array.num_layers < (uint32_t)max_layers)
+        {
+            result.array = (int)a;
+            result.layer = (int)array.num_layers++;
+            return result;
+        }
+    }
+
+    TextureArray array;
+    array.format     = format;
+    array.width      = width;
+    array.height     = height;
+    array.num_levels = MipLevelCount(width, height);
+    array.num_layers = 1;
+    array.num_released = 0;
+    array.id         = 0;
+    array.base_level = 0;
+
+    // Reusa a posição de um array já apagado, se houver.
+    size_t a = 0;
+    while (a < g_TextureArrays.size() && g_TextureArrays[a].num_layers > 0)
+        ++a;
+    if (a == g_TextureArrays.size())
+        g_TextureArrays.push_back(array);
+    else
+        g_TextureArrays[a] = array;
+
+    result.array = (int)a;
+    result.layer = 0;
+    return result;
+}
+
+void TextureArrays_Allocate()
+{
+    if (g_Sampler == 0)
+    {
+        glGenSamplers(1, &g_Sampler);
+        glSamplerParameteri(g_Sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(g_Sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(g_Sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glSamplerParameteri(g_Sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GLState_BindSampler(TEXTURE_ARRAY_UNIT, g_Sampler);
+    }
+
+    for (size_t a = 0; a < g_TextureArrays.size(); ++a)
+    {
+        TextureArray& array = g_TextureArrays[a];
+        if (array.id != 0 || array.num_layers == 0)
+            continue;
+
+        glGenTextures(1, &array.id);
+        TextureArrays_Bind((int)a);
+        array.base_level = array.num_levels - 1;
+        array.resident.assign(array.num_layers, array.base_level);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)array.base_level);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)array.num_levels - 1);
+
+        // Só reserva a memória de cada nível; as camadas chegam depois, com
+        // TextureArrays_UploadLevel().
+        GLenum internal_format = InternalFormat(array.format);
+        for (uint32_t l = 0, w = array.width, h = array.height; l < array.num_levels; ++l)
+        {
+            if (TextureFormatIsCompressed(array.format))
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)l, internal_format, w, h, array.num_layers, 0,
+                                       (GLsizei)(TextureLevelSize(array.format, w, h) * array.num_layers), NULL);
+            else
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)l, internal_format, w, h, array.num_layers, 0,
+                             array.format == TEXTURE_FORMAT_SRGB8 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+        }
+
+        // Até a textura chegar, a camada é branca, a mesma cor de um material
+        // sem textura. O menor nível tem no máximo 1x1 pixel ou um bloco.
+        std::vector<unsigned char> white(TextureLevelSize(array.format, 1, 1) * array.num_layers);
+        for (size_t b = 0; b < white.size(); ++b)
+            white[b] = WhiteByte(array.format, b % TextureLevelSize(array.format, 1, 1));
+        UploadLayers(array, array.base_level, 0, array.num_layers, white.size(), white.data());
+    }
+}
+
+void TextureArrays_UploadLevel(const TextureLayer& layer, uint32_t level, uint32_t width, uint32_t height,
+                               size_t size, const void* pixels)
+{
+    TextureArray& array = g_TextureArrays[layer.array];
+    if (level >= array.num_levels || width != std::max(1u, array.width >> level)
+        || height != std::max(1u, array.height >> level) || size != TextureLevelSize(array.format, width, height))
+    {
+        fprintf(stderr, "ERROR: Texture level %u (%ux%u) does not match its array (%ux%u).\n",
+                level, width, height, array.width, array.height);
+        std::exit(EXIT_FAILURE);
+    }
+
+    TextureArrays_Bind(layer.array);
+    UploadLayers(array, level, (uint32_t)layer.layer, 1, size, pixels);
+
+    // O array passa a usar um nível mais fino quando todas as camadas já o
+    // têm.
+    array.resident[layer.layer] = std::min(array.resident[layer.layer], level);
+    uint32_t base_level = *std::max_element(array.resident.begin(), array.resident.end());
+    if (base_level != array.base_level)
+    {
+        array.base_level = base_level;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)base_level);
+    }
+}
+
+void TextureArrays_Release(const TextureLayer& layer)
+{
+    if (layer.array < 0)
+        return;
+
+    TextureArray& array = g_TextureArrays[layer.array];
+    if (++array.num_released < array.num_layers)
+        return;
+
+    GLState_DeleteTexture(array.id);
+    array.id = 0;
+    array.num_layers = 0;
+    array.num_released = 0;
+    array.resident.clear();
+}
+
+size_t TextureArrays_MemoryUsage()
+{
+    size_t size = 0;
+    for (size_t a = 0; a < g_TextureArrays.size(); ++a)
+        if (g_TextureArrays[a].id != 0)
+            size += ArraySize(g_TextureArrays[a]);
+    return size;
+}
+
+void TextureArrays_Bind(int array)
+{
+    GLState_BindTexture(TEXTURE_ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, g_TextureArrays[array].id);
+}
+
+void TextureArrays_PrintStats()
+{
+    size_t num_arrays = 0;
+    size_t layers = 0;
+    size_t size = 0;
+    for (size_t a = 0; a < g_TextureArrays.size(); ++a)
+    {
+        const TextureArray& array = g_TextureArrays[a];
+        if (array.num_layers == 0)
+            continue;
+        printf("  - Array %zu: %u camada(s) de %ux%u, %u níveis, %.1f MB\n", a, array.num_layers,
+               array.width, array.height, array.num_levels, ArraySize(array) / (1024.0 * 1024.0));
+        num_arrays++;
+        layers += array.num_layers;
+        size += ArraySize(array);
+    }
+    printf("Arrays de texturas: %zu array(s), %zu camada(s), %.1f MB\n",
+           num_arrays, layers, size / (1024.0 * 1024.0));
+}
@@ -0,0 +1,203 @@
+#include "texturecache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include "texturecompress.h"
+
+// Layout do arquivo (little-endian nativo, sem compressão):
+//
+//   TextureCacheHeader
+//   TextureCacheLevel[num_levels]
+//   pixels de cada nível, alinhados em 16 bytes
+//
+// As imagens já estão invertidas verticalmente, como a stb_image as entrega
+// com stbi_set_flip_vertically_on_load(true).
+
+namespace {
+
+const char     TEXTURE_CACHE_MAGIC[4] = { 'F', 'C', 'G', 'T' };
+const uint32_t TEXTURE_CACHE_BYTE_ORDER = 0x01020304;
+
+struct TextureCacheHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t format;       // TextureFormat
+    uint32_t num_levels;
+    uint32_t reserved;
+    uint64_t path_hash;    // FNV-1a do caminho da imagem
+    uint64_t source_size;  // Tamanho da imagem em bytes
+    int64_t  source_mtime; // Data de modificação da imagem
+};
+
+struct TextureCacheLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+uint64_t HashPath(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        hash ^= (unsigned char)path[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool StatSource(const std::string& filename, uint64_t* size, int64_t* mtime)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return false;
+    *size  = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+} // namespace
+
+std::string TextureCacheFilename(const std::string& image_filename)
+{
+    return image_filename + ".texcache";
+}
+
+// Tenta carregar a textura do cache. Retorna false (sem alterar a textura) se
+// o cache não existir, estiver desatualizado, corrompido ou se a textura
+// guardada for (ou não for) comprimida ao contrário do pedido: com
+// "compressed", só as texturas para as quais ShouldCompressTexture()
+// ("texturecompress.h") retorna true devem estar comprimidas.
+bool LoadTextureCache(const std::string& image_filename, bool compressed, TextureData* texture)
+{
+    uint64_t source_size;
+    int64_t  source_mtime;
+    if (!StatSource(image_filename, &source_size, &source_mtime))
+        return false;
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    if (!file->Open(TextureCacheFilename(image_filename).c_str()))
+        return false;
+
+    const unsigned char* base = file->Data();
+    const size_t         size = file->Size();
+
+    TextureCacheHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, base, sizeof(header));
+
+    if (memcmp(header.magic, TEXTURE_CACHE_MAGIC, 4) != 0
+        || header.version != TEXTURE_CACHE_VERSION
+        || header.byte_order != TEXTURE_CACHE_BYTE_ORDER
+        || header.path_hash != HashPath(image_filename)
+        || header.source_size != source_size
+        || header.source_mtime != source_mtime)
+        return false;
+
+    if (header.format > TEXTURE_FORMAT_BC3_SRGB)
+        return false;
+    if (header.num_levels == 0 || header.num_levels > (size - sizeof(header)) / sizeof(TextureCacheLevel))
+        return false;
+
+    TextureFormat format = (TextureFormat)header.format;
+    std::vector<TextureLevel> levels(header.num_levels);
+    for (uint32_t l = 0; l < header.num_levels; ++l)
+    {
+        TextureCacheLevel level;
+        memcpy(&level, base + sizeof(header) + l * sizeof(TextureCacheLevel), sizeof(level));
+
+        // Cada nível tem que ter as dimensões da cadeia completa e caber no
+        // arquivo.
+        uint32_t expected_width  = l == 0 ? level.width  : std::max(1u, levels[l-1].width / 2);
+        uint32_t expected_height = l == 0 ? level.height : std::max(1u, levels[l-1].height / 2);
+        if (level.width == 0 || level.height == 0
+            || level.width != expected_width || level.height != expected_height
+            || level.size != TextureLevelSize(format, level.width, level.height)
+            || level.offset > size || level.size > size - level.offset)
+            return false;
+
+        levels[l].width  = level.width;
+        levels[l].height = level.height;
+        levels[l].data   = base + level.offset;
+        levels[l].size   = (size_t)level.size;
+    }
+    if (header.num_levels != MipLevelCount(levels[0].width, levels[0].height))
+        return false;
+    if (TextureFormatIsCompressed(format) != (compressed && ShouldCompressTexture(levels[0].width, levels[0].height)))
+        return false;
+
+    texture->format = format;
+    texture->levels.swap(levels);
+    texture->storage.clear();
+    texture->mapping = file;
+    return true;
+}
+
+// Grava o cache de uma textura. Como em SaveMeshCache(), o arquivo é escrito
+// com outro nome e renomeado no final.
+bool SaveTextureCache(const std::string& image_filename, const TextureData& texture)
+{
+    TextureCacheHeader header;
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+    header.version    = TEXTURE_CACHE_VERSION;
+    header.byte_order = TEXTURE_CACHE_BYTE_ORDER;
+    header.format     = (uint32_t)texture.format;
+    header.num_levels = (uint32_t)texture.levels.size();
+    header.reserved   = 0;
+    header.path_hash  = HashPath(image_filename);
+    if (!StatSource(image_filename, &header.source_size, &header.source_mtime))
+        return false;
+
+    std::vector<TextureCacheLevel> levels(header.num_levels);
+    uint64_t offset = sizeof(header) + header.num_levels * sizeof(TextureCacheLevel);
+    for (uint32_t l = 0; l < header.num_levels; ++l)
+    {
+        offset = (offset + 15) & ~(uint64_t)15;
+        levels[l].width  = texture.levels[l].width;
+        levels[l].height = texture.levels[l].height;
+        levels[l].offset = offset;
+        levels[l].size   = texture.levels[l].size;
+        offset += texture.levels[l].size;
+    }
+
+    std::string filename = TextureCacheFilename(image_filename);
+    std::string tmp_filename = filename + ".tmp";
+
+    FILE* f = fopen(tmp_filename.c_str(), "wb");
+    if (f == NULL)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+           && fwrite(levels.data(), sizeof(TextureCacheLevel), header.num_levels, f) == header.num_levels;
+
+    static const unsigned char zeros[16] = { 0 };
+    uint64_t written = sizeof(header) + header.num_levels * sizeof(TextureCacheLevel);
+    for (uint32_t l = 0; ok && l < header.num_levels; ++l)
+    {
+        size_t padding = (size_t)(levels[l].offset - written);
+        ok = fwrite(zeros, 1, padding, f) == padding
+          && fwrite(texture.levels[l].data, 1, texture.levels[l].size, f) == texture.levels[l].size;
+        written = levels[l].offset + levels[l].size;
+    }
+
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok)
+    {
+        remove(filename.c_str()); // rename() falha no Windows se o destino existir
+        ok = rename(tmp_filename.c_str(), filename.c_str()) == 0;
+    }
+    if (!ok)
+    {
+        remove(tmp_filename.c_str());
+        fprintf(stderr, "WARNING: Cannot write texture cache \"%s\".\n", filename.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,333 @@
+#include "texturecompress.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "threadpool.h"
+
+namespace {
+
+// Níveis com menos linhas de blocos que isso são comprimidos na thread atual.
+const uint32_t PARALLEL_MIN_BLOCK_ROWS = 16;
+
+void WriteUint16(unsigned char* out, uint16_t value)
+{
+    out[0] = (unsigned char)(value & 0xFF);
+    out[1] = (unsigned char)(value >> 8);
+}
+
+uint16_t PackRgb565(const float color[3])
+{
+    int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// Expande R5 G6 B5 para 8 bits por canal, como a GPU faz ao decodificar.
+void UnpackRgb565(uint16_t packed, float color[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (float)((r << 3) | (r >> 2));
+    color[1] = (float)((g << 2) | (g >> 4));
+    color[2] = (float)((b << 3) | (b >> 2));
+}
+
+float SquaredDistance(const float a[3], const float b[3])
+{
+    float dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+    return dr*dr + dg*dg + db*db;
+}
+
+// Escolhe, para cada pixel, a cor mais próxima da paleta de 4 cores definida
+// por c0 e c1 (modo de 4 cores, c0 > c1). Retorna o erro quadrático total.
+float ChooseColorIndices(const float pixels[16][3], uint16_t c0, uint16_t c1, unsigned indices[16])
+{
+    float palette[4][3];
+    UnpackRgb565(c0, palette[0]);
+    UnpackRgb565(c1, palette[1]);
+    for (int k = 0; k < 3; ++k)
+    {
+        palette[2][k] = (2.0f * palette[0][k] + palette[1][k]) / 3.0f;
+        palette[3][k] = (palette[0][k] + 2.0f * palette[1][k]) / 3.0f;
+    }
+
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        unsigned best = 0;
+        float best_distance = SquaredDistance(pixels[i], palette[0]);
+        for (unsigned p = 1; p < 4; ++p)
+        {
+            float distance = SquaredDistance(pixels[i], palette[p]);
+            if (distance < best_distance)
+            {
+                best = p;
+                best_distance = distance;
+            }
+        }
+        indices[i] = best;
+        error += best_distance;
+    }
+    return error;
+}
+
+// Recalcula os extremos que minimizam o erro quadrático para os índices dados:
+// cada pixel é aproximado por w*c0 + (1-w)*c1, com w = 1, 0, 2/3 ou 1/3.
+bool RefineEndpoints(const float pixels[16][3], const unsigned indices[16], float e0[3], float e1[3])
+{
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[3] = {0.0f, 0.0f, 0.0f}, bx[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i)
+    {
+        float a = weights[indices[i]], b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int k = 0; k < 3; ++k)
+        {
+            ax[k] += a * pixels[i][k];
+            bx[k] += b * pixels[i][k];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+
+    for (int k = 0; k < 3; ++k)
+    {
+        e0[k] = (ax[k] * bb - bx[k] * ab) / determinant;
+        e1[k] = (bx[k] * aa - ax[k] * ab) / determinant;
+    }
+    return true;
+}
+
+// Ordena os extremos para o modo de 4 cores (c0 > c1), trocando os índices
+// quando necessário.
+void OrderEndpoints(uint16_t* c0, uint16_t* c1, unsigned indices[16])
+{
+    if (*c0 >= *c1)
+        return;
+    std::swap(*c0, *c1);
+    static const unsigned swapped[4] = { 1, 0, 3, 2 };
+    for (int i = 0; i < 16; ++i)
+        indices[i] = swapped[indices[i]];
+}
+
+// Bloco de cor de BC1 (e da parte de cor de BC3): dois extremos R5G6B5 e 16
+// índices de 2 bits, sempre no modo de 4 cores.
+void EncodeColorBlock(const unsigned char block[16][4], unsigned char out[8])
+{
+    float pixels[16][3];
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i)
+        for (int k = 0; k < 3; ++k)
+        {
+            pixels[i][k] = block[i][k];
+            mean[k] += pixels[i][k] / 16.0f;
+        }
+
+    // Eixo principal: autovetor dominante da covariância, por iteração de
+    // potência.
+    float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i)
+    {
+        float r = pixels[i][0] - mean[0], g = pixels[i][1] - mean[1], b = pixels[i][2] - mean[2];
+        covariance[0] += r*r; covariance[1] += r*g; covariance[2] += r*b;
+        covariance[3] += g*g; covariance[4] += g*b; covariance[5] += b*b;
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[3] = {
+            covariance[0]*axis[0] + covariance[1]*axis[1] + covariance[2]*axis[2],
+            covariance[1]*axis[0] + covariance[3]*axis[1] + covariance[4]*axis[2],
+            covariance[2]*axis[0] + covariance[4]*axis[1] + covariance[5]*axis[2],
+        };
+        float length = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+        if (length < 1e-6f)
+            break;
+        for (int k = 0; k < 3; ++k)
+            axis[k] = next[k] / length;
+    }
+
+    // Extremos: projeções mínima e máxima no eixo, recuadas 1/16 do intervalo
+    // para dentro (os pixels extremos raramente são os melhores extremos).
+    float minimum = 0.0f, maximum = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1]
+                + (pixels[i][2] - mean[2]) * axis[2];
+        minimum = std::min(minimum, t);
+        maximum = std::max(maximum, t);
+    }
+    float inset = (maximum - minimum) / 16.0f;
+    float e0[3], e1[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        e0[k] = mean[k] + axis[k] * (maximum - inset);
+        e1[k] = mean[k] + axis[k] * (minimum + inset);
+    }
+
+    uint16_t c0 = PackRgb565(e0), c1 = PackRgb565(e1);
+    unsigned indices[16];
+    float error = ChooseColorIndices(pixels, c0, c1, indices);
+
+    // Uma rodada de mínimos quadrados; fica com ela só se o erro diminuir.
+    float r0[3], r1[3];
+    if (c0 != c1 && RefineEndpoints(pixels, indices, r0, r1))
+    {
+        uint16_t refined0 = PackRgb565(r0), refined1 = PackRgb565(r1);
+        unsigned refined_indices[16];
+        float refined_error = ChooseColorIndices(pixels, refined0, refined1, refined_indices);
+        if (refined_error < error)
+        {
+            c0 = refined0;
+            c1 = refined1;
+            memcpy(indices, refined_indices, sizeof(indices));
+        }
+    }
+
+    OrderEndpoints(&c0, &c1, indices);
+    if (c0 == c1)
+        memset(indices, 0, sizeof(indices)); // Bloco de cor única
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= indices[i] << (2 * i);
+
+    WriteUint16(out + 0, c0);
+    WriteUint16(out + 2, c1);
+    WriteUint16(out + 4, (uint16_t)(bits & 0xFFFF));
+    WriteUint16(out + 6, (uint16_t)(bits >> 16));
+}
+
+// Bloco de alfa de BC3: dois extremos de 8 bits (a0 > a1, modo de 8 valores)
+// e 16 índices de 3 bits.
+void EncodeAlphaBlock(const unsigned char block[16][4], unsigned char out[8])
+{
+    unsigned char a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; ++i)
+    {
+        a0 = std::max(a0, block[i][3]);
+        a1 = std::min(a1, block[i][3]);
+    }
+
+    float palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    for (int p = 1; p <= 6; ++p)
+        palette[p + 1] = ((7 - p) * a0 + p * a1) / 7.0f;
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        unsigned best = 0;
+        float best_distance = std::fabs(block[i][3] - palette[0]);
+        for (unsigned p = 1; p < 8 && a0 != a1; ++p)
+        {
+            float distance = std::fabs(block[i][3] - palette[p]);
+            if (distance < best_distance)
+            {
+                best = p;
+                best_distance = distance;
+            }
+        }
+        bits |= (uint64_t)best << (3 * i);
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (int b = 0; b < 6; ++b)
+        out[2 + b] = (unsigned char)(bits >> (8 * b));
+}
+
+// Copia o bloco de 4x4 pixels que começa em (x, y), repetindo a última
+// linha/coluna quando o bloco passa da borda da imagem.
+void FetchBlock(const TextureLevel& level, uint32_t channels, uint32_t x, uint32_t y, unsigned char block[16][4])
+{
+    for (uint32_t by = 0; by < 4; ++by)
+    {
+        uint32_t sy = std::min(y + by, level.height - 1);
+        for (uint32_t bx = 0; bx < 4; ++bx)
+        {
+            uint32_t sx = std::min(x + bx, level.width - 1);
+            const unsigned char* pixel = level.data + ((size_t)sy * level.width + sx) * channels;
+            unsigned char* texel = block[4*by + bx];
+            texel[0] = pixel[0];
+            texel[1] = pixel[1];
+            texel[2] = pixel[2];
+            texel[3] = channels == 4 ? pixel[3] : 255;
+        }
+    }
+}
+
+} // namespace
+
+void CompressTextureData(const TextureData& source, TextureData* destination)
+{
+    const bool     alpha = source.format == TEXTURE_FORMAT_SRGB8_ALPHA8;
+    const uint32_t channels = alpha ? 4 : 3;
+    const TextureFormat format = alpha ? TEXTURE_FORMAT_BC3_SRGB : TEXTURE_FORMAT_BC1_SRGB;
+    const size_t   block_size = alpha ? 16 : 8;
+
+    std::vector<size_t> offsets(source.levels.size());
+    size_t total = 0;
+    for (size_t l = 0; l < source.levels.size(); ++l)
+    {
+        offsets[l] = total;
+        total += TextureLevelSize(format, source.levels[l].width, source.levels[l].height);
+    }
+
+    destination->format = format;
+    destination->mapping.reset();
+    destination->storage.resize(total);
+    destination->levels.resize(source.levels.size());
+
+    for (size_t l = 0; l < source.levels.size(); ++l)
+    {
+        const TextureLevel& level = source.levels[l];
+        unsigned char* out = destination->storage.data() + offsets[l];
+
+        TextureLevel& compressed = destination->levels[l];
+        compressed.width  = level.width;
+        compressed.height = level.height;
+        compressed.data   = out;
+        compressed.size   = TextureLevelSize(format, level.width, level.height);
+
+        uint32_t blocks_x = (level.width + 3) / 4;
+        uint32_t blocks_y = (level.height + 3) / 4;
+        std::function<void(size_t)> encode_row = [&](size_t row) {
+            unsigned char block[16][4];
+            for (uint32_t bx = 0; bx < blocks_x; ++bx)
+            {
+                unsigned char* encoded = out + (row * blocks_x + bx) * block_size;
+                FetchBlock(level, channels, 4 * bx, 4 * (uint32_t)row, block);
+                if (alpha)
+                {
+                    EncodeAlphaBlock(block, encoded);
+                    EncodeColorBlock(block, encoded + 8);
+                }
+                else
+                    EncodeColorBlock(block, encoded);
+            }
+        };
+
+        if (blocks_y >= PARALLEL_MIN_BLOCK_ROWS)
+            ParallelFor(blocks_y, encode_row);
+        else
+            for (uint32_t row = 0; row < blocks_y; ++row)
+                encode_row(row);
+    }
+}
+
+bool ShouldCompressTexture(uint32_t width, uint32_t height)
+{
+    return std::max(width, height) >= TEXTURE_COMPRESS_MIN_SIZE;
+}
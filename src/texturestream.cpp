@@ -0,0 +1,443 @@
+#include "texturestream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <string>
+#include <stb_image.h>
+#include "glstate.h"
+#include "texturecache.h"
+#include "texturecompress.h"
+#include "threadpool.h"
+
+namespace {
+
+// Os níveis ficam alinhados a 16 bytes dentro do pixel buffer object.
+const size_t UPLOAD_ALIGNMENT = 16;
+
+struct StreamTexture
+{
+    std::string       filename;
+    TextureLayer      layer;
+    bool              compress;
+
+    TextureData       texture;
+    char              from_cache;
+    std::future<void> prepared;
+    bool              submitted;
+    bool              ready;        // A tarefa terminou e "texture" está preenchida
+    uint32_t          first_level;  // Níveis descartados pela qualidade ou pelo orçamento: [0, first_level)
+    uint32_t          remaining;    // Níveis ainda não enviados: [first_level, remaining)
+};
+
+struct PendingUpload
+{
+    StreamTexture* texture;
+    uint32_t       level;
+    size_t         offset;     // Dentro do pixel buffer object
+};
+
+// std::deque não move os elementos ao crescer, então as tarefas do pool podem
+// guardar ponteiros para eles.
+std::deque<StreamTexture> g_Textures;
+size_t                    g_NumFinished = 0;  // Prefixo de g_Textures já enviado por inteiro
+GLuint                    g_UnpackBuffer = 0;
+size_t                    g_UnpackBufferSize = 0;
+
+// Estatísticas do carregamento em andamento.
+std::chrono::steady_clock::time_point g_Start;
+size_t                                g_BatchBegin = 0;
+unsigned                              g_Frames = 0;
+size_t                                g_TotalBytes = 0;
+size_t                                g_SavedBytes = 0;
+size_t                                g_Cached = 0;
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Memória da cadeia de mipmaps de uma imagem a partir do nível "first_level".
+size_t ChainSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t first_level)
+{
+    size_t size = 0;
+    for (uint32_t l = 0; l < MipLevelCount(width, height); ++l)
+    {
+        if (l >= first_level)
+            size += TextureLevelSize(format, width, height);
+        width  = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+const char* FormatName(TextureFormat format)
+{
+    switch (format)
+    {
+    case TEXTURE_FORMAT_SRGB8:        return "SRGB8";
+    case TEXTURE_FORMAT_SRGB8_ALPHA8: return "SRGB8_ALPHA8";
+    case TEXTURE_FORMAT_BC1_SRGB:     return "BC1";
+    case TEXTURE_FORMAT_BC3_SRGB:     return "BC3";
+    }
+    return "?";
+}
+
+const char* QualityName(TextureQuality quality)
+{
+    switch (quality)
+    {
+    case TEXTURE_QUALITY_FULL:    return "completa";
+    case TEXTURE_QUALITY_HALF:    return "metade";
+    case TEXTURE_QUALITY_QUARTER: return "um quarto";
+    }
+    return "?";
+}
+
+// Constrói a textura a partir da imagem e grava o cache. Roda no pool.
+void Prepare(StreamTexture* entry)
+{
+    TextureData* texture = &entry->texture;
+    const char*  filename = entry->filename.c_str();
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(filename, &width, &height, &channels, 3);
+    if (pixels == NULL)
+        return;
+    BuildTextureData(pixels, width, height, 3, texture);
+    stbi_image_free(pixels);
+
+    if (entry->compress && ShouldCompressTexture(width, height))
+    {
+        TextureData compressed;
+        CompressTextureData(*texture, &compressed);
+        std::swap(*texture, compressed);
+    }
+    SaveTextureCache(filename, *texture);
+}
+
+// Uma imagem de 4096x4096 ocupa 64 MB com os mipmaps, então só algumas
+// texturas decodificadas esperam pelo envio ao mesmo tempo.
+void SubmitTasks()
+{
+    ThreadPool& pool = GetThreadPool();
+    size_t max_in_flight = pool.NumThreads() + 1;
+
+    size_t in_flight = 0;
+    for (size_t i = g_NumFinished; i < g_Textures.size(); ++i)
+    {
+        StreamTexture& entry = g_Textures[i];
+        if (!entry.submitted && !entry.ready)
+        {
+            if (in_flight >= max_in_flight)
+                break;
+            StreamTexture* pointer = &entry;
+            entry.prepared = pool.Submit([pointer]() { Prepare(pointer); });
+            entry.submitted = true;
+        }
+        if (entry.submitted && (!entry.ready || entry.remaining > entry.first_level))
+            ++in_flight;
+    }
+}
+
+// Marca como prontas as texturas cujas tarefas terminaram. Com "wait", espera
+// pela primeira tarefa pendente se nenhuma textura tiver níveis para enviar.
+void CollectReady(bool wait)
+{
+    bool has_work = false;
+    for (size_t i = g_NumFinished; i < g_Textures.size(); ++i)
+    {
+        StreamTexture& entry = g_Textures[i];
+        if (!entry.ready && entry.submitted
+            && entry.prepared.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            entry.prepared.get();
+            if (entry.texture.Empty())
+            {
+                fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", entry.filename.c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            entry.ready = true;
+            entry.remaining = (uint32_t)entry.texture.levels.size();
+        }
+        has_work = has_work || (entry.ready && entry.remaining > entry.first_level);
+    }
+
+    if (wait && !has_work)
+    {
+        for (size_t i = g_NumFinished; i < g_Textures.size(); ++i)
+        {
+            if (g_Textures[i].submitted && !g_Textures[i].ready)
+            {
+                g_Textures[i].prepared.wait();
+                CollectReady(false);
+                return;
+            }
+        }
+    }
+}
+
+// Relatório de uma textura que acabou de ser enviada por inteiro. Os pixels
+// (ou o mapeamento) são liberados.
+void FinishTexture(StreamTexture& entry)
+{
+    const TextureData&  texture = entry.texture;
+    const TextureLevel& first = texture.levels[entry.first_level];
+    size_t size = 0;
+    for (size_t l = entry.first_level; l < texture.levels.size(); ++l)
+        size += texture.levels[l].size;
+    g_TotalBytes += size;
+    g_Cached += entry.from_cache;
+
+    char reduced[64] = "";
+    if (entry.first_level > 0)
+        snprintf(reduced, sizeof(reduced), " (original %ux%u)", texture.levels[0].width, texture.levels[0].height);
+
+    // Memória economizada pela compressão, em relação aos mesmos níveis sem
+    // compressão.
+    char saved[64] = "";
+    if (TextureFormatIsCompressed(texture.format))
+    {
+        TextureFormat uncompressed_format = texture.format == TEXTURE_FORMAT_BC3_SRGB
+                                          ? TEXTURE_FORMAT_SRGB8_ALPHA8 : TEXTURE_FORMAT_SRGB8;
+        size_t uncompressed = 0;
+        for (size_t l = entry.first_level; l < texture.levels.size(); ++l)
+            uncompressed += TextureLevelSize(uncompressed_format, texture.levels[l].width, texture.levels[l].height);
+        g_SavedBytes += uncompressed - size;
+        snprintf(saved, sizeof(saved), " (%.2f MB economizados)", (uncompressed - size) / (1024.0 * 1024.0));
+    }
+
+    printf("  - Textura \"%s\": %ux%u%s, %s, %.2f MB%s\n", entry.filename.c_str(), first.width, first.height,
+           reduced, FormatName(texture.format), size / (1024.0 * 1024.0), saved);
+
+    entry.texture = TextureData();
+}
+
+} // namespace
+
+void TextureStream_Begin(const char* const* filenames, size_t count, const TextureLoadOptions& options,
+                         std::vector<TextureLayer>* layers)
+{
+    if (!TextureStream_Pending())
+    {
+        g_Start = std::chrono::steady_clock::now();
+        g_BatchBegin = g_Textures.size();
+        g_Frames = 0;
+        g_TotalBytes = g_SavedBytes = g_Cached = 0;
+    }
+
+    // A configuração de inversão vertical do stb_image é global; é definida
+    // antes de qualquer decodificação começar.
+    stbi_set_flip_vertically_on_load(true);
+
+    // O formato e as dimensões de cada textura são conhecidos antes da
+    // decodificação: as imagens são carregadas sempre com 3 canais e
+    // comprimidas conforme ShouldCompressTexture().
+    std::vector<TextureFormat> formats(count);
+    std::vector<uint32_t>      widths(count), heights(count), first_levels(count), max_levels(count);
+    size_t planned = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int width, height, channels;
+        if ( !stbi_info(filenames[i], &width, &height, &channels) )
+        {
+            fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filenames[i]);
+            std::exit(EXIT_FAILURE);
+        }
+        formats[i] = options.compress && ShouldCompressTexture(width, height)
+                   ? TEXTURE_FORMAT_BC1_SRGB : TEXTURE_FORMAT_SRGB8;
+        widths[i]  = width;
+        heights[i] = height;
+
+        max_levels[i] = 0;
+        while (std::max(widths[i], heights[i]) >> (max_levels[i] + 1) >= TEXTURE_MIN_REDUCED_SIZE)
+            max_levels[i]++;
+        first_levels[i] = std::min((uint32_t)options.quality, max_levels[i]);
+        planned += ChainSize(formats[i], widths[i], heights[i], first_levels[i]);
+    }
+
+    // Enquanto não couber no orçamento, junto com os arrays já alocados, a
+    // textura que ocupa mais memória perde o seu maior nível, o que corta
+    // cerca de 3/4 do que ela ocupa.
+    size_t allocated = TextureArrays_MemoryUsage();
+    while (options.memory_budget != 0 && allocated + planned > options.memory_budget)
+    {
+        size_t largest = count;
+        size_t largest_size = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t size = ChainSize(formats[i], widths[i], heights[i], first_levels[i]);
+            if (first_levels[i] < max_levels[i] && size > largest_size)
+            {
+                largest = i;
+                largest_size = size;
+            }
+        }
+        if (largest == count)
+        {
+            fprintf(stderr, "WARNING: Textures need %.1f MB, more than the %.1f MB texture budget.\n",
+                    (allocated + planned) / (1024.0 * 1024.0), options.memory_budget / (1024.0 * 1024.0));
+            break;
+        }
+        first_levels[largest]++;
+        planned += ChainSize(formats[largest], widths[largest], heights[largest], first_levels[largest]);
+        planned -= largest_size;
+    }
+
+    size_t num_reduced = 0;
+    layers->resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        (*layers)[i] = TextureArrays_Reserve(formats[i], std::max(1u, widths[i] >> first_levels[i]),
+                                             std::max(1u, heights[i] >> first_levels[i]));
+        num_reduced += first_levels[i] > 0;
+
+        g_Textures.push_back(StreamTexture());
+        StreamTexture& entry = g_Textures.back();
+        entry.filename    = filenames[i];
+        entry.layer       = (*layers)[i];
+        entry.compress    = options.compress;
+        entry.submitted   = false;
+        entry.first_level = first_levels[i];
+
+        // O cache só é mapeado e validado, o que é rápido o bastante para esta
+        // thread; assim os níveis menores de todas as texturas já em cache
+        // vão para a GPU logo no primeiro quadro. As demais ficam para o pool.
+        // O cache guarda sempre a cadeia completa, e os níveis descartados
+        // nem chegam a ser lidos.
+        entry.from_cache = LoadTextureCache(entry.filename, options.compress, &entry.texture);
+        entry.ready      = entry.from_cache != 0;
+        entry.remaining  = entry.ready ? (uint32_t)entry.texture.levels.size() : 0;
+    }
+    TextureArrays_Allocate();
+
+    printf("Texturas: qualidade %s, %.1f MB na GPU", QualityName(options.quality), planned / (1024.0 * 1024.0));
+    if (options.memory_budget != 0)
+        printf(" (orçamento de %.1f MB)", options.memory_budget / (1024.0 * 1024.0));
+    printf(", %zu de %zu reduzida(s)\n", num_reduced, count);
+
+    SubmitTasks();
+}
+
+void TextureStream_Update(size_t budget)
+{
+    if (!TextureStream_Pending())
+        return;
+
+    // TextureStream_Finish() usa um orçamento ilimitado, fora dos quadros.
+    bool finishing = budget == (size_t)-1;
+    if (!finishing)
+        ++g_Frames;
+
+    CollectReady(finishing);
+
+    // Escolhe os níveis do quadro: sempre o menor nível ainda não enviado
+    // entre todas as texturas prontas, até estourar o orçamento.
+    std::vector<PendingUpload> uploads;
+    size_t total = 0;
+    while (true)
+    {
+        StreamTexture* best = NULL;
+        size_t         best_size = 0;
+        for (size_t i = g_NumFinished; i < g_Textures.size(); ++i)
+        {
+            StreamTexture& entry = g_Textures[i];
+            if (!entry.ready || entry.remaining == entry.first_level)
+                continue;
+            size_t size = entry.texture.levels[entry.remaining - 1].size;
+            if (best == NULL || size < best_size)
+            {
+                best = &entry;
+                best_size = size;
+            }
+        }
+        if (best == NULL || (!uploads.empty() && total + best_size > budget))
+            break;
+
+        PendingUpload upload = { best, best->remaining - 1, total };
+        uploads.push_back(upload);
+        total = AlignUp(total + best_size, UPLOAD_ALIGNMENT);
+        best->remaining--;
+    }
+
+    if (!uploads.empty())
+    {
+        // O buffer é descartado (glBufferData com NULL) antes de ser
+        // preenchido, então o driver não precisa esperar pelos envios do
+        // quadro anterior.
+        if (g_UnpackBuffer == 0)
+            glGenBuffers(1, &g_UnpackBuffer);
+        g_UnpackBufferSize = std::max(g_UnpackBufferSize, total);
+
+        GLState_BindBuffer(GL_PIXEL_UNPACK_BUFFER, g_UnpackBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, g_UnpackBufferSize, NULL, GL_STREAM_DRAW);
+        unsigned char* staging = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total,
+                                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        bool mapped = staging != NULL;
+        if (mapped)
+        {
+            for (size_t u = 0; u < uploads.size(); ++u)
+            {
+                const TextureLevel& level = uploads[u].texture->texture.levels[uploads[u].level];
+                memcpy(staging + uploads[u].offset, level.data, level.size);
+            }
+            mapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        }
+
+        // Se o mapeamento falhar (ou o conteúdo se perder antes de
+        // glUnmapBuffer()), os níveis são enviados direto da memória.
+        if (!mapped)
+        {
+            fprintf(stderr, "WARNING: Cannot map texture upload buffer, uploading %zu level(s) from client memory.\n",
+                    uploads.size());
+            GLState_BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        for (size_t u = 0; u < uploads.size(); ++u)
+        {
+            const TextureLevel& level = uploads[u].texture->texture.levels[uploads[u].level];
+            const void* pixels = mapped ? (const void*)uploads[u].offset : (const void*)level.data;
+            TextureArrays_UploadLevel(uploads[u].texture->layer, uploads[u].level - uploads[u].texture->first_level,
+                                      level.width, level.height, level.size, pixels);
+        }
+        GLState_BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // Libera as texturas já enviadas por inteiro, o que abre espaço para
+    // novas tarefas.
+    for (size_t i = g_NumFinished; i < g_Textures.size(); ++i)
+    {
+        StreamTexture& entry = g_Textures[i];
+        if (entry.ready && entry.remaining == entry.first_level && !entry.texture.Empty())
+            FinishTexture(entry);
+    }
+    while (g_NumFinished < g_Textures.size() && g_Textures[g_NumFinished].ready
+           && g_Textures[g_NumFinished].remaining == g_Textures[g_NumFinished].first_level)
+        ++g_NumFinished;
+
+    if (TextureStream_Pending())
+    {
+        SubmitTasks();
+        return;
+    }
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - g_Start).count();
+    printf("%zu textura(s) carregada(s) em %.2f ms e %u quadro(s) (%zu do cache, %u threads, %.1f MB com mipmaps, %.1f MB economizados pela compressão)\n",
+           g_Textures.size() - g_BatchBegin, elapsed_ms, g_Frames, g_Cached, GetThreadPool().NumThreads(),
+           g_TotalBytes / (1024.0 * 1024.0), g_SavedBytes / (1024.0 * 1024.0));
+}
+
+void TextureStream_Finish()
+{
+    while (TextureStream_Pending())
+        TextureStream_Update((size_t)-1);
+}
+
+bool TextureStream_Pending()
+{
+    return g_NumFinished < g_Textures.size();
+}
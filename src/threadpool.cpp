@@ -0,0 +1,124 @@
+#include "threadpool.h"
+
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned num_threads)
+    : stopping(false)
+{
+    if (num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    if (num_threads == 0)
+        num_threads = 1;
+
+    for (unsigned i = 0; i < num_threads; ++i)
+        workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+std::future<void> ThreadPool::Submit(const std::function<void()>& task)
+{
+    std::packaged_task<void()> packaged(task);
+    std::future<void> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(packaged));
+    }
+    condition.notify_one();
+    return result;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    for (;;)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping && tasks.empty())
+                condition.wait(lock);
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+ThreadPool& GetThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+namespace {
+
+// Estado compartilhado de um ParallelFor. Fica vivo enquanto alguma tarefa
+// ainda na fila do pool apontar para ele, mesmo depois de ParallelFor retornar.
+struct ParallelForState
+{
+    std::function<void(size_t)> body;
+    size_t                      count;
+    std::atomic<size_t>         next;
+    std::atomic<size_t>         done;
+    std::mutex                  mutex;
+    std::condition_variable     finished;
+
+    void Run()
+    {
+        size_t completed = 0;
+        for (size_t i = next++; i < count; i = next++)
+        {
+            body(i);
+            ++completed;
+        }
+        if (completed > 0 && (done += completed) == count)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.notify_all();
+        }
+    }
+};
+
+} // namespace
+
+void ParallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+    if (count == 1)
+    {
+        body(0);
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state(new ParallelForState());
+    state->body  = body;
+    state->count = count;
+    state->next  = 0;
+    state->done  = 0;
+
+    // A thread atual também trabalha, então uma chamada feita de dentro de
+    // uma tarefa do pool termina mesmo que nenhuma outra thread esteja livre.
+    ThreadPool& pool = GetThreadPool();
+    size_t helpers = pool.NumThreads() < count - 1 ? pool.NumThreads() : count - 1;
+    for (size_t i = 0; i < helpers; ++i)
+        pool.Submit([state]() { state->Run(); });
+
+    state->Run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (state->done < count)
+        state->finished.wait(lock);
+}